@@ -1,319 +1,1803 @@
-#include "gtest/gtest.h"
-#include "map_get_fresh_top_k.h"
-
-#include <math.h>
-
-#include <set>
-#include <ctime>
-#include <chrono>
-#include <cstdlib>
-#include <random>
-#include <string>
-#include <algorithm>
-// uncomment to disable assert()
-// #define NDEBUG
-#include <cassert>
-
-#include "accurate_frequency_analyzer.h"
-#include "utility_functions.h"
-
-// Use (void) to silent unused warnings.
-#define assertm(exp, msg) assert(((void)msg, exp))
-
-// For google test custom messages
-#define GTEST_COUT std::cerr << "[          ] [ INFO ]"
-
-TEST(small_tests_suite, one_set_one_get) {
-    std::string key1 = "key_1";
-    std::string val1 = "val_1";
-
-    MapGetFreshTopK<> map(std::chrono::seconds(1), 0.1, 12, 54);;
-
-    map.set(key1, val1);
-    auto result = map.get_top_k();
-
-    std::vector<std::string> expected{key1};
-
-    ASSERT_TRUE(IsOneVectorInAnother(expected, result));
-}
-
-TEST(small_tests_suite, dozen_set_one_get) {
-    const size_t num = 10;
-
-    std::vector<std::string> keys, vals;
-    for (size_t i = 0; i < num; ++i) {
-        keys.push_back("key_" + std::to_string(i));
-        vals.push_back("val_" + std::to_string(i));
-    }
-
-    MapGetFreshTopK<> map(std::chrono::seconds(1), 0.1, 12, 54);
-
-    for (size_t i = 0; i < num; ++i) {
-        map.set(keys[i], vals[i]);
-    }
-
-    auto result = map.get_top_k();
-
-    std::vector<std::string> expected{keys};
-
-    ASSERT_TRUE(IsOneVectorInAnother(expected, result));
-}
-
-TEST(small_tests_suite, thousand_set_one_get) {
-    const size_t num = 1000;
-
-    std::vector<std::string> keys, vals;
-    for (size_t i = 0; i < num; ++i) {
-        keys.push_back("key_" + std::to_string(i));
-        vals.push_back("val_" + std::to_string(i));
-    }
-
-    MapGetFreshTopK<> map(std::chrono::seconds(1), 0.1, 12, 54);
-
-    for (size_t i = 0; i < num; ++i) {
-        map.set(keys[i], vals[i]);
-    }
-
-    auto result = map.get_top_k();
-
-    std::vector<std::string> expected{};
-
-    ASSERT_TRUE(IsOneVectorInAnother(expected, result));
-}
-
-TEST(small_tests_suite, million_set_one_get) {
-    const size_t num = 1000000;
-
-    std::vector<std::string> keys, vals;
-    for (size_t i = 0; i < num; ++i) {
-        keys.push_back("key_" + std::to_string(i));
-        vals.push_back("val_" + std::to_string(i));
-    }
-
-    MapGetFreshTopK<> map(std::chrono::seconds(1), 0.1, 12, 54);
-
-    for (size_t i = 0; i < num; ++i) {
-        map.set(keys[i], vals[i]);
-    }
-
-    auto result = map.get_top_k();
-
-    std::vector<std::string> expected{};
-
-    ASSERT_TRUE(IsOneVectorInAnother(expected, result));
-}
-
-TEST(small_tests_suite, million_same_set_one_get) {
-    const size_t num = 1000000;
-
-    std::vector<std::string> keys, vals;
-    for (size_t i = 0; i < num; ++i) {
-        keys.emplace_back("key_1");
-        vals.push_back("val_" + std::to_string(i));
-    }
-
-    MapGetFreshTopK<> map(std::chrono::seconds(1), 0.1, 12, 54);
-
-    for (size_t i = 0; i < num; ++i) {
-        map.set(keys[i], vals[i]);
-    }
-
-    auto result = map.get_top_k();
-
-    std::vector<std::string> expected{"key_1"};
-
-    ASSERT_TRUE(IsOneVectorInAnother(expected, result));
-}
-
-// ONE HOTKEY
-// beginning
-TEST(one_hotkey_at_the_beginning_one_get_suite, _005hotrate_05shot_0snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.05, 1000, 500, 0, true));
-}
-
-TEST(one_hotkey_at_the_beginning_one_get_suite, _005hotrate_0shot_05snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.05, 1000, 0, 499, true));
-}
-
-TEST(one_hotkey_at_the_beginning_one_get_suite, _036hotrate_03shot_07snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.36, 1000, 300, 699, true));
-}
-
-TEST(one_hotkey_at_the_beginning_one_get_suite, _020hotrate_05shot_05snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.20, 1000, 500, 499, true));
-}
-
-TEST(one_hotkey_at_the_beginning_one_get_suite, _023hotrate_05shot_05snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.23, 1000, 500, 499, true));
-}
-
-TEST(one_hotkey_at_the_beginning_one_get_suite, _100hotrate_012shot_088snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(1, 1000, 120, 879, true));
-}
-
-// end
-TEST(one_hotkey_at_the_end_one_get_suite, _005hotrate_05shot_0snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.05, 1000, 500, 0, false));
-}
-
-TEST(one_hotkey_at_the_end_one_get_suite, _005hotrate_0shot_05snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.05, 1000, 0, 499, false));
-}
-
-TEST(one_hotkey_at_the_end_one_get_suite, _036hotrate_03shot_07snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.36, 1000, 300, 699, false));
-}
-
-TEST(one_hotkey_at_the_end_one_get_suite, _020hotrate_05shot_05snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.20, 1000, 500, 499, false));
-}
-
-TEST(one_hotkey_at_the_end_one_get_suite, _023hotrate_05shot_05snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.23, 1000, 500, 499, false));
-}
-
-TEST(one_hotkey_at_the_end_one_get_suite, _100hotrate_012shot_088snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(1, 1000, 120, 879, false));
-}
-
-
-// MANY HOTKEYS
-// beginning
-TEST(many_hotkeys_at_the_beginning_one_get_suite, _050hotrate_05shot_0snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 3, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 3, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 3, 1000));
-
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 7, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 7, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 7, 1000));
-
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 10, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 10, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 10, 1000));
-}
-
-TEST(many_hotkeys_at_the_beginning_one_get_suite, _050hotrate_05shot_05snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 3, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 3, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 3, 1000));
-
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 7, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 7, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 7, 1000));
-
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 10, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 10, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 10, 1000));
-}
-
-TEST(many_hotkeys_at_the_beginning_one_get_suite, _0_2shotrate_0_8shot_1_5snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 3, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 3, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 3, 1000));
-
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 7, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 7, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 7, 1000));
-
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 10, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 10, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 10, 1000));
-}
-
-TEST(many_hotkeys_at_the_beginning_one_get_suite, _0_8shotrate_0_2shot_0snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 3, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 3, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 3, 1000));
-
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 7, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 7, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 7, 1000));
-
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 10, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 10, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 10, 1000));
-}
-
-// end
-TEST(many_hotkeys_at_the_end_one_get_suite, _050hotrate_05shot_0snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 3, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 3, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 3, 1000));
-
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 7, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 7, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 7, 1000));
-
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 10, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 10, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 10, 1000));
-}
-
-TEST(many_hotkeys_at_the_end_one_get_suite, _050hotrate_05shot_05snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 3, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 3, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 3, 1000));
-
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 7, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 7, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 7, 1000));
-
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 10, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 10, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 10, 1000));
-}
-
-TEST(many_hotkeys_at_the_end_one_get_suite, _0_2shotrate_0_8shot_1_5snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 3, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 3, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 3, 1000));
-
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 7, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 7, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 7, 1000));
-
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 10, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 10, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 10, 1000));
-}
-
-TEST(many_hotkeys_at_the_end_one_get_suite, _0_8shotrate_0_2shot_0snothot_then_one_get) {
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 3, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 3, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 3, 1000));
-
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 7, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 7, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 7, 1000));
-
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 10, 10));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 10, 100));
-    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 10, 1000));
-}
-
-// LONG TESTS (because each test includes a lot of tests) each can take <15 minutes (their time is random, for me ALL tests take 15 minutes)
-TEST(long_long_tests_one_hotkey, hotkey_at_the_beginning) {
-    ASSERT_TRUE(TestSpecificParametersBeginning());
-}
-
-TEST(long_long_tests_one_hotkey, hotkey_at_the_end) {
-    ASSERT_TRUE(TestSpecificParametersEnd());
-}
-
-TEST(long_long_tests_one_hotkey, hotkey_at_random_beginning_or_end) {
-    ASSERT_TRUE(TestRandomParametersBeginningOrEnd());
-}
-
-TEST(long_long_tests_many_hotkeys, hotkey_at_random_beginning_or_end) {
-    ASSERT_TRUE(TestRandomParametersBeginningOrEndManyKeys());
-}
-
-TEST(long_long_tests_one_hotkey, bad_tests) {
-    ASSERT_TRUE(BadTests());
-}
-
-int main(int argc, char **argv) {
-    testing::InitGoogleTest(&argc, argv);
-    return RUN_ALL_TESTS();
+#include "gtest/gtest.h"
+#include "map_get_fresh_top_k.h"
+#include "mapped_map_get_fresh_top_k.h"
+#include "concurrent_map_get_fresh_top_k.h"
+#include "single_flight.h"
+#include "timing_wheel.h"
+#include "shared_frequency_estimation_analyzer.h"
+#include "fixed_frequency_estimation_analyzer.h"
+#include "hierarchical_frequency_estimation_analyzer.h"
+#include "multi_dimensional_frequency_estimation_analyzer.h"
+
+#include <math.h>
+
+#include <set>
+#include <ctime>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <algorithm>
+// uncomment to disable assert()
+// #define NDEBUG
+#include <cassert>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "accurate_frequency_analyzer.h"
+#include "utility_functions.h"
+
+// Use (void) to silent unused warnings.
+#define assertm(exp, msg) assert(((void)msg, exp))
+
+// For google test custom messages
+#define GTEST_COUT std::cerr << "[          ] [ INFO ]"
+
+TEST(small_tests_suite, one_set_one_get) {
+    std::string key1 = "key_1";
+    std::string val1 = "val_1";
+
+    MapGetFreshTopK<> map(std::chrono::seconds(1), 0.1, 12, 54);;
+
+    map.set(key1, val1);
+    auto result = map.get_top_k();
+
+    std::vector<std::string> expected{key1};
+
+    ASSERT_TRUE(IsOneVectorInAnother(expected, result));
+}
+
+TEST(small_tests_suite, dozen_set_one_get) {
+    const size_t num = 10;
+
+    std::vector<std::string> keys, vals;
+    for (size_t i = 0; i < num; ++i) {
+        keys.push_back("key_" + std::to_string(i));
+        vals.push_back("val_" + std::to_string(i));
+    }
+
+    MapGetFreshTopK<> map(std::chrono::seconds(1), 0.1, 12, 54);
+
+    for (size_t i = 0; i < num; ++i) {
+        map.set(keys[i], vals[i]);
+    }
+
+    auto result = map.get_top_k();
+
+    std::vector<std::string> expected{keys};
+
+    ASSERT_TRUE(IsOneVectorInAnother(expected, result));
+}
+
+TEST(small_tests_suite, thousand_set_one_get) {
+    const size_t num = 1000;
+
+    std::vector<std::string> keys, vals;
+    for (size_t i = 0; i < num; ++i) {
+        keys.push_back("key_" + std::to_string(i));
+        vals.push_back("val_" + std::to_string(i));
+    }
+
+    MapGetFreshTopK<> map(std::chrono::seconds(1), 0.1, 12, 54);
+
+    for (size_t i = 0; i < num; ++i) {
+        map.set(keys[i], vals[i]);
+    }
+
+    auto result = map.get_top_k();
+
+    std::vector<std::string> expected{};
+
+    ASSERT_TRUE(IsOneVectorInAnother(expected, result));
+}
+
+TEST(small_tests_suite, million_set_one_get) {
+    const size_t num = 1000000;
+
+    std::vector<std::string> keys, vals;
+    for (size_t i = 0; i < num; ++i) {
+        keys.push_back("key_" + std::to_string(i));
+        vals.push_back("val_" + std::to_string(i));
+    }
+
+    MapGetFreshTopK<> map(std::chrono::seconds(1), 0.1, 12, 54);
+
+    for (size_t i = 0; i < num; ++i) {
+        map.set(keys[i], vals[i]);
+    }
+
+    auto result = map.get_top_k();
+
+    std::vector<std::string> expected{};
+
+    ASSERT_TRUE(IsOneVectorInAnother(expected, result));
+}
+
+TEST(small_tests_suite, million_same_set_one_get) {
+    const size_t num = 1000000;
+
+    std::vector<std::string> keys, vals;
+    for (size_t i = 0; i < num; ++i) {
+        keys.emplace_back("key_1");
+        vals.push_back("val_" + std::to_string(i));
+    }
+
+    MapGetFreshTopK<> map(std::chrono::seconds(1), 0.1, 12, 54);
+
+    for (size_t i = 0; i < num; ++i) {
+        map.set(keys[i], vals[i]);
+    }
+
+    auto result = map.get_top_k();
+
+    std::vector<std::string> expected{"key_1"};
+
+    ASSERT_TRUE(IsOneVectorInAnother(expected, result));
+}
+
+// ONE HOTKEY
+// beginning
+TEST(one_hotkey_at_the_beginning_one_get_suite, _005hotrate_05shot_0snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.05, 1000, 500, 0, true));
+}
+
+TEST(one_hotkey_at_the_beginning_one_get_suite, _005hotrate_0shot_05snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.05, 1000, 0, 499, true));
+}
+
+TEST(one_hotkey_at_the_beginning_one_get_suite, _036hotrate_03shot_07snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.36, 1000, 300, 699, true));
+}
+
+TEST(one_hotkey_at_the_beginning_one_get_suite, _020hotrate_05shot_05snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.20, 1000, 500, 499, true));
+}
+
+TEST(one_hotkey_at_the_beginning_one_get_suite, _023hotrate_05shot_05snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.23, 1000, 500, 499, true));
+}
+
+TEST(one_hotkey_at_the_beginning_one_get_suite, _100hotrate_012shot_088snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(1, 1000, 120, 879, true));
+}
+
+// end
+TEST(one_hotkey_at_the_end_one_get_suite, _005hotrate_05shot_0snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.05, 1000, 500, 0, false));
+}
+
+TEST(one_hotkey_at_the_end_one_get_suite, _005hotrate_0shot_05snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.05, 1000, 0, 499, false));
+}
+
+TEST(one_hotkey_at_the_end_one_get_suite, _036hotrate_03shot_07snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.36, 1000, 300, 699, false));
+}
+
+TEST(one_hotkey_at_the_end_one_get_suite, _020hotrate_05shot_05snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.20, 1000, 500, 499, false));
+}
+
+TEST(one_hotkey_at_the_end_one_get_suite, _023hotrate_05shot_05snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.23, 1000, 500, 499, false));
+}
+
+TEST(one_hotkey_at_the_end_one_get_suite, _100hotrate_012shot_088snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(1, 1000, 120, 879, false));
+}
+
+
+// MANY HOTKEYS
+// beginning
+TEST(many_hotkeys_at_the_beginning_one_get_suite, _050hotrate_05shot_0snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 3, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 3, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 3, 1000));
+
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 7, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 7, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 7, 1000));
+
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 10, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 10, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, true, 10, 1000));
+}
+
+TEST(many_hotkeys_at_the_beginning_one_get_suite, _050hotrate_05shot_05snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 3, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 3, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 3, 1000));
+
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 7, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 7, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 7, 1000));
+
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 10, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 10, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, true, 10, 1000));
+}
+
+TEST(many_hotkeys_at_the_beginning_one_get_suite, _0_2shotrate_0_8shot_1_5snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 3, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 3, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 3, 1000));
+
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 7, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 7, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 7, 1000));
+
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 10, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 10, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, true, 10, 1000));
+}
+
+TEST(many_hotkeys_at_the_beginning_one_get_suite, _0_8shotrate_0_2shot_0snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 3, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 3, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 3, 1000));
+
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 7, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 7, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 7, 1000));
+
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 10, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 10, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, true, 10, 1000));
+}
+
+// end
+TEST(many_hotkeys_at_the_end_one_get_suite, _050hotrate_05shot_0snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 3, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 3, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 3, 1000));
+
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 7, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 7, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 7, 1000));
+
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 10, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 10, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 0, false, 10, 1000));
+}
+
+TEST(many_hotkeys_at_the_end_one_get_suite, _050hotrate_05shot_05snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 3, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 3, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 3, 1000));
+
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 7, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 7, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 7, 1000));
+
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 10, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 10, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 500, 499, false, 10, 1000));
+}
+
+TEST(many_hotkeys_at_the_end_one_get_suite, _0_2shotrate_0_8shot_1_5snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 3, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 3, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 3, 1000));
+
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 7, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 7, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 7, 1000));
+
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 10, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 10, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 200, 799, false, 10, 1000));
+}
+
+TEST(many_hotkeys_at_the_end_one_get_suite, _0_8shotrate_0_2shot_0snothot_then_one_get) {
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 3, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 3, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 3, 1000));
+
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 7, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 7, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 7, 1000));
+
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 10, 10));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 10, 100));
+    ASSERT_TRUE(HotkeysAtTheBeginningOrEndOnlyOneGet(0.50, 1000, 800, 199, false, 10, 1000));
+}
+
+// MEMORY-MAPPED VALUES
+TEST(mmap_value_store_suite, set_get_overwrite_erase) {
+    MmapValueStore<> store(testing::TempDir() + "mmap_value_store_set_get.seg", 4096, 2);
+
+    const std::string big_value(10000, 'x');
+    for (size_t i = 0; i < 1000; ++i) {
+        store.set("key_" + std::to_string(i), "val_" + std::to_string(i));
+    }
+    store.set("key_big", big_value);
+    store.set("key_1", "val_1_changed");
+
+    ASSERT_TRUE(store.get("key_0") == "val_0");
+    ASSERT_TRUE(store.get("key_999") == "val_999");
+    ASSERT_TRUE(store.get("key_1") == "val_1_changed");
+    ASSERT_TRUE(store.get("key_big") == big_value);
+    ASSERT_TRUE(store.get("key_none").empty());
+
+    ASSERT_TRUE(store.erase("key_big"));
+    ASSERT_FALSE(store.contains("key_big"));
+    ASSERT_EQ(store.size(), 1000);
+}
+
+TEST(mmap_value_store_suite, compaction_keeps_live_values) {
+    MmapValueStore<> store(testing::TempDir() + "mmap_value_store_compaction.seg", 4096, 0.5);
+
+    for (size_t round = 0; round < 20; ++round) {
+        for (size_t i = 0; i < 100; ++i) {
+            store.set("key_" + std::to_string(i), std::string(100, 'v') + std::to_string(round));
+        }
+    }
+
+    // Automatic compaction doesn't let garbage exceed the threshold
+    ASSERT_LE(store.segment_bytes() - store.live_bytes(), store.segment_bytes() / 2);
+
+    store.Compact();
+    ASSERT_EQ(store.segment_bytes(), store.live_bytes());
+    for (size_t i = 0; i < 100; ++i) {
+        ASSERT_TRUE(store.get("key_" + std::to_string(i)) == std::string(100, 'v') + "19");
+    }
+}
+
+TEST(mmap_value_store_suite, set_from_own_view) {
+    MmapValueStore<> store(testing::TempDir() + "mmap_value_store_own_view.seg", 4096, 2);
+    const std::string value(3000, 'x');
+    store.set("a", value);
+    // The segment grows and is remapped while the value is copied from it
+    const MappedValue view = store.get("a");
+    store.set("b", view.data, view.size);
+    ASSERT_TRUE(store.get("a") == value);
+    ASSERT_TRUE(store.get("b") == value);
+}
+
+TEST(mmap_value_store_suite, mapped_map_get_top_k) {
+    MappedMapGetFreshTopK<> map(testing::TempDir() + "mapped_map_get_top_k.seg", std::chrono::seconds(1), 0.1, 12,
+                                54);
+
+    map.set("key_hot", "val_hot");
+    for (size_t i = 0; i < 100; ++i) {
+        map.set("key_" + std::to_string(i), "val_" + std::to_string(i));
+        ASSERT_TRUE(map.get("key_hot") == "val_hot");
+    }
+
+    std::vector<std::string> expected{"key_hot"};
+
+    ASSERT_TRUE(IsOneVectorInAnother(expected, map.get_top_k()));
+}
+
+// MERGEABLE SUMMARIES
+TEST(frequency_summary_suite, serialize_deserialize) {
+    FrequencyEstimationAnalyzer<> analyzer(std::chrono::seconds(10), 0.1, 12, 54);
+    for (size_t i = 0; i < 1000; ++i) {
+        analyzer.AddKey(i % 3 == 0 ? "key_hot" : "key_" + std::to_string(i));
+    }
+
+    const FrequencySummary<> summary = analyzer.ExportWindowSummary();
+    const FrequencySummary<> restored = FrequencySummary<>::Deserialize(summary.Serialize());
+
+    ASSERT_EQ(restored.total_count(), 1000);
+    ASSERT_EQ(restored.error_bound(), summary.error_bound());
+    ASSERT_TRUE(restored.counters() == summary.counters());
+    ASSERT_THROW(FrequencySummary<>::Deserialize(summary.Serialize().substr(1)), std::invalid_argument);
+}
+
+TEST(frequency_summary_suite, merge_of_many_instances) {
+    const size_t num_instances = 4;
+    const size_t num_requests = 5000;
+
+    std::vector<FrequencyEstimationAnalyzer<>> instances;
+    for (size_t i = 0; i < num_instances; ++i) {
+        instances.emplace_back(std::chrono::seconds(10), 0.1, 12, 54);
+    }
+    AccurateFrequencyAnalyzer<> accurate_analyzer(std::chrono::seconds(10));
+
+    // "key_hot" is hot everywhere, "key_local_hot" is very hot on one instance only but still >= 10% globally
+    for (size_t i = 0; i < num_instances; ++i) {
+        for (size_t j = 0; j < num_requests; ++j) {
+            std::string key;
+            if (j % 5 == 0) {
+                key = "key_hot";
+            } else if (i == 0 && j % 10 < 9) {
+                key = "key_local_hot";
+            } else {
+                key = "key_" + std::to_string(rand() % 10000);
+            }
+            instances[i].AddKey(key);
+            accurate_analyzer.add(key);
+        }
+    }
+
+    FrequencySummary<> merged_summary(54);
+    FrequencyEstimationAnalyzer<> aggregator(std::chrono::seconds(10), 0.1, 12, 54);
+    for (size_t i = 0; i < num_instances; ++i) {
+        const std::string blob = instances[i].ExportWindowSummary().Serialize();
+        merged_summary.Merge(FrequencySummary<>::Deserialize(blob));
+        aggregator.Merge(FrequencySummary<>::Deserialize(blob));
+    }
+
+    std::vector<std::string> expected = accurate_analyzer.GetActualTop();
+    ASSERT_EQ(expected.size(), 2);
+    ASSERT_EQ(merged_summary.total_count(), num_instances * num_requests);
+    ASSERT_TRUE(IsOneVectorInAnother(expected, merged_summary.GetTopKKeys(0.1)));
+    ASSERT_TRUE(IsOneVectorInAnother(expected, aggregator.GetTopKKeys()));
+}
+
+// SHARED MEMORY ANALYZER
+TEST(shared_analyzer_suite, forked_workers_share_statistics) {
+    const std::string name = "/fresh_top_k_test_" + std::to_string(getpid());
+    const size_t num_workers = 4;
+
+    SharedFrequencyEstimationAnalyzer analyzer(name, std::chrono::seconds(10), 0.1, 12, 54);
+
+    std::vector<pid_t> workers;
+    for (size_t i = 0; i < num_workers; ++i) {
+        const pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            // Each worker alone sees "key_hot_<i>" at 40% of its requests, i.e. at 10% of the host requests
+            for (size_t j = 0; j < 2000; ++j) {
+                analyzer.AddKey(j % 5 < 2 ? "key_hot_" + std::to_string(i) : "key_common_hot");
+            }
+            _exit(0);
+        }
+        workers.push_back(pid);
+    }
+    for (size_t i = 0; i < workers.size(); ++i) {
+        int status;
+        waitpid(workers[i], &status, 0);
+        ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    // Another attached instance answers for the whole host
+    SharedFrequencyEstimationAnalyzer attached(name, std::chrono::seconds(10), 0.1, 12, 54);
+    std::vector<std::string> expected{"key_common_hot", "key_hot_0", "key_hot_1", "key_hot_2", "key_hot_3"};
+
+    ASSERT_TRUE(IsOneVectorInAnother(expected, attached.GetTopKKeys()));
+    ASSERT_EQ(attached.GetTopKKeys(1), std::vector<std::string>{"key_common_hot"});
+    ASSERT_THROW(SharedFrequencyEstimationAnalyzer(name, std::chrono::seconds(10), 0.1, 12, 10),
+                 std::invalid_argument);
+
+    SharedFrequencyEstimationAnalyzer::Unlink(name);
+}
+
+TEST(shared_analyzer_suite, dead_processes) {
+    const std::string name = "/fresh_top_k_test_dead_" + std::to_string(getpid());
+    SharedFrequencyEstimationAnalyzer analyzer(name, std::chrono::seconds(10), 0.1, 12, 54);
+    // Workers killed in the middle of AddKey leave no bucket locked
+    for (int i = 0; i < 5; ++i) {
+        const pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            while (true) {
+                analyzer.AddKey("key_hot");
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        kill(pid, SIGKILL);
+        int status;
+        waitpid(pid, &status, 0);
+        analyzer.AddKey("key_hot");
+    }
+    ASSERT_EQ(analyzer.GetTopKKeys(1), std::vector<std::string>{"key_hot"});
+    SharedFrequencyEstimationAnalyzer::Unlink(name);
+
+    // A segment whose creator has never initialized it
+    const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    ASSERT_THROW(SharedFrequencyEstimationAnalyzer(name, std::chrono::seconds(10), 0.1, 12, 54), std::runtime_error);
+    SharedFrequencyEstimationAnalyzer::Unlink(name);
+}
+
+// STRUCTURE-OF-ARRAYS BUCKETS
+TEST(soa_counter_bucket_suite, kernels_match_scalar_code) {
+    for (size_t size = 0; size < 70; ++size) {
+        std::vector<int64_t> counters(size), expected(size);
+        std::vector<uint64_t> fingerprints(size);
+        for (size_t i = 0; i < size; ++i) {
+            counters[i] = expected[i] = rand() % 4;
+            fingerprints[i] = rand() % 8;
+        }
+
+        ASSERT_EQ(counter_kernels::FindZero(counters.data(), size),
+                  std::find(counters.begin(), counters.end(), 0) - counters.begin());
+        ASSERT_EQ(counter_kernels::FindFingerprint(fingerprints.data(), size, 5),
+                  std::find(fingerprints.begin(), fingerprints.end(), 5) - fingerprints.begin());
+
+        std::vector<uint32_t> indices(size);
+        const size_t found = counter_kernels::CollectAtLeast(counters.data(), size, 2, indices.data());
+        ASSERT_EQ(found, std::count_if(counters.begin(), counters.end(), [](int64_t c) { return c >= 2; }));
+        for (size_t i = 0; i < found; ++i) {
+            ASSERT_GE(counters[indices[i]], 2);
+        }
+
+        counter_kernels::DecrementPositive(counters.data(), size);
+        for (size_t i = 0; i < size; ++i) {
+            ASSERT_EQ(counters[i], std::max<int64_t>(expected[i] - 1, 0));
+        }
+
+        ASSERT_EQ(counter_kernels::FindMin(expected.data(), size),
+                  size == 0 ? INT64_MAX : *std::min_element(expected.begin(), expected.end()));
+        counter_kernels::SubtractSaturating(expected.data(), size, 2);
+        for (size_t i = 0; i < size; ++i) {
+            ASSERT_EQ(expected[i], std::max<int64_t>(counters[i] - 1, 0));
+        }
+    }
+}
+
+TEST(soa_counter_bucket_suite, bucket_replaces_zero_counters) {
+    SoaCounterBucket<std::string> bucket(3);
+    std::hash<std::string> hash;
+    const std::string keys[] = {"a", "b", "c", "d"};
+
+    for (size_t i = 0; i < 3; ++i) {
+        ASSERT_EQ(bucket.TryInsert(keys[i], hash(keys[i]), 1), i);
+    }
+    ASSERT_EQ(bucket.TryInsert(keys[3], hash(keys[3]), 1), SoaCounterBucket<std::string>::npos);
+
+    ++bucket.counter(bucket.Find("b", hash("b")));
+    bucket.DecrementAll();
+    ASSERT_EQ(bucket.TryInsert(keys[3], hash(keys[3]), 1), 0);
+    ASSERT_EQ(bucket.Find("a", hash("a")), SoaCounterBucket<std::string>::npos);
+    ASSERT_EQ(bucket.counter(bucket.Find("b", hash("b"))), 1);
+    ASSERT_EQ(bucket.counter(bucket.Find("d", hash("d"))), 1);
+}
+
+// COMPILE-TIME CONFIGURED ANALYZER
+TEST(fixed_analyzer_suite, threshold_matches_runtime_formula) {
+    typedef FixedFrequencyEstimationAnalyzer<std::string, 12, 54, 1, 10> Analyzer;
+    static_assert(Analyzer::MinVeryFrequentCount(1000) == 100 - 17 - 2, "constexpr threshold");
+
+    for (int64_t n = 0; n < 100000; n += 7) {
+        const double expected = floor((double) n * 0.1) - ceil((double) n * 0.9 / 54) - 2;
+        ASSERT_EQ(Analyzer::MinVeryFrequentCount(n), (int64_t) expected);
+    }
+}
+
+TEST(fixed_analyzer_suite, hot_keys_among_noise) {
+    FixedFrequencyEstimationAnalyzer<std::string, 12, 54, 1, 10> analyzer(std::chrono::seconds(10));
+    AccurateFrequencyAnalyzer<> accurate_analyzer(std::chrono::seconds(10));
+
+    for (size_t i = 0; i < 100000; ++i) {
+        std::string key;
+        if (i % 4 == 0) {
+            key = "key_hot_1";
+        } else if (i % 4 == 1 && i % 8 != 1) {
+            key = "key_hot_2";
+        } else {
+            key = GenerateRandomString(8);
+        }
+        analyzer.AddKey(key);
+        accurate_analyzer.add(key);
+    }
+
+    std::vector<std::string> expected = accurate_analyzer.GetActualTop();
+    ASSERT_EQ(expected.size(), 2);
+    ASSERT_TRUE(IsOneVectorInAnother(expected, analyzer.GetTopKKeys()));
+    ASSERT_EQ(analyzer.GetTopKKeys(1), std::vector<std::string>{"key_hot_1"});
+}
+
+// INTEGER KEYS
+TEST(integer_keys_suite, flat_map_matches_std_map) {
+    FlatIntegerMap<uint64_t, int> flat_map;
+    std::map<uint64_t, int> std_map;
+    std::mt19937_64 generator(31);
+
+    for (int i = 0; i < 200000; ++i) {
+        // Small key range, so there are a lot of collisions, erasures and reinsertions
+        const uint64_t key = generator() % 5000;
+        switch (generator() % 3) {
+            case 0:
+                flat_map[key] = i;
+                std_map[key] = i;
+                break;
+            case 1:
+                ASSERT_EQ(flat_map.erase(key), std_map.erase(key));
+                break;
+            default:
+                ASSERT_EQ(flat_map.find(key) == flat_map.end(), std_map.find(key) == std_map.end());
+                if (flat_map.find(key) != flat_map.end()) {
+                    ASSERT_EQ(flat_map.find(key)->second, std_map[key]);
+                }
+        }
+        ASSERT_EQ(flat_map.size(), std_map.size());
+    }
+
+    // References are stable while the table grows
+    int &value = flat_map[1u << 20];
+    value = -1;
+    for (uint64_t key = 0; key < 100000; ++key) {
+        flat_map[key + (1u << 21)] = 0;
+    }
+    ASSERT_EQ(flat_map[1u << 20], -1);
+    ASSERT_EQ(&value, &flat_map[1u << 20]);
+}
+
+TEST(integer_keys_suite, uint64_map_get_set_top_k) {
+    MapGetFreshTopK<uint64_t, std::string> map;
+    static_assert(std::is_same<decltype(map.get_top_k()), std::vector<uint64_t>>::value, "integer top");
+
+    for (uint64_t i = 0; i < 100000; ++i) {
+        const uint64_t key = i % 3 == 0 ? 42 : (i * 0x9e3779b97f4a7c15ULL);
+        map.set(key, std::to_string(key));
+    }
+    ASSERT_EQ(map.get(42), "42");
+    ASSERT_EQ(map.get(7 * 0x9e3779b97f4a7c15ULL), std::to_string(7 * 0x9e3779b97f4a7c15ULL));
+    ASSERT_EQ(map.get_top_k(), std::vector<uint64_t>{42});
+}
+
+#if defined(__SIZEOF_INT128__)
+TEST(integer_keys_suite, int128_keys) {
+    typedef unsigned __int128 Key;
+    const Key hot_key = (static_cast<Key>(1) << 100) + 5;
+    MapGetFreshTopK<Key, int> map;
+
+    for (int i = 0; i < 30000; ++i) {
+        map.set(i % 2 == 0 ? hot_key : (static_cast<Key>(i) << 64) + i, i);
+    }
+    ASSERT_EQ(map.get(hot_key), 29998);
+    ASSERT_EQ(map.get_top_k(), std::vector<Key>{hot_key});
+
+    FrequencySummary<Key> summary(4, 10, 0, std::map<Key, int64_t>{{hot_key, 7}});
+    ASSERT_EQ(FrequencySummary<Key>::Deserialize(summary.Serialize()).counters(), summary.counters());
+}
+#endif
+
+// WEIGHTED REQUESTS
+TEST(weighted_suite, heavy_key_among_frequent_light_keys) {
+    MapGetFreshTopK<std::string, std::string> map;
+    std::map<std::string, int64_t> weights;
+    int64_t total_weight = 0;
+
+    for (int i = 0; i < 100000; ++i) {
+        // "heavy" is only 2% of requests but ~50% of bytes, "light" is 30% of requests and ~7% of bytes
+        std::string key;
+        int64_t weight;
+        if (i % 50 == 0) {
+            key = "heavy";
+            weight = 1000;
+        } else if (i % 10 < 3) {
+            key = "light";
+            weight = 5;
+        } else {
+            key = GenerateRandomString(6);
+            weight = 1 + rand() % 10;
+        }
+        map.get(key, weight);
+        weights[key] += weight;
+        total_weight += weight;
+    }
+
+    ASSERT_GE(weights["heavy"] * 10, total_weight);
+    ASSERT_LT(weights["light"] * 10, total_weight);
+    ASSERT_EQ(map.get_top_k(), std::vector<std::string>{"heavy"});
+}
+
+TEST(weighted_suite, unit_weights_and_invalid_weights) {
+    FrequencyEstimationAnalyzer<std::string> unit(std::chrono::seconds(10));
+    FrequencyEstimationAnalyzer<std::string> weighted(std::chrono::seconds(10));
+    for (int i = 0; i < 50000; ++i) {
+        const std::string key = i % 5 == 0 ? "hot" : GenerateRandomString(4);
+        unit.AddKey(key);
+        weighted.AddKey(key, 1);
+    }
+    ASSERT_EQ(unit.ExportWindowSummary().counters(), weighted.ExportWindowSummary().counters());
+    ASSERT_EQ(weighted.GetTopKKeys(), std::vector<std::string>{"hot"});
+
+    ASSERT_THROW(weighted.AddKey("hot", 0), std::invalid_argument);
+    ASSERT_THROW(weighted.AddKey("hot", -5), std::invalid_argument);
+}
+
+// SAMPLING
+TEST(sampling_suite, sampled_top_matches_full_top) {
+    MapGetFreshTopK<std::string, std::string> map(std::chrono::seconds(10));
+    map.set_sampling_period(16);
+    AccurateFrequencyAnalyzer<> accurate_analyzer(std::chrono::seconds(10));
+
+    for (int i = 0; i < 400000; ++i) {
+        const std::string key = i % 4 == 0 ? "key_hot_1" : (i % 5 == 1 ? "key_hot_2" : GenerateRandomString(8));
+        map.get(key);
+        accurate_analyzer.add(key);
+    }
+
+    std::vector<std::string> expected = accurate_analyzer.GetActualTop();
+    ASSERT_EQ(expected.size(), 2);
+    ASSERT_TRUE(IsOneVectorInAnother(expected, map.get_top_k()));
+    ASSERT_EQ(map.get_top_k(1), std::vector<std::string>{"key_hot_1"});
+}
+
+TEST(sampling_suite, adaptive_period_follows_load) {
+    FrequencyEstimationAnalyzer<std::string> analyzer(std::chrono::milliseconds(120), 0.1, 12, 54);
+    analyzer.SetAdaptiveSampling(1000);
+    // The first bucket is created before the clock starts
+    analyzer.AddKey("key");
+    ASSERT_EQ(analyzer.sampling_period(), 1);
+
+    // Far more than 1000 requests per second for a few epochs
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+    while (std::chrono::steady_clock::now() < end) {
+        for (int i = 0; i < 1000; ++i) {
+            analyzer.AddKey("key");
+        }
+    }
+    ASSERT_GT(analyzer.sampling_period(), 1);
+
+    analyzer.SetAdaptiveSampling(0);
+    ASSERT_EQ(analyzer.sampling_period(), 1);
+    ASSERT_THROW(analyzer.SetSamplingPeriod(0), std::invalid_argument);
+}
+
+// DOORKEEPER
+TEST(doorkeeper_suite, admits_second_sighting_within_two_epochs) {
+    Doorkeeper doorkeeper(1000);
+    std::hash<std::string> hash;
+    ASSERT_FALSE(doorkeeper.Admit(hash("a")));
+    ASSERT_TRUE(doorkeeper.Admit(hash("a")));
+
+    doorkeeper.Rotate();
+    ASSERT_TRUE(doorkeeper.Admit(hash("a")));
+    ASSERT_FALSE(doorkeeper.Admit(hash("b")));
+
+    doorkeeper.Rotate();
+    doorkeeper.Rotate();
+    ASSERT_FALSE(doorkeeper.Admit(hash("a")));
+
+    // ~1% of one-hit keys get through
+    size_t admitted = 0;
+    for (int i = 0; i < 1000; ++i) {
+        admitted += doorkeeper.Admit(hash("key_" + std::to_string(i)));
+    }
+    ASSERT_LT(admitted, 50);
+}
+
+TEST(doorkeeper_suite, count_correction_once) {
+    Doorkeeper doorkeeper(1000);
+    std::hash<std::string> hash;
+    int64_t rejected_weight;
+    bool rejected_in_previous_epoch;
+    ASSERT_FALSE(doorkeeper.Admit(hash("a"), 5, rejected_weight, rejected_in_previous_epoch));
+    ASSERT_EQ(rejected_weight, 0);
+    doorkeeper.Rotate();
+    // The rejected weight is reported by the first admission only
+    ASSERT_TRUE(doorkeeper.Admit(hash("a"), 1, rejected_weight, rejected_in_previous_epoch));
+    ASSERT_EQ(rejected_weight, 5);
+    ASSERT_TRUE(rejected_in_previous_epoch);
+    ASSERT_TRUE(doorkeeper.Admit(hash("a"), 1, rejected_weight, rejected_in_previous_epoch));
+    ASSERT_EQ(rejected_weight, 0);
+
+    // A counter recreated after an eviction doesn't get the correction again: "a" is requested 52 times
+    FrequencyEstimationAnalyzer<std::string> analyzer(std::chrono::seconds(60), 0.1, 12, 2);
+    analyzer.EnableDoorkeeper(1000);
+    // "b" evicts "a" and "c", then "d" and "e" take their slots
+    const char *keys[] = {"a", "a", "c", "c", "b", "b", "d", "d", "e", "e"};
+    const int64_t weights[] = {1, 1, 1, 1, 100, 1, 1, 1, 1, 1};
+    for (int i = 0; i < 10; ++i) {
+        analyzer.AddKey(keys[i], weights[i]);
+    }
+    analyzer.AddKey("a", 50);
+    ASSERT_LE(analyzer.EstimateFrequency("a"), 52);
+}
+
+TEST(doorkeeper_suite, long_tail_traffic) {
+    MapGetFreshTopK<std::string, std::string> map(std::chrono::seconds(10));
+    map.enable_doorkeeper(200000);
+    AccurateFrequencyAnalyzer<> accurate_analyzer(std::chrono::seconds(10));
+
+    for (int i = 0; i < 200000; ++i) {
+        const std::string key = i % 5 == 0 ? "key_hot_1" : (i % 7 == 1 ? "key_hot_2" : GenerateRandomString(10));
+        map.get(key);
+        accurate_analyzer.add(key);
+    }
+
+    std::vector<std::string> expected = accurate_analyzer.GetActualTop();
+    ASSERT_EQ(expected.size(), 2);
+    ASSERT_TRUE(IsOneVectorInAnother(expected, map.get_top_k()));
+    ASSERT_EQ(map.get_top_k(1), std::vector<std::string>{"key_hot_1"});
+}
+
+// FRONT CACHE
+TEST(front_cache_suite, hot_keys_are_served_from_front_cache) {
+    MapGetFreshTopK<std::string, std::string> map(std::chrono::milliseconds(120));
+    map.set("key_hot", "value");
+    std::hash<std::string> hash;
+
+    // A few epochs of traffic, the cache is refreshed at every rotation
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(40);
+    while (std::chrono::steady_clock::now() < end) {
+        for (int i = 0; i < 100; ++i) {
+            map.get(i % 3 == 0 ? "key_hot" : GenerateRandomString(8));
+        }
+    }
+
+    ASSERT_EQ(map.front_cache().size(), 1);
+    std::string *cached = map.front_cache().Find("key_hot", hash("key_hot"));
+    ASSERT_NE(cached, nullptr);
+    ASSERT_EQ(cached, &map.get("key_hot"));
+
+    // Writes go through the cached pointer to the map value
+    map.set("key_hot", "new_value");
+    ASSERT_EQ(*cached, "new_value");
+    ASSERT_EQ(map.get("key_hot"), "new_value");
+    ASSERT_EQ(map.get("key_cold"), "");
+}
+
+// CACHE MODE
+TEST(cache_mode_suite, policy_keeps_frequent_keys_during_scan) {
+    TinyLfuPolicy<int> policy(100);
+    std::vector<int> evicted;
+    // Keys < 10 are hot
+    auto frequency = [](int key) { return key < 10 ? 1000 : 0; };
+
+    for (int key = 0; key < 100; ++key) {
+        policy.Insert(key, frequency, evicted);
+    }
+    ASSERT_TRUE(evicted.empty());
+    for (int key = 100; key < 10000; ++key) {
+        policy.Insert(key, frequency, evicted);
+        ASSERT_LE(policy.size(), 100);
+    }
+    ASSERT_EQ(evicted.size(), 9900);
+    for (int key = 0; key < 10; ++key) {
+        ASSERT_TRUE(policy.Contains(key));
+    }
+    // Cold keys are evicted in LRU order
+    ASSERT_TRUE(policy.Contains(9999));
+    ASSERT_FALSE(policy.Contains(100));
+
+    policy.SetCapacity(20, frequency, evicted);
+    ASSERT_EQ(policy.size(), 20);
+    ASSERT_TRUE(policy.Contains(9999));
+}
+
+TEST(cache_mode_suite, bounded_map_with_hot_keys) {
+    MapGetFreshTopK<std::string, std::string> map(std::chrono::seconds(10));
+    map.set_capacity(1000);
+
+    for (int i = 0; i < 100000; ++i) {
+        if (i % 4 == 0) {
+            std::string *value = map.try_get("key_hot");
+            if (value == nullptr) {
+                map.set("key_hot", "hot_value");
+            }
+        } else {
+            const std::string key = GenerateRandomString(10);
+            if (map.try_get(key) == nullptr) {
+                map.set(key, key);
+            }
+        }
+        ASSERT_LE(map.size(), 1000);
+    }
+
+    ASSERT_NE(map.try_get("key_hot"), nullptr);
+    ASSERT_EQ(*map.try_get("key_hot"), "hot_value");
+    ASSERT_EQ(map.try_get("key_missing"), nullptr);
+    ASSERT_EQ(map.size(), 1000);
+    ASSERT_TRUE(map.erase("key_hot"));
+    ASSERT_EQ(map.try_get("key_hot"), nullptr);
+    ASSERT_FALSE(map.erase("key_hot"));
+
+    map.set_capacity(10);
+    ASSERT_EQ(map.size(), 10);
+
+    MapGetFreshTopK<std::string, std::string> filled_map;
+    filled_map.set("key", "value");
+    ASSERT_THROW(filled_map.set_capacity(10), std::logic_error);
+}
+
+// MEMORY ACCOUNTING
+TEST(memory_usage_suite, map_usage_by_component) {
+    MapGetFreshTopK<std::string, std::string> map;
+    const MemoryUsage empty_usage = map.memory_usage();
+    ASSERT_EQ(empty_usage.values, 0);
+    ASSERT_EQ(empty_usage.total(), empty_usage.keys + empty_usage.counters + empty_usage.values + empty_usage.overhead);
+
+    for (int i = 0; i < 1000; ++i) {
+        // Values are longer than any short string buffer
+        map.set("key_" + std::to_string(i), std::string(100, 'v'));
+    }
+    const MemoryUsage usage = map.memory_usage();
+    ASSERT_GE(usage.values, 1000 * (sizeof(std::string) + 101));
+    ASSERT_GE(usage.keys, 1000 * sizeof(std::string));
+    ASSERT_GT(usage.counters, 0);
+    ASSERT_GT(usage.overhead, 1000 * memory_usage_detail::kTreeNodeOverhead);
+
+    MapGetFreshTopK<uint64_t, uint64_t> integer_map;
+    for (uint64_t i = 0; i < 1000; ++i) {
+        integer_map.set(i, i);
+    }
+    ASSERT_GE(integer_map.memory_usage().values, 1000 * sizeof(std::pair<const uint64_t, uint64_t>));
+    ASSERT_LT(integer_map.memory_usage().total(), usage.total());
+}
+
+TEST(memory_usage_suite, sizing_from_budget) {
+    typedef FrequencyEstimationAnalyzer<std::string> Analyzer;
+    const AnalyzerSizing sizing = Analyzer::ChooseSizing(1 << 20, 0.1, 0.01);
+    ASSERT_EQ(sizing.bucket_size, 90);
+    ASSERT_EQ(sizing.num_buckets, 12);
+    ASSERT_LE(sizing.memory_bytes, 1 << 20);
+
+    // A small budget gets fewer buckets, a tiny one is an error
+    const size_t budget = Analyzer::EstimateMemory(3, 90) + 100;
+    ASSERT_EQ(Analyzer::ChooseSizing(budget, 0.1, 0.01).num_buckets, 3);
+    ASSERT_THROW(Analyzer::ChooseSizing(1000, 0.1, 0.01), std::invalid_argument);
+    ASSERT_THROW(Analyzer::ChooseSizing(1 << 20, 0.1, 0.2), std::invalid_argument);
+
+    // The estimate bounds the real memory of the analyzer with short keys (only the first buckets exist yet)
+    Analyzer analyzer = Analyzer::FromMemoryBudget(std::chrono::seconds(10), budget, 0.1, 0.01);
+    for (int i = 0; i < 100000; ++i) {
+        analyzer.AddKey(GenerateRandomString(8));
+    }
+    ASSERT_LE(analyzer.memory_usage().total(), budget);
+    ASSERT_GE(analyzer.memory_usage().counters, 90 * (sizeof(int64_t) + sizeof(uint64_t)));
+}
+
+// HOT SET
+TEST(hot_set_suite, bounded_queue) {
+    ASSERT_THROW(BoundedQueue<int>(6), std::invalid_argument);
+
+    BoundedQueue<int> queue(4);
+    int value = 0;
+    ASSERT_FALSE(queue.TryPop(value));
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(queue.TryPush(i));
+    }
+    ASSERT_FALSE(queue.TryPush(4));
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(queue.TryPop(value));
+        ASSERT_EQ(value, i);
+    }
+    ASSERT_FALSE(queue.TryPop(value));
+
+    // Every pushed element is popped exactly once
+    BoundedQueue<int64_t> shared_queue(64);
+    const int64_t per_producer = 10000;
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 2; ++t) {
+        producers.emplace_back([&shared_queue, per_producer]() {
+            for (int64_t i = 1; i <= per_producer; ++i) {
+                while (!shared_queue.TryPush(i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    int64_t sum = 0;
+    for (int64_t popped = 0; popped < 2 * per_producer;) {
+        int64_t element;
+        if (shared_queue.TryPop(element)) {
+            sum += element;
+            ++popped;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    for (size_t t = 0; t < producers.size(); ++t) {
+        producers[t].join();
+    }
+    ASSERT_EQ(sum, per_producer * (per_producer + 1));
+}
+
+TEST(hot_set_suite, entered_and_left) {
+    FrequencyEstimationAnalyzer<std::string> analyzer(std::chrono::milliseconds(120), 0.1, 12, 54);
+    std::vector<HotSetChange<std::string>> changes;
+    analyzer.Subscribe([&changes](const HotSetChange<std::string> &change) {
+        changes.push_back(change);
+    });
+    BoundedQueue<HotSetChange<std::string>> queue(1024);
+    const size_t queue_subscription = analyzer.Subscribe(queue);
+
+    const std::string hot_keys[] = {"hot_a", "hot_b"};
+    for (int phase = 0; phase < 2; ++phase) {
+        const std::chrono::steady_clock::time_point end =
+                std::chrono::steady_clock::now() + std::chrono::milliseconds(300);
+        for (int i = 0; std::chrono::steady_clock::now() < end; ++i) {
+            analyzer.AddKey(i % 2 == 0 ? hot_keys[phase] : GenerateRandomString(8));
+        }
+    }
+    analyzer.Unsubscribe(queue_subscription);
+
+    // "hot_a" enters, later "hot_b" enters and "hot_a" leaves
+    int entered_a = -1, entered_b = -1, left_a = -1;
+    for (size_t i = 0; i < changes.size(); ++i) {
+        ASSERT_FALSE(changes[i].entered.empty() && changes[i].left.empty());
+        if (i > 0) {
+            ASSERT_GT(changes[i].epoch, changes[i - 1].epoch);
+        }
+        for (const std::string &key : changes[i].entered) {
+            if (key == "hot_a" && entered_a == -1) entered_a = i;
+            if (key == "hot_b" && entered_b == -1) entered_b = i;
+        }
+        for (const std::string &key : changes[i].left) {
+            if (key == "hot_a" && left_a == -1) left_a = i;
+        }
+    }
+    ASSERT_GE(entered_a, 0);
+    ASSERT_GT(entered_b, entered_a);
+    ASSERT_GT(left_a, entered_a);
+
+    // The queue got the same changes
+    HotSetChange<std::string> change;
+    for (size_t i = 0; i < changes.size(); ++i) {
+        ASSERT_TRUE(queue.TryPop(change));
+        ASSERT_EQ(change.epoch, changes[i].epoch);
+        ASSERT_EQ(change.entered, changes[i].entered);
+    }
+    ASSERT_FALSE(queue.TryPop(change));
+}
+
+// HIERARCHICAL KEYS
+TEST(hierarchical_suite, hot_prefix_without_hot_keys) {
+    HierarchicalFrequencyEstimationAnalyzer analyzer('/', 4);
+    ASSERT_EQ(analyzer.levels_count(), 5);
+    for (int i = 0; i < 100000; ++i) {
+        analyzer.AddKey(i % 4 == 0 ? "/api/v2/user/" + GenerateRandomString(8) : "/" + GenerateRandomString(8));
+    }
+
+    const std::vector<std::string> user_level = analyzer.GetTopKKeys(3);
+    ASSERT_NE(std::find(user_level.begin(), user_level.end(), "/api/v2/user/"), user_level.end());
+    ASSERT_TRUE(analyzer.GetTopKKeys(4).empty());
+
+    const std::vector<std::string> hot = analyzer.GetHotPrefixes();
+    ASSERT_EQ(hot, std::vector<std::string>({"/", "/api/", "/api/v2/", "/api/v2/user/"}));
+    ASSERT_THROW(analyzer.GetTopKKeys(5), std::invalid_argument);
+}
+
+TEST(hierarchical_suite, prefix_lengths) {
+    ASSERT_THROW(HierarchicalFrequencyEstimationAnalyzer(std::vector<size_t>({3, 3})), std::invalid_argument);
+
+    HierarchicalFrequencyEstimationAnalyzer analyzer(std::vector<size_t>({2, 4}));
+    for (int i = 0; i < 100000; ++i) {
+        // Short keys are their own prefixes
+        analyzer.AddKey(i % 3 == 0 ? "abcd" + GenerateRandomString(6) : (i % 3 == 1 ? "x" : GenerateRandomString(6)));
+    }
+    const std::vector<std::string> hot = analyzer.GetHotPrefixes();
+    ASSERT_NE(std::find(hot.begin(), hot.end(), "ab"), hot.end());
+    ASSERT_NE(std::find(hot.begin(), hot.end(), "abcd"), hot.end());
+    ASSERT_NE(std::find(hot.begin(), hot.end(), "x"), hot.end());
+    ASSERT_EQ(std::count(hot.begin(), hot.end(), "x"), 1);
+    ASSERT_GT(analyzer.memory_usage().counters, 0);
+
+    // Fingerprints of prefixes computed in one pass are the hashes of the prefixes
+    const std::string key = "/api/v2";
+    uint64_t state = PrefixHash::Begin();
+    for (size_t i = 0; i < key.size(); ++i) {
+        state = PrefixHash::Update(state, key[i]);
+        ASSERT_EQ(PrefixHash::Finalize(state), PrefixHash()(key.substr(0, i + 1)));
+    }
+}
+
+// DISTINCT KEYS
+TEST(distinct_keys_suite, hyper_log_log) {
+    ASSERT_THROW(HyperLogLog(3), std::invalid_argument);
+
+    HyperLogLog first(12), second(12), both(12);
+    for (uint64_t i = 0; i < 100000; ++i) {
+        const uint64_t hash = IntegerKeyHash<uint64_t>::Mix(i);
+        (i < 60000 ? first : second).Add(hash);
+        both.Add(hash);
+        // Repeats don't change the sketch
+        both.Add(hash);
+    }
+    ASSERT_NEAR(first.Estimate(), 60000, 60000 * 0.05);
+    first.Merge(second);
+    ASSERT_EQ(first.Estimate(), both.Estimate());
+    ASSERT_NEAR(both.Estimate(), 100000, 100000 * 0.05);
+    ASSERT_THROW(first.Merge(HyperLogLog(10)), std::invalid_argument);
+
+    // Small cardinalities are counted almost exactly
+    HyperLogLog small(12);
+    for (uint64_t i = 0; i < 100; ++i) {
+        small.Add(IntegerKeyHash<uint64_t>::Mix(i));
+    }
+    ASSERT_NEAR(small.Estimate(), 100, 3);
+}
+
+TEST(distinct_keys_suite, window) {
+    MapGetFreshTopK<std::string, int> map(std::chrono::milliseconds(300));
+    ASSERT_THROW(map.distinct_keys_count(), std::logic_error);
+    map.enable_distinct_keys_count();
+
+    std::set<std::string> keys;
+    for (int i = 0; i < 20000; ++i) {
+        const std::string key = GenerateRandomString(8);
+        keys.insert(key);
+        map.set(key, i);
+        map.get(key);
+    }
+    ASSERT_NEAR((double) map.distinct_keys_count(), (double) keys.size(), keys.size() * 0.05);
+
+    // Old epochs leave the window
+    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    for (int i = 0; i < 10; ++i) {
+        map.get("key_" + std::to_string(i));
+    }
+    ASSERT_NEAR((double) map.distinct_keys_count(), 10, 1);
+}
+
+// ASYNCHRONOUS ANALYZER
+TEST(async_suite, producers_and_snapshot) {
+    AsyncFrequencyEstimationAnalyzer<std::string> analyzer(FrequencyEstimationAnalyzer<std::string>(), 1024,
+                                                           OverflowPolicy::kBlock);
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; ++t) {
+        producers.emplace_back([&analyzer, t]() {
+            for (int i = 0; i < 20000; ++i) {
+                analyzer.AddKey(i % 2 == 0 ? "hot" : "key_" + std::to_string(t) + "_" + std::to_string(i));
+            }
+        });
+    }
+    for (size_t t = 0; t < producers.size(); ++t) {
+        producers[t].join();
+    }
+    analyzer.Flush();
+    ASSERT_EQ(analyzer.GetTopKKeys(), std::vector<std::string>({"hot"}));
+    ASSERT_EQ(analyzer.GetTopKKeys(3).size(), 3);
+    ASSERT_EQ(analyzer.dropped_count(), 0);
+    ASSERT_GT(analyzer.memory_usage().counters, 0);
+
+    // A tiny queue drops keys instead of waiting
+    AsyncFrequencyEstimationAnalyzer<int> small(FrequencyEstimationAnalyzer<int>(), 2);
+    for (int i = 0; i < 100000; ++i) {
+        small.AddKey(i);
+    }
+    ASSERT_GT(small.dropped_count(), 0);
+}
+
+TEST(async_suite, map_async_mode) {
+    MapGetFreshTopK<std::string, int> map;
+    map.enable_doorkeeper(1000);
+    map.enable_async_analyzer();
+    for (int i = 0; i < 10000; ++i) {
+        map.set(i % 3 == 0 ? "hot" : GenerateRandomString(8), i);
+        map.get("hot");
+    }
+    map.flush_analyzer();
+    ASSERT_EQ(map.get_top_k(), std::vector<std::string>({"hot"}));
+    ASSERT_EQ(map.dropped_requests(), 0);
+    ASSERT_EQ(map.get("hot"), 9999);
+
+    ASSERT_THROW(map.set_sampling_period(4), std::logic_error);
+    ASSERT_THROW(map.set_capacity(100), std::logic_error);
+}
+
+// HOT VALUE REPLICAS
+TEST(replicas_suite, hot_value_replicas) {
+    HotValueReplicas<std::string, int> replicas(4);
+    ASSERT_EQ(replicas.replicas_count(), 4);
+    const std::hash<std::string> hash;
+    const int first = 1, second = 2;
+    replicas.Assign({"first", "second"}, {hash("first"), hash("second")}, {&first, &second});
+
+    int value = 0;
+    ASSERT_TRUE(replicas.Read("second", hash("second"), value));
+    ASSERT_EQ(value, 2);
+    ASSERT_FALSE(replicas.Read("third", hash("third"), value));
+
+    replicas.Update("first", hash("first"), 10);
+    replicas.Update("third", hash("third"), 30);
+    replicas.Erase("second", hash("second"));
+    // Every thread sees the same values whatever core it runs on
+    std::vector<std::thread> readers;
+    std::atomic<int> errors(0);
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&replicas, &hash, &errors]() {
+            for (int i = 0; i < 1000; ++i) {
+                int read = 0;
+                if (!replicas.Read("first", hash("first"), read) || read != 10 ||
+                    replicas.Read("second", hash("second"), read) || replicas.Read("third", hash("third"), read)) {
+                    ++errors;
+                }
+            }
+        });
+    }
+    for (size_t t = 0; t < readers.size(); ++t) {
+        readers[t].join();
+    }
+    ASSERT_EQ(errors.load(), 0);
+}
+
+TEST(replicas_suite, map_replicas) {
+    MapGetFreshTopK<std::string, int> map(std::chrono::milliseconds(120));
+    int value = 0;
+    ASSERT_FALSE(map.read_replica("hot", value));
+    map.enable_hot_value_replicas(2);
+
+    map.set("hot", 1);
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(40);
+    for (int i = 0; std::chrono::steady_clock::now() < end; ++i) {
+        map.get(i % 2 == 0 ? "hot" : GenerateRandomString(8));
+    }
+    ASSERT_TRUE(map.read_replica("hot", value));
+    ASSERT_EQ(value, 1);
+    ASSERT_FALSE(map.read_replica("cold", value));
+
+    // Writes through `set` reach the replicas, a reader thread sees them
+    map.set("hot", 2);
+    std::thread reader([&map, &value]() {
+        map.read_replica("hot", value);
+    });
+    reader.join();
+    ASSERT_EQ(value, 2);
+
+    map.erase("hot");
+    ASSERT_FALSE(map.read_replica("hot", value));
+}
+
+// CONCURRENT MAP
+TEST(concurrent_map_suite, readers_and_writers) {
+    ConcurrentMapGetFreshTopK<std::string, std::string> map(std::chrono::seconds(60), 0.1, 12, 54, 4);
+    typedef ConcurrentMapGetFreshTopK<int, int> IntegerMap;
+    ASSERT_THROW(IntegerMap(std::chrono::seconds(1), 0.1, 12, 54, 3), std::invalid_argument);
+    for (int i = 0; i < 1000; ++i) {
+        map.set("key_" + std::to_string(i), std::string(32, 'a'));
+    }
+    ASSERT_EQ(map.size(), 1000);
+
+    // Values are always whole: a reader sees either the old or the new string
+    std::atomic<bool> stop(false);
+    std::atomic<int> errors(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; ++t) {
+        readers.emplace_back([&map, &stop, &errors, t]() {
+            std::string value;
+            for (int i = 0; !stop.load() || i < 1000; ++i) {
+                const std::string key = i % 2 == 0 ? "hot" : "key_" + std::to_string((i * 7 + t) % 1000);
+                if (map.get(key, value) && value != std::string(32, 'a') && value != std::string(32, 'b')) {
+                    ++errors;
+                }
+            }
+        });
+    }
+    for (int i = 0; i < 20000; ++i) {
+        const std::string key = "key_" + std::to_string(i % 1000);
+        map.set(key, std::string(32, i % 2 == 0 ? 'b' : 'a'));
+        if (i % 3 == 0) {
+            map.erase("key_" + std::to_string((i + 500) % 1000));
+        }
+    }
+    map.set("hot", std::string(32, 'b'));
+    stop = true;
+    for (size_t t = 0; t < readers.size(); ++t) {
+        readers[t].join();
+    }
+    ASSERT_EQ(errors.load(), 0);
+
+    std::string value;
+    ASSERT_TRUE(map.get("hot", value));
+    ASSERT_EQ(value, std::string(32, 'b'));
+    ASSERT_FALSE(map.get("missing", value));
+    // Requests of all threads are counted
+    ASSERT_EQ(map.get_top_k(), std::vector<std::string>({"hot"}));
+}
+
+// MULTI-DIMENSIONAL KEYS
+TEST(multi_dimensional_suite, tenant_hot_key) {
+    typedef std::pair<int, int> Dimension;
+    MultiDimensionalFrequencyEstimationAnalyzer<std::string, Dimension> analyzer;
+    for (int i = 0; i < 100000; ++i) {
+        // Tenant 1 makes 5% of requests, half of them to "small"
+        const int tenant = i % 20 == 0 ? 1 : 0;
+        const int operation = i % 2;
+        analyzer.AddKey(tenant == 1 && i % 40 == 0 ? "small" : GenerateRandomString(8), Dimension(operation, tenant));
+    }
+    ASSERT_EQ(analyzer.dimensions(), std::vector<Dimension>({Dimension(0, 0), Dimension(0, 1), Dimension(1, 0)}));
+    ASSERT_EQ(analyzer.GetTopKKeys(Dimension(0, 1)), std::vector<std::string>({"small"}));
+    ASSERT_TRUE(analyzer.GetTopKKeys(Dimension(0, 0)).empty());
+    ASSERT_TRUE(analyzer.GetTopKKeys(Dimension(1, 1)).empty());
+    ASSERT_TRUE(analyzer.GetGlobalTopKKeys().empty());
+    ASSERT_GT(analyzer.memory_usage().counters, 0);
+
+    MultiDimensionalFrequencyEstimationAnalyzer<std::string, int> without_global(std::chrono::seconds(60), 0.1, 12,
+                                                                                  54, false);
+    ASSERT_THROW(without_global.GetGlobalTopKKeys(), std::logic_error);
+}
+
+TEST(multi_dimensional_suite, shared_rotation) {
+    // Epochs started by the owner don't move with the clock of requests
+    FrequencyEstimationAnalyzer<std::string> analyzer(std::chrono::milliseconds(300), 0.1, 3);
+    const std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+    analyzer.RotateAt(start);
+    ASSERT_EQ(analyzer.epoch(), 1);
+    for (int i = 0; i < 100; ++i) {
+        analyzer.AddKey("key");
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    analyzer.AddKey("key");
+    ASSERT_EQ(analyzer.epoch(), 1);
+    analyzer.RotateAt(start + std::chrono::milliseconds(100));
+    analyzer.RotateAt(start + std::chrono::milliseconds(50));
+    ASSERT_EQ(analyzer.epoch(), 2);
+    ASSERT_EQ(analyzer.GetTopKKeys(), std::vector<std::string>({"key"}));
+
+    // Dimensions created at different times start their epochs at the same aligned boundaries
+    MultiDimensionalFrequencyEstimationAnalyzer<std::string, int> dimensions(std::chrono::milliseconds(300), 0.1, 3);
+    dimensions.AddKey("key", 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    dimensions.AddKey("key", 1);
+    const std::chrono::system_clock::duration since_epoch = dimensions.epoch_start().time_since_epoch();
+    ASSERT_EQ(since_epoch % std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::milliseconds(100)), std::chrono::system_clock::duration::zero());
+    ASSERT_LE(dimensions.epoch_start(), std::chrono::system_clock::now());
+    ASSERT_EQ(dimensions.GetTopKKeys(1), std::vector<std::string>({"key"}));
+    ASSERT_EQ(dimensions.GetGlobalTopKKeys(), std::vector<std::string>({"key"}));
+
+    MapGetFreshTopK<> map;
+    map.enable_per_operation_top_k();
+    ASSERT_THROW(map.enable_async_analyzer(), std::logic_error);
+}
+
+TEST(multi_dimensional_suite, map_operations) {
+    MapGetFreshTopK<> map;
+    ASSERT_THROW(map.get_top_k(MapOperation::kGet), std::logic_error);
+    map.enable_per_operation_top_k();
+    for (int i = 0; i < 100000; ++i) {
+        if (i % 2 == 0) {
+            map.get(i % 8 == 0 ? "read" : GenerateRandomString(8));
+        } else {
+            map.set(i % 8 == 1 ? "written" : GenerateRandomString(8), "value");
+        }
+    }
+    // Each of them has 12.5% of all requests and 25% of requests of its operation
+    ASSERT_EQ(map.get_top_k(MapOperation::kGet), std::vector<std::string>({"read"}));
+    ASSERT_EQ(map.get_top_k(MapOperation::kSet), std::vector<std::string>({"written"}));
+    const std::vector<std::string> top = map.get_top_k();
+    ASSERT_EQ(std::set<std::string>(top.begin(), top.end()), std::set<std::string>({"read", "written"}));
+}
+
+// EXACT VERIFICATION
+TEST(exact_verification_suite, false_positive_removed) {
+    FrequencyEstimationAnalyzer<std::string> analyzer(std::chrono::seconds(60));
+    for (int i = 0; i < 100000; ++i) {
+        // "hot" has 20%, "near" 9%, 40 other keys fit into the bucket, so the counters are exact
+        const int r = i % 100;
+        analyzer.AddKey(r < 20 ? "hot" : (r < 29 ? "near" : "key" + std::to_string(i % 40)));
+    }
+    const std::vector<std::string> superset = analyzer.GetTopKKeys();
+    ASSERT_NE(std::find(superset.begin(), superset.end(), "near"), superset.end());
+    ASSERT_THROW(analyzer.GetVerifiedTopKKeys(), std::logic_error);
+
+    analyzer.EnableExactVerification();
+    ASSERT_EQ(analyzer.GetTopKKeys(), std::vector<std::string>({"hot"}));
+    const std::vector<std::pair<std::string, int64_t>> verified = analyzer.GetVerifiedTopKKeys();
+    ASSERT_EQ(verified.size(), 1);
+    ASSERT_EQ(verified[0].second, 20000);
+    // `number` still gives the ranked candidates
+    ASSERT_EQ(analyzer.GetTopKKeys(2), std::vector<std::string>({"hot", "near"}));
+}
+
+TEST(exact_verification_suite, exact_window_counts) {
+    FrequencyEstimationAnalyzer<std::string> analyzer(std::chrono::milliseconds(300), 0.1, 3);
+    analyzer.EnableExactVerification();
+    int64_t hot_requests = 0;
+    const auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(700)) {
+        for (int i = 0; i < 100; ++i) {
+            if (i % 3 == 0) {
+                analyzer.AddKey("hot");
+                ++hot_requests;
+            } else {
+                analyzer.AddKey(GenerateRandomString(8));
+            }
+        }
+    }
+    const std::vector<std::pair<std::string, int64_t>> verified = analyzer.GetVerifiedTopKKeys();
+    ASSERT_EQ(verified.size(), 1);
+    ASSERT_EQ(verified[0].first, "hot");
+    // The counter of the oldest bucket lost requests to the random keys, the exact count didn't
+    ASSERT_GT(verified[0].second, analyzer.EstimateFrequency("hot"));
+    ASSERT_LE(verified[0].second, hot_requests);
+    ASSERT_GT(analyzer.memory_usage().counters, 0);
+
+    MapGetFreshTopK<> map;
+    ASSERT_THROW(map.get_verified_top_k(), std::logic_error);
+    map.enable_exact_verification();
+    for (int i = 0; i < 1000; ++i) {
+        map.get(i % 2 == 0 ? "hot" : GenerateRandomString(8));
+    }
+    ASSERT_EQ(map.get_top_k(), std::vector<std::string>({"hot"}));
+    // The window began before "hot" became a candidate, so its count is the lower bound given by the counter
+    const int64_t count = map.get_verified_top_k()[0].second;
+    ASSERT_LE(count, 500);
+    ASSERT_GE(count, 100);
+}
+
+TEST(exact_verification_suite, not_with_sampling) {
+    FrequencyEstimationAnalyzer<std::string> analyzer(std::chrono::seconds(60));
+    analyzer.SetSamplingPeriod(4);
+    // Sampled counters are estimates, the exact counts would be too
+    ASSERT_THROW(analyzer.EnableExactVerification(), std::logic_error);
+    analyzer.SetSamplingPeriod(1);
+    analyzer.EnableExactVerification();
+    ASSERT_THROW(analyzer.SetSamplingPeriod(4), std::logic_error);
+    ASSERT_THROW(analyzer.SetAdaptiveSampling(1000), std::logic_error);
+    analyzer.SetSamplingPeriod(1);
+
+    MapGetFreshTopK<> map;
+    map.set_adaptive_sampling(1000);
+    ASSERT_THROW(map.enable_exact_verification(), std::logic_error);
+}
+
+// TRENDING KEYS
+TEST(trending_suite, rising_key) {
+    FrequencyEstimationAnalyzer<std::string> analyzer(std::chrono::milliseconds(300), 0.1, 3);
+    ASSERT_TRUE(analyzer.GetTrending().empty());
+    // A whole epoch without "rising"
+    const uint64_t start_epoch = analyzer.epoch();
+    for (int i = 0; analyzer.epoch() < start_epoch + 2; ++i) {
+        analyzer.AddKey(i % 5 == 0 ? "steady" : GenerateRandomString(8));
+    }
+    // The next epoch is full of it
+    const uint64_t rising_epoch = analyzer.epoch();
+    for (int i = 0; analyzer.epoch() == rising_epoch; ++i) {
+        analyzer.AddKey(i % 5 == 0 ? "steady" : (i % 5 < 3 ? "rising" : GenerateRandomString(8)));
+    }
+    ASSERT_EQ(analyzer.GetTrending(), std::vector<std::string>({"rising"}));
+    ASSERT_EQ(analyzer.GetTrending(1), std::vector<std::string>({"rising"}));
+
+    MapGetFreshTopK<> map;
+    map.get("key");
+    ASSERT_TRUE(map.get_trending().empty());
+}
+
+// HOT KEY ADMISSION
+TEST(admission_suite, token_buckets) {
+    typedef HotKeyAdmissionController<std::string> Controller;
+    ASSERT_THROW(Controller(0), std::invalid_argument);
+    Controller controller(10, 2);
+    const std::hash<std::string> hash;
+    const auto now = std::chrono::steady_clock::now();
+    controller.Assign({"hot"}, {hash("hot")}, now);
+    ASSERT_TRUE(controller.Admit("cold", hash("cold"), 100, now));
+    ASSERT_TRUE(controller.Admit("hot", hash("hot"), 1, now));
+    ASSERT_TRUE(controller.Admit("hot", hash("hot"), 1, now));
+    ASSERT_FALSE(controller.Admit("hot", hash("hot"), 1, now));
+    // 10 requests per second: a token in 100 ms
+    ASSERT_TRUE(controller.Admit("hot", hash("hot"), 1, now + std::chrono::milliseconds(100)));
+    ASSERT_FALSE(controller.Admit("hot", hash("hot"), 1, now + std::chrono::milliseconds(100)));
+
+    // A key which stays hot keeps its bucket, a new one gets a full bucket
+    controller.Assign({"new", "hot"}, {hash("new"), hash("hot")}, now + std::chrono::milliseconds(100));
+    ASSERT_FALSE(controller.Admit("hot", hash("hot"), 1, now + std::chrono::milliseconds(100)));
+    ASSERT_TRUE(controller.Admit("new", hash("new"), 2, now + std::chrono::milliseconds(100)));
+    ASSERT_EQ(controller.throttled_count(), 3);
+}
+
+TEST(admission_suite, map_throttles_hot_key) {
+    MapGetFreshTopK<> map(std::chrono::milliseconds(300), 0.1, 3);
+    ASSERT_TRUE(map.should_admit("hot"));
+    map.enable_hot_key_admission(100);
+    int cold_refused = 0;
+    int hot_admitted = 0;
+    const auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(400)) {
+        for (int i = 0; i < 100; ++i) {
+            const std::string key = i % 2 == 0 ? "hot" : GenerateRandomString(8);
+            if (map.should_admit(key)) {
+                map.get(key);
+                hot_admitted += key == "hot";
+            } else {
+                cold_refused += key != "hot";
+            }
+        }
+    }
+    ASSERT_EQ(cold_refused, 0);
+    ASSERT_GT(map.throttled_requests(), 0);
+    // Refused requests are counted too, so the key stays very frequent
+    ASSERT_EQ(map.get_top_k(), std::vector<std::string>({"hot"}));
+    // At most the first epoch (~100 ms) unlimited plus a burst and 100 requests per second after it
+    ASSERT_LT(hot_admitted, map.throttled_requests());
+}
+
+// READ-THROUGH LOADS
+TEST(loader_suite, single_flight) {
+    SingleFlight<std::string, int> single_flight;
+    std::atomic<int> loads(0);
+    std::vector<std::thread> threads;
+    std::vector<int> results(8, 0);
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&single_flight, &loads, &results, t]() {
+            results[t] = single_flight.Do("key", [&loads]() {
+                ++loads;
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                return 42;
+            });
+        });
+    }
+    for (size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    ASSERT_EQ(results, std::vector<int>(8, 42));
+    ASSERT_EQ(loads.load() + single_flight.coalesced_count(), 8);
+    ASSERT_GT(single_flight.coalesced_count(), 0);
+
+    // A failed load is not remembered
+    ASSERT_THROW(single_flight.Do("key", []() -> int { throw std::runtime_error("backend is down"); }),
+                 std::runtime_error);
+    ASSERT_EQ(single_flight.Do("key", []() { return 7; }), 7);
+}
+
+TEST(loader_suite, read_through) {
+    ConcurrentMapGetFreshTopK<std::string, std::string> map;
+    ASSERT_THROW(map.get_or_load("key"), std::logic_error);
+    std::atomic<int> loads(0);
+    map.set_loader([&loads](const std::string &key) {
+        ++loads;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return "loaded " + key;
+    });
+    for (int i = 0; i < 1000; ++i) {
+        map.set(i % 2 == 0 ? "hot" : "key_" + std::to_string(i), "value");
+    }
+    ASSERT_EQ(map.get_top_k(), std::vector<std::string>({"hot"}));
+
+    // Misses of the hot key wait for one load
+    map.erase("hot");
+    std::vector<std::thread> threads;
+    std::atomic<int> wrong_values(0);
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&map, &wrong_values]() {
+            if (map.get_or_load("hot") != "loaded hot") {
+                ++wrong_values;
+            }
+        });
+    }
+    for (size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    ASSERT_EQ(wrong_values.load(), 0);
+    ASSERT_EQ(loads.load(), 1);
+    ASSERT_EQ(map.get_or_load("cold"), "loaded cold");
+    ASSERT_EQ(loads.load(), 2);
+    std::string value;
+    ASSERT_TRUE(map.get("cold", value));
+
+    // A set made during the load is not overwritten by the loaded value
+    ConcurrentMapGetFreshTopK<std::string, std::string> racing_map;
+    racing_map.set_loader([&racing_map](const std::string &key) -> std::string {
+        racing_map.set(key, "fresh");
+        return "stale";
+    });
+    ASSERT_EQ(racing_map.get_or_load("key"), "fresh");
+    ASSERT_TRUE(racing_map.get("key", value));
+    ASSERT_EQ(value, "fresh");
+
+    MapGetFreshTopK<> single_thread_map;
+    single_thread_map.set_loader([](const std::string &key) -> std::string {
+        if (key == "broken") {
+            throw std::runtime_error("backend is down");
+        }
+        return "loaded " + key;
+    });
+    ASSERT_EQ(single_thread_map.get("key"), "loaded key");
+    ASSERT_THROW(single_thread_map.get("broken"), std::runtime_error);
+    ASSERT_EQ(single_thread_map.size(), 1);
+}
+
+// TTL
+TEST(ttl_suite, timing_wheel) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const std::chrono::milliseconds tick(10);
+    TimingWheel<int> wheel(tick, 3, start);
+    // Level 0, level 1, level 2 and out of the range of the wheel (256^3 ticks)
+    const int deadlines[] = {5, 300, 70000, 20000000};
+    for (int key = 0; key < 4; ++key) {
+        wheel.Schedule(key, start + deadlines[key] * tick);
+    }
+    wheel.Schedule(4, start + 1000 * tick);
+    wheel.Schedule(4, start + 50 * tick);
+    wheel.Schedule(5, start + 100 * tick);
+    ASSERT_TRUE(wheel.Cancel(5));
+    ASSERT_EQ(wheel.size(), 5);
+    ASSERT_TRUE(wheel.IsExpired(0, start + 5 * tick));
+    ASSERT_FALSE(wheel.IsExpired(0, start + 4 * tick));
+    ASSERT_FALSE(wheel.IsExpired(5, start + 200 * tick));
+
+    std::vector<int> expired;
+    ASSERT_EQ(wheel.Advance(start + 4 * tick, expired), 0);
+    ASSERT_EQ(wheel.Advance(start + 299 * tick, expired), 2);
+    ASSERT_EQ(expired, std::vector<int>({0, 4}));
+    ASSERT_EQ(wheel.Advance(start + 300 * tick, expired), 1);
+    ASSERT_EQ(wheel.Advance(start + 69999 * tick, expired), 0);
+    ASSERT_EQ(wheel.Advance(start + 70000 * tick, expired), 1);
+    ASSERT_EQ(wheel.Advance(start + 19999999 * tick, expired), 0);
+    ASSERT_EQ(wheel.Advance(start + 20000000 * tick, expired), 1);
+    ASSERT_EQ(expired, std::vector<int>({0, 4, 1, 2, 3}));
+    ASSERT_EQ(wheel.size(), 0);
+
+    TimingWheel<int> one_level_wheel(tick, 1, start);
+    one_level_wheel.Schedule(0, start + 1000 * tick);
+    ASSERT_EQ(one_level_wheel.Advance(start + 999 * tick, expired), 0);
+    ASSERT_EQ(one_level_wheel.Advance(start + 1000 * tick, expired), 1);
+}
+
+TEST(ttl_suite, rescheduled_key) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const std::chrono::milliseconds tick(10);
+    TimingWheel<std::string> wheel(tick, 4, start);
+    wheel.Schedule("hot key of the wheel, longer than a short string", start + 1000 * tick);
+    const size_t usage = wheel.memory_usage().total();
+    // Every reschedule moves the only entry of the key, so the wheel doesn't grow
+    for (int i = 0; i < 100000; ++i) {
+        wheel.Schedule("hot key of the wheel, longer than a short string", start + (1000 + i % 3000) * tick);
+        if (i % 2 == 0) {
+            wheel.Cancel("hot key of the wheel, longer than a short string");
+        }
+    }
+    ASSERT_EQ(wheel.size(), 1);
+    ASSERT_LE(wheel.memory_usage().total(), usage + 64 * sizeof(void *));
+
+    MapGetFreshTopK<> map;
+    for (int i = 0; i < 100000; ++i) {
+        map.set("hot", "value", std::chrono::hours(1));
+    }
+    ASSERT_EQ(map.size(), 1);
+    ASSERT_LT(map.memory_usage().total(), 1 << 20);
+
+    std::vector<std::string> expired;
+    ASSERT_EQ(wheel.Advance(start + 3999 * tick, expired), 1);
+    ASSERT_EQ(wheel.size(), 0);
+}
+
+TEST(ttl_suite, fingerprint_marks) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const std::chrono::milliseconds tick(10);
+    TimingWheel<int> wheel(tick, 4, start);
+    for (int key = 0; key < 1000; ++key) {
+        wheel.Schedule(key, start + (key % 10 + 1) * tick);
+    }
+    // The table grows with the keys, every key with a deadline is marked
+    for (int key = 0; key < 1000; ++key) {
+        ASSERT_TRUE(wheel.MayHaveDeadline(wheel.HashKey(key)));
+    }
+    int unmarked = 0;
+    for (int key = 1000; key < 2000; ++key) {
+        unmarked += wheel.MayHaveDeadline(wheel.HashKey(key)) ? 0 : 1;
+    }
+    ASSERT_GT(unmarked, 300);
+
+    for (int key = 0; key < 500; ++key) {
+        ASSERT_TRUE(wheel.Cancel(key));
+    }
+    std::vector<int> expired;
+    ASSERT_EQ(wheel.Advance(start + 10 * tick, expired), 500);
+    for (int key = 0; key < 2000; ++key) {
+        ASSERT_FALSE(wheel.MayHaveDeadline(wheel.HashKey(key)));
+    }
+}
+
+TEST(ttl_suite, expiration) {
+    MapGetFreshTopK<> map;
+    map.set("short", "value", std::chrono::milliseconds(50));
+    map.set("long", "value", std::chrono::hours(1));
+    map.set("permanent", "value", std::chrono::milliseconds(50));
+    map.set("permanent", "new value");
+    map.set("key", "value");
+    ASSERT_EQ(map.size(), 4);
+    ASSERT_EQ(map.expire(), 0);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(map.try_get("short"), nullptr);
+    ASSERT_EQ(map.size(), 3);
+    ASSERT_EQ(map.get("permanent"), "new value");
+
+    map.set("short", "value", std::chrono::milliseconds(50));
+    map.set("other", "value", std::chrono::milliseconds(50));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(map.expire(), 2);
+    ASSERT_EQ(map.size(), 3);
+    ASSERT_NE(map.try_get("long"), nullptr);
+    // A missing key is inserted by get as usual
+    ASSERT_EQ(map.get("short"), "");
+}
+
+// SLAB ALLOCATOR
+TEST(slab_suite, arena) {
+    SlabArena arena;
+    std::vector<void *> blocks;
+    for (int i = 0; i < 10000; ++i) {
+        blocks.push_back(arena.Allocate(24));
+    }
+    ASSERT_EQ(arena.allocated_bytes(), 10000 * 32);
+    const size_t reserved = arena.reserved_bytes();
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        SlabArena::Deallocate(blocks[i], 24);
+    }
+    ASSERT_EQ(arena.allocated_bytes(), 0);
+    // Freed blocks and empty slabs are reused, by other size classes too
+    for (int i = 0; i < 5000; ++i) {
+        blocks[i] = arena.Allocate(60);
+    }
+    ASSERT_LE(arena.reserved_bytes(), reserved);
+
+    // Blocks freed by another thread come back at the next allocation
+    std::thread([&blocks]() {
+        for (int i = 0; i < 5000; ++i) {
+            SlabArena::Deallocate(blocks[i], 60);
+        }
+    }).join();
+    void *block = arena.Allocate(2048);
+    ASSERT_EQ(arena.allocated_bytes(), 2048);
+    SlabArena::Deallocate(block, 2048);
+    block = arena.Allocate(100000);
+    SlabArena::Deallocate(block, 100000);
+    ASSERT_EQ(arena.allocated_bytes(), 0);
+}
+
+TEST(slab_suite, arena_map) {
+    const SlabArena &arena = SlabArena::ForThisThread();
+    const size_t allocated = arena.allocated_bytes();
+    {
+        ArenaMapGetFreshTopK<> map;
+        for (int i = 0; i < 10000; ++i) {
+            const ArenaString key = i % 2 == 0 ? "hot" : ("a long key of the map number " + std::to_string(i)).c_str();
+            map.set(key, "a long value which doesn't fit into the string object");
+        }
+        ASSERT_EQ(map.size(), 5001);
+        ASSERT_EQ(map.get_top_k(), std::vector<ArenaString>({"hot"}));
+        ASSERT_EQ(map.get("hot"), "a long value which doesn't fit into the string object");
+        ASSERT_GT(arena.allocated_bytes(), allocated + 5000 * 64);
+        ASSERT_TRUE(map.erase("hot"));
+        ASSERT_EQ(map.size(), 5000);
+    }
+    ASSERT_EQ(arena.allocated_bytes(), allocated);
+
+    DefaultKeyHash<ArenaString> hash;
+    ASSERT_EQ(hash(ArenaString("key")), hash(ArenaString("key")));
+    ASSERT_NE(hash(ArenaString("a long key 1")), hash(ArenaString("a long key 2")));
+}
+
+TEST(slab_suite, orphaned_arena) {
+    // The arena of an exited thread is adopted by the next thread, the blocks freed after the exit come back to it
+    SlabArena *first = nullptr;
+    std::vector<void *> blocks;
+    std::thread([&first, &blocks]() {
+        first = &SlabArena::ForThisThread();
+        for (int i = 0; i < 1000; ++i) {
+            blocks.push_back(first->Allocate(100));
+        }
+    }).join();
+    ASSERT_FALSE(first->OwnedByThisThread());
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        SlabArena::Deallocate(blocks[i], 100);
+    }
+    SlabArena *second = nullptr;
+    size_t allocated = 0;
+    std::thread([&second, &allocated]() {
+        second = &SlabArena::ForThisThread();
+        SlabArena::Deallocate(second->Allocate(100), 100);
+        allocated = second->allocated_bytes();
+    }).join();
+    ASSERT_EQ(second, first);
+    ASSERT_EQ(allocated, 0);
+}
+
+// LONG TESTS (because each test includes a lot of tests) each can take <15 minutes (their time is random, for me ALL tests take 15 minutes)
+TEST(long_long_tests_one_hotkey, hotkey_at_the_beginning) {
+    ASSERT_TRUE(TestSpecificParametersBeginning());
+}
+
+TEST(long_long_tests_one_hotkey, hotkey_at_the_end) {
+    ASSERT_TRUE(TestSpecificParametersEnd());
+}
+
+TEST(long_long_tests_one_hotkey, hotkey_at_random_beginning_or_end) {
+    ASSERT_TRUE(TestRandomParametersBeginningOrEnd());
+}
+
+TEST(long_long_tests_many_hotkeys, hotkey_at_random_beginning_or_end) {
+    ASSERT_TRUE(TestRandomParametersBeginningOrEndManyKeys());
+}
+
+TEST(long_long_tests_one_hotkey, bad_tests) {
+    ASSERT_TRUE(BadTests());
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
 }
\ No newline at end of file
@@ -0,0 +1,312 @@
+// AsyncFrequencyEstimationAnalyzer implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_ASYNC_FREQUENCY_ESTIMATION_ANALYZER_H
+#define VKTEST_ASYNC_FREQUENCY_ESTIMATION_ANALYZER_H
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+#include "bounded_queue.h"
+#include "frequency_estimation_analyzer.h"
+#include "integer_keys.h"
+#include "memory_usage.h"
+
+/**
+ *  @brief  What `AddKey` of AsyncFrequencyEstimationAnalyzer does when the queue is full.
+ */
+enum class OverflowPolicy {
+    // The request is not counted, look dropped_count()
+    kDrop,
+    // Wait for the analyzer thread to free a place
+    kBlock
+};
+
+/**
+ *  @brief FrequencyEstimationAnalyzer owned by a dedicated thread and fed through a lock-free queue.
+ *
+ *  @tparam Key  Type of key objects.
+ *  @tparam Compare  Comparison function object type, defaults to less<Key>.
+ *  @tparam Hash  Hash function object type of the analyzer.
+ *
+ *  `AddKey` only pushes the key to a bounded multi-producer queue (look BoundedQueue), so request threads never pay
+ *  for the bucket updates. The analyzer thread drains the queue in batches and publishes a snapshot of the top at
+ *  most once per `publish_interval`: `GetTopKKeys` reads the last snapshot, its result is up to `publish_interval`
+ *  (plus the queue backlog) late.
+ *
+ *  `AddKey` may be called from any number of threads, the other methods too.
+ */
+template<typename Key, typename Compare = std::less<Key>, typename Hash = DefaultKeyHash<Key>>
+class AsyncFrequencyEstimationAnalyzer {
+public:
+    typedef FrequencyEstimationAnalyzer<Key, Compare, Hash> Analyzer;
+
+    /**
+     *  @brief Start the analyzer thread.
+     *
+     *  @param analyzer  Configured analyzer (sampling, doorkeeper, subscriptions etc.), it is used only by the
+     *  analyzer thread from now on, so subscription callbacks are called there.
+     *  @param queue_capacity  Maximum number of keys waiting for the analyzer, a power of two, defaults to 65536.
+     *  @param overflow_policy  What to do with a key if the queue is full, defaults to dropping it.
+     *  @param publish_interval  Minimum time between snapshots of the top, defaults to 1 ms.
+     */
+    explicit AsyncFrequencyEstimationAnalyzer(Analyzer analyzer, size_t queue_capacity = 65536,
+                                              OverflowPolicy overflow_policy = OverflowPolicy::kDrop,
+                                              std::chrono::duration<double> publish_interval =
+                                              std::chrono::milliseconds(1));
+
+    /**
+     *  @brief  Stop the analyzer thread, keys still in the queue are not counted.
+     */
+    ~AsyncFrequencyEstimationAnalyzer();
+
+    AsyncFrequencyEstimationAnalyzer(const AsyncFrequencyEstimationAnalyzer &) = delete;
+
+    AsyncFrequencyEstimationAnalyzer &operator=(const AsyncFrequencyEstimationAnalyzer &) = delete;
+
+    /**
+     *  @brief  Transfer information about a newly added key to the analyzer thread.
+     *
+     *  Time complexity: O(1), one CAS of the queue (kBlock waits while the queue is full).
+     */
+    void AddKey(const Key &key, int64_t weight = 1);
+
+    /**
+     *  @brief  Very frequent keys of the last snapshot, look FrequencyEstimationAnalyzer::GetTopKKeys.
+     */
+    std::vector<Key> GetTopKKeys(int number = 0) const;
+
+    /**
+     *  @brief  Wait until the keys added by the calling thread before the call are counted and a snapshot with them
+     *  is published.
+     */
+    void Flush();
+
+    uint64_t HashKey(const Key &key) const {
+        return static_cast<uint64_t>(hash_(key));
+    }
+
+    /**
+     *  @brief  Number of bucket rotations of the analyzer at the last snapshot.
+     */
+    uint64_t epoch() const;
+
+    /**
+     *  @brief  Keys not counted because the queue was full (kDrop).
+     */
+    uint64_t dropped_count() const {
+        return dropped_count_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     *  @brief  Memory of the analyzer at the last snapshot plus the queue.
+     */
+    MemoryUsage memory_usage() const;
+
+private:
+    struct Snapshot {
+        uint64_t epoch;
+        // Keys with >= ~10% of requests
+        std::vector<Key> very_frequent_keys;
+        // All tracked keys from the most frequent
+        std::vector<Key> ranked_keys;
+        MemoryUsage analyzer_memory;
+
+        Snapshot() : epoch(0), very_frequent_keys(), ranked_keys(), analyzer_memory() {};
+    };
+
+    typedef std::pair<Key, int64_t> Request;
+
+    // Body of the analyzer thread
+    void Run();
+
+    void Count(const Request &request);
+
+    void Publish();
+
+    std::shared_ptr<const Snapshot> LoadSnapshot() const {
+        return std::atomic_load(&snapshot_);
+    }
+
+    static const size_t kBatchSize = 256;
+
+    const Hash hash_;
+    const OverflowPolicy overflow_policy_;
+    const std::chrono::duration<double> publish_interval_;
+    // Used only by the analyzer thread
+    Analyzer analyzer_;
+    BoundedQueue<Request> queue_;
+
+    std::atomic<bool> stop_;
+    std::atomic<uint64_t> dropped_count_;
+    std::shared_ptr<const Snapshot> snapshot_;
+
+    // Flush calls so far and the number of them served by the analyzer thread
+    std::atomic<uint64_t> flush_requests_;
+    std::mutex flush_mutex_;
+    // Queue position to drain for the flushes requested so far
+    size_t flush_target_;
+    std::condition_variable flush_done_;
+    uint64_t flushes_served_;
+
+    std::thread thread_;
+};
+
+template<typename Key, typename Compare, typename Hash>
+const size_t AsyncFrequencyEstimationAnalyzer<Key, Compare, Hash>::kBatchSize;
+
+template<typename Key, typename Compare, typename Hash>
+AsyncFrequencyEstimationAnalyzer<Key, Compare, Hash>::AsyncFrequencyEstimationAnalyzer(
+        Analyzer analyzer, const size_t queue_capacity, const OverflowPolicy overflow_policy,
+        const std::chrono::duration<double> publish_interval)
+        : hash_(), overflow_policy_(overflow_policy), publish_interval_(publish_interval),
+          analyzer_(std::move(analyzer)), queue_(queue_capacity), stop_(false), dropped_count_(0),
+          snapshot_(std::make_shared<const Snapshot>()), flush_requests_(0), flush_mutex_(), flush_target_(0), flush_done_(),
+          flushes_served_(0), thread_() {
+    thread_ = std::thread(&AsyncFrequencyEstimationAnalyzer::Run, this);
+}
+
+template<typename Key, typename Compare, typename Hash>
+AsyncFrequencyEstimationAnalyzer<Key, Compare, Hash>::~AsyncFrequencyEstimationAnalyzer() {
+    stop_.store(true, std::memory_order_release);
+    thread_.join();
+}
+
+template<typename Key, typename Compare, typename Hash>
+void AsyncFrequencyEstimationAnalyzer<Key, Compare, Hash>::AddKey(const Key &key, const int64_t weight) {
+    if (weight < 1) {
+        throw std::invalid_argument("AsyncFrequencyEstimationAnalyzer: weight of a request must be positive");
+    }
+    if (queue_.TryPush(Request(key, weight))) {
+        return;
+    }
+    if (overflow_policy_ == OverflowPolicy::kDrop) {
+        dropped_count_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    while (!queue_.TryPush(Request(key, weight))) {
+        std::this_thread::yield();
+    }
+}
+
+template<typename Key, typename Compare, typename Hash>
+std::vector<Key> AsyncFrequencyEstimationAnalyzer<Key, Compare, Hash>::GetTopKKeys(const int number) const {
+    const std::shared_ptr<const Snapshot> snapshot = LoadSnapshot();
+    if (number == 0) {
+        return snapshot->very_frequent_keys;
+    }
+    const size_t size = std::min(static_cast<size_t>(number), snapshot->ranked_keys.size());
+    return std::vector<Key>(snapshot->ranked_keys.begin(), snapshot->ranked_keys.begin() + size);
+}
+
+template<typename Key, typename Compare, typename Hash>
+void AsyncFrequencyEstimationAnalyzer<Key, Compare, Hash>::Flush() {
+    std::unique_lock<std::mutex> lock(flush_mutex_);
+    // Covers the positions of the keys pushed by this thread
+    flush_target_ = std::max(flush_target_, queue_.enqueue_position());
+    const uint64_t ticket = flush_requests_.fetch_add(1, std::memory_order_release) + 1;
+    flush_done_.wait(lock, [this, ticket]() { return flushes_served_ >= ticket; });
+}
+
+template<typename Key, typename Compare, typename Hash>
+uint64_t AsyncFrequencyEstimationAnalyzer<Key, Compare, Hash>::epoch() const {
+    return LoadSnapshot()->epoch;
+}
+
+template<typename Key, typename Compare, typename Hash>
+MemoryUsage AsyncFrequencyEstimationAnalyzer<Key, Compare, Hash>::memory_usage() const {
+    MemoryUsage usage = LoadSnapshot()->analyzer_memory;
+    usage.overhead += sizeof(*this) - sizeof(analyzer_) + queue_.capacity() * sizeof(Request);
+    return usage;
+}
+
+template<typename Key, typename Compare, typename Hash>
+void AsyncFrequencyEstimationAnalyzer<Key, Compare, Hash>::Run() {
+    std::chrono::steady_clock::time_point last_publish = std::chrono::steady_clock::now();
+    Request request;
+    while (!stop_.load(std::memory_order_acquire)) {
+        size_t batch = 0;
+        for (; batch < kBatchSize && queue_.TryPop(request); ++batch) {
+            Count(request);
+        }
+
+        // Flushes are served once the queue is drained
+        bool flush = false;
+        uint64_t flush_requests = 0;
+        if (batch < kBatchSize && flush_requests_.load(std::memory_order_acquire) != flushes_served_) {
+            size_t flush_target;
+            {
+                std::lock_guard<std::mutex> lock(flush_mutex_);
+                flush_requests = flush_requests_.load(std::memory_order_relaxed);
+                flush_target = flush_target_;
+            }
+            // A failed pop doesn't mean the flushed keys are counted: an earlier position may be taken by a producer
+            // which hasn't published its key yet, so the queue is drained up to the position seen by Flush
+            while (queue_.dequeue_position() < flush_target && !stop_.load(std::memory_order_acquire)) {
+                if (queue_.TryPop(request)) {
+                    Count(request);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+            flush = true;
+        }
+
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (flush || now - last_publish >= publish_interval_) {
+            Publish();
+            last_publish = now;
+        }
+        if (flush) {
+            std::lock_guard<std::mutex> lock(flush_mutex_);
+            flushes_served_ = flush_requests;
+            flush_done_.notify_all();
+        }
+        if (batch == 0 && !flush) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+}
+
+template<typename Key, typename Compare, typename Hash>
+void AsyncFrequencyEstimationAnalyzer<Key, Compare, Hash>::Count(const Request &request) {
+    // #sleep well at night
+    try {
+        analyzer_.AddKey(request.first, request.second);
+    } catch (std::exception &e) {
+        // the key is lost for statistics, the thread keeps working
+    }
+}
+
+template<typename Key, typename Compare, typename Hash>
+void AsyncFrequencyEstimationAnalyzer<Key, Compare, Hash>::Publish() {
+    const std::shared_ptr<const Snapshot> previous = LoadSnapshot();
+    std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+    // #sleep well at night
+    try {
+        snapshot->very_frequent_keys = analyzer_.GetTopKKeys();
+        snapshot->ranked_keys = analyzer_.GetTopKKeys(std::numeric_limits<int>::max());
+    } catch (std::exception &e) {
+        snapshot->very_frequent_keys = previous->very_frequent_keys;
+        snapshot->ranked_keys = previous->ranked_keys;
+    }
+    snapshot->epoch = analyzer_.epoch();
+    // The memory is measured once per epoch, it is O(n)
+    snapshot->analyzer_memory = snapshot->epoch == previous->epoch ? previous->analyzer_memory
+                                                                   : analyzer_.memory_usage();
+    std::atomic_store(&snapshot_, std::shared_ptr<const Snapshot>(snapshot));
+}
+
+#endif //VKTEST_ASYNC_FREQUENCY_ESTIMATION_ANALYZER_H
@@ -0,0 +1,143 @@
+// BoundedQueue implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_BOUNDED_QUEUE_H
+#define VKTEST_BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <stdexcept>
+
+/**
+ *  @brief Bounded lock-free multi-producer multi-consumer queue (Dmitry Vyukov's algorithm).
+ *
+ *  @tparam T  Type of elements, must be default constructible and movable.
+ *
+ *  Every cell has a sequence number which tells producers and consumers whose turn it is, so a push or a pop is one
+ *  CAS on the position plus one release store, without locks and without allocations after construction.
+ *  `TryPush` fails if the queue is full, `TryPop` fails if it is empty.
+ */
+template<typename T>
+class BoundedQueue {
+public:
+    /**
+     *  @brief Queue constructor.
+     *
+     *  @param capacity  Maximum number of elements, must be a power of two (at least 2).
+     */
+    explicit BoundedQueue(size_t capacity);
+
+    BoundedQueue(const BoundedQueue &) = delete;
+
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    bool TryPush(T value);
+
+    bool TryPop(T &value);
+
+    size_t capacity() const {
+        return mask_ + 1;
+    }
+
+    /**
+     *  @brief  Number of positions taken by producers so far (some of them may be not published yet).
+     */
+    size_t enqueue_position() const {
+        return enqueue_position_.load(std::memory_order_acquire);
+    }
+
+    /**
+     *  @brief  Number of elements popped so far.
+     */
+    size_t dequeue_position() const {
+        return dequeue_position_.load(std::memory_order_acquire);
+    }
+
+private:
+    static const size_t kCacheLineSize = 64;
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    const size_t mask_;
+    // Producers and consumers work with different cache lines
+    char padding_0_[kCacheLineSize];
+    std::atomic<size_t> enqueue_position_;
+    char padding_1_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> dequeue_position_;
+    char padding_2_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+};
+
+template<typename T>
+const size_t BoundedQueue<T>::kCacheLineSize;
+
+template<typename T>
+BoundedQueue<T>::BoundedQueue(const size_t capacity)
+        : cells_(new Cell[capacity < 2 ? 2 : capacity]), mask_(capacity - 1), enqueue_position_(0),
+          dequeue_position_(0) {
+    if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+        throw std::invalid_argument("BoundedQueue: capacity must be a power of two");
+    }
+    for (size_t i = 0; i < capacity; ++i) {
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template<typename T>
+bool BoundedQueue<T>::TryPush(T value) {
+    size_t position = enqueue_position_.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;) {
+        cell = &cells_[position & mask_];
+        const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (difference == 0) {
+            // The cell is free for this position, try to take the position
+            if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            // The cell still holds an element of the previous lap: the queue is full
+            return false;
+        } else {
+            position = enqueue_position_.load(std::memory_order_relaxed);
+        }
+    }
+    cell->data = std::move(value);
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename T>
+bool BoundedQueue<T>::TryPop(T &value) {
+    size_t position = dequeue_position_.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;) {
+        cell = &cells_[position & mask_];
+        const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+        if (difference == 0) {
+            if (dequeue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            // Nothing has been pushed to this position yet: the queue is empty
+            return false;
+        } else {
+            position = dequeue_position_.load(std::memory_order_relaxed);
+        }
+    }
+    value = std::move(cell->data);
+    // The cell is free for the position of the next lap
+    cell->sequence.store(position + mask_ + 1, std::memory_order_release);
+    return true;
+}
+
+#endif //VKTEST_BOUNDED_QUEUE_H
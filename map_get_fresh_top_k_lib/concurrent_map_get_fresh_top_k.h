@@ -0,0 +1,657 @@
+// ConcurrentMapGetFreshTopK implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_CONCURRENT_MAP_GET_FRESH_TOP_K_H
+#define VKTEST_CONCURRENT_MAP_GET_FRESH_TOP_K_H
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <functional>
+
+#include "frequency_estimation_analyzer.h"
+#include "integer_keys.h"
+#include "single_flight.h"
+
+namespace concurrent_detail {
+
+// Maximum number of threads using concurrent maps at the same time
+const size_t kMaxThreads = 256;
+
+/**
+ *  @brief  Small id of the thread, unique among living threads, reused after the thread exits.
+ */
+class ThreadId {
+public:
+    ThreadId() : id_(Acquire()) {};
+
+    ~ThreadId() {
+        Registry &registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.used[id_] = false;
+    }
+
+    size_t get() const {
+        return id_;
+    }
+
+private:
+    struct Registry {
+        std::mutex mutex;
+        std::vector<bool> used;
+
+        Registry() : mutex(), used(kMaxThreads, false) {};
+    };
+
+    static Registry &GetRegistry() {
+        static Registry registry;
+        return registry;
+    }
+
+    static size_t Acquire() {
+        Registry &registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (size_t id = 0; id < kMaxThreads; ++id) {
+            if (!registry.used[id]) {
+                registry.used[id] = true;
+                return id;
+            }
+        }
+        throw std::runtime_error("ConcurrentMapGetFreshTopK: too many threads");
+    }
+
+    const size_t id_;
+};
+
+inline size_t CurrentThreadId() {
+    static thread_local ThreadId id;
+    return id.get();
+}
+
+}
+
+/**
+ *  @brief MapGetFreshTopK for many threads with optimistic (lock-free) reads.
+ *
+ *  @tparam Key  Type of key objects, defaults to std::string
+ *  @tparam Tp  Type of mapped objects, defaults to std::string
+ *  @tparam Compare  Comparison function object type, keys are equal if neither is less than the other.
+ *  @tparam Hash  Hash function object type, defaults to the hash of the analyzer.
+ *
+ *  The data is split into shards by key hash, a shard is a chained hash table of immutable nodes with a writer
+ *  mutex and a version (a seqlock). A writer makes the version odd, publishes a new node instead of changing the
+ *  old one and makes the version even again. A reader doesn't write shared memory: it checks the version, copies the
+ *  value from the node and retries if the version has changed meanwhile. Replaced nodes are freed by epoch-based
+ *  reclamation only when no reader can see them.
+ *
+ *  Requests are counted through per-thread buffers: a thread writes keys to its own cache line and moves them to the
+ *  analyzer under its mutex once per 64 requests (and in `get_top_k`).
+ *
+ *  With a loader (`set_loader`) `get_or_load` reads through to the backing store, concurrent misses of a very
+ *  frequent key wait for one load (look SingleFlight).
+ *
+ *  At most concurrent_detail::kMaxThreads threads may use the maps at the same time.
+ */
+template<typename Key = std::string, typename Tp = std::string, typename Compare = std::less<Key>, typename Hash = DefaultKeyHash<Key>>
+class ConcurrentMapGetFreshTopK {
+public:
+    /**
+     *  @brief Map constructor.
+     *
+     *  @param control_time, share_to_be_very_frequent, num_buckets, bucket_size  Configuration of the analyzer
+     *  (look MapGetFreshTopK).
+     *  @param shards_count  Number of independently locked parts, a power of two, defaults to 64.
+     */
+    explicit ConcurrentMapGetFreshTopK(std::chrono::duration<double> control_time = std::chrono::seconds(60),
+                                       double share_to_be_very_frequent = 0.1, size_t num_buckets = 12,
+                                       size_t bucket_size = 54, size_t shards_count = 64);
+
+    /**
+     *  @brief  Destroy the map, no thread may use it at this moment.
+     */
+    ~ConcurrentMapGetFreshTopK();
+
+    ConcurrentMapGetFreshTopK(const ConcurrentMapGetFreshTopK &) = delete;
+
+    ConcurrentMapGetFreshTopK &operator=(const ConcurrentMapGetFreshTopK &) = delete;
+
+    /**
+     *  @brief  Copy the value of `key` to `value`, false if there is no such key. Counted in statistics.
+     *
+     *  Lock-free for readers: retries only if a writer changes the shard at the same time.
+     *
+     *  Time complexity: O(1) on average.
+     */
+    bool get(const Key &key, Tp &value, int64_t weight = 1);
+
+    /**
+     *  @brief  Add or change data. Counted in statistics.
+     *
+     *  Time complexity: O(1) on average (amortized, a shard grows by rehashing).
+     */
+    void set(const Key &key, const Tp &value, int64_t weight = 1);
+
+    /**
+     *  @brief  Remove the key. Returns true if it has been in the map. Not counted in statistics.
+     */
+    bool erase(const Key &key);
+
+    /**
+     *  @brief  Get vector of very frequently asked keys, look MapGetFreshTopK::get_top_k.
+     *
+     *  Moves the buffered requests of all threads to the analyzer first.
+     */
+    std::vector<Key> get_top_k(size_t number = 0);
+
+    /**
+     *  @brief  Set the function loading values of missing keys for `get_or_load`, before the map is used by other
+     *  threads.
+     */
+    void set_loader(std::function<Tp(const Key &)> loader);
+
+    /**
+     *  @brief  Value of `key`, loaded and stored if the key is missing. Counted in statistics (the load is not).
+     *
+     *  Misses of very frequent keys are coalesced: concurrent callers wait for one load, so a hot key missing (e.g.
+     *  after `erase`) sends one request to the backing store instead of one per thread. Other keys are loaded by
+     *  every missing caller without synchronization. A loaded value is only inserted if the key is still missing: a
+     *  value stored by `set` during the load wins and is returned. Exceptions of the loader are passed to the
+     *  callers, nothing is stored then. Throws std::logic_error without a loader.
+     */
+    Tp get_or_load(const Key &key, int64_t weight = 1);
+
+    /**
+     *  @brief  Number of `get_or_load` calls which waited for the load of another thread.
+     */
+    uint64_t coalesced_loads() const {
+        return single_flight_.coalesced_count();
+    }
+
+    size_t size() const;
+
+private:
+    static const size_t kBufferSize = 64;
+    static const size_t kReclaimBatch = 64;
+    static const size_t kInitialShardBuckets = 16;
+
+    struct Node {
+        const uint64_t fingerprint;
+        const Key key;
+        const Tp value;
+        std::atomic<Node *> next;
+
+        Node(uint64_t fingerprint, const Key &key, const Tp &value)
+                : fingerprint(fingerprint), key(key), value(value), next(nullptr) {};
+    };
+
+    struct Table {
+        const size_t mask;
+        std::unique_ptr<std::atomic<Node *>[]> heads;
+
+        explicit Table(size_t buckets_count);
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        // Odd while a writer changes the shard
+        std::atomic<uint64_t> version;
+        std::atomic<Table *> table;
+        std::atomic<size_t> size;
+        // Removed from the table, freed when the global epoch is 2 more than theirs (writers only)
+        std::vector<std::pair<uint64_t, Node *>> retired_nodes;
+        std::vector<std::pair<uint64_t, Table *>> retired_tables;
+        char padding[64];
+
+        Shard() : mutex(), version(0), table(new Table(kInitialShardBuckets)), size(0), retired_nodes(),
+                  retired_tables() {};
+    };
+
+    struct Request {
+        Key key;
+        // Hash of the key for the analyzer
+        uint64_t hash;
+        int64_t weight;
+    };
+
+    // State of one thread, in its own cache lines
+    struct ThreadSlot {
+        // Global epoch at the beginning of the current read, 0 if the thread doesn't read
+        std::atomic<uint64_t> epoch;
+        std::atomic_flag buffer_lock;
+        std::vector<Request> buffer;
+        char padding[64];
+
+        ThreadSlot() : epoch(0), buffer() {
+            buffer_lock.clear();
+        }
+    };
+
+    // Announces a reader for the lifetime of the object
+    class ReadGuard {
+    public:
+        ReadGuard(ThreadSlot &slot, const std::atomic<uint64_t> &global_epoch) : slot_(slot) {
+            slot_.epoch.store(global_epoch.load());
+        }
+
+        ~ReadGuard() {
+            slot_.epoch.store(0, std::memory_order_release);
+        }
+
+    private:
+        ThreadSlot &slot_;
+    };
+
+    // Fingerprint of the table from the hash of the analyzer: shards take the high bits, chains the low ones
+    static uint64_t Fingerprint(uint64_t hash) {
+        return IntegerKeyHash<uint64_t>::Mix(hash);
+    }
+
+    Shard &ShardOf(uint64_t fingerprint) {
+        return shards_[fingerprint >> shard_shift_];
+    }
+
+    static bool Equal(const Node *node, const Key &key, uint64_t fingerprint) {
+        const Compare compare;
+        return node->fingerprint == fingerprint && !compare(node->key, key) && !compare(key, node->key);
+    }
+
+    // The read of `get` without counting
+    bool Find(const Key &key, uint64_t fingerprint, Tp &value);
+
+    // The write of `set` without counting. With `existing` it doesn't replace a present value but copies it there,
+    // returns false then
+    bool Store(const Key &key, uint64_t fingerprint, const Tp &value, Tp *existing = nullptr);
+
+    Tp Load(const Key &key, uint64_t fingerprint);
+
+    // Whether the key is in the top published at the last bucket rotation seen by FlushBuffer
+    bool IsHot(const Key &key) const;
+
+    // Must be called under the shard mutex with an odd version
+    void Grow(Shard &shard);
+
+    void Retire(Shard &shard, Node *node);
+
+    // Advance the global epoch if every reader has seen it, free what no reader can see
+    void Reclaim(Shard &shard);
+
+    void RecordRequest(const Key &key, uint64_t hash, int64_t weight);
+
+    void FlushBuffer(ThreadSlot &slot);
+
+    const Hash hash_;
+    const size_t shard_shift_;
+    const size_t shards_count_;
+    std::unique_ptr<Shard[]> shards_;
+    std::unique_ptr<ThreadSlot[]> slots_;
+    char padding_0_[64];
+    std::atomic<uint64_t> global_epoch_;
+    char padding_1_[64];
+
+    std::mutex analyzer_mutex_;
+    FrequencyEstimationAnalyzer<Key, Compare, Hash> analyzer_;
+    // Very frequent keys sorted by Compare, replaced when the analyzer epoch changes (under analyzer_mutex_)
+    std::shared_ptr<const std::vector<Key>> hot_keys_;
+    uint64_t hot_keys_epoch_;
+
+    std::function<Tp(const Key &)> loader_;
+    SingleFlight<Key, Tp, Compare> single_flight_;
+};
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+const size_t ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::kBufferSize;
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+const size_t ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::kReclaimBatch;
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+const size_t ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::kInitialShardBuckets;
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::Table::Table(const size_t buckets_count)
+        : mask(buckets_count - 1), heads(new std::atomic<Node *>[buckets_count]) {
+    for (size_t i = 0; i < buckets_count; ++i) {
+        heads[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::ConcurrentMapGetFreshTopK(
+        const std::chrono::duration<double> control_time, const double share_to_be_very_frequent,
+        const size_t num_buckets, const size_t bucket_size, const size_t shards_count)
+        : hash_(), shard_shift_(64 - static_cast<size_t>(__builtin_ctzll(shards_count == 0 ? 1 : shards_count))),
+          shards_count_(shards_count), shards_(), slots_(), global_epoch_(1), analyzer_mutex_(),
+          analyzer_(control_time, share_to_be_very_frequent, num_buckets, bucket_size),
+          hot_keys_(std::make_shared<const std::vector<Key>>()), hot_keys_epoch_(0), loader_(), single_flight_() {
+    if (shards_count < 2 || (shards_count & (shards_count - 1)) != 0) {
+        throw std::invalid_argument("ConcurrentMapGetFreshTopK: shards count must be a power of two");
+    }
+    shards_.reset(new Shard[shards_count]);
+    slots_.reset(new ThreadSlot[concurrent_detail::kMaxThreads]);
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::~ConcurrentMapGetFreshTopK() {
+    for (size_t s = 0; s < shards_count_; ++s) {
+        Shard &shard = shards_[s];
+        Table *table = shard.table.load();
+        for (size_t i = 0; i <= table->mask; ++i) {
+            for (Node *node = table->heads[i].load(); node != nullptr;) {
+                Node *next = node->next.load();
+                delete node;
+                node = next;
+            }
+        }
+        delete table;
+        for (size_t i = 0; i < shard.retired_nodes.size(); ++i) {
+            delete shard.retired_nodes[i].second;
+        }
+        for (size_t i = 0; i < shard.retired_tables.size(); ++i) {
+            delete shard.retired_tables[i].second;
+        }
+    }
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+bool ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::get(const Key &key, Tp &value, const int64_t weight) {
+    const uint64_t hash = static_cast<uint64_t>(hash_(key));
+    RecordRequest(key, hash, weight);
+    return Find(key, Fingerprint(hash), value);
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+bool ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::Find(const Key &key, const uint64_t fingerprint, Tp &value) {
+    Shard &shard = ShardOf(fingerprint);
+    ReadGuard guard(slots_[concurrent_detail::CurrentThreadId()], global_epoch_);
+    for (;;) {
+        const uint64_t version = shard.version.load(std::memory_order_acquire);
+        if (version & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        const Table *table = shard.table.load(std::memory_order_acquire);
+        bool found = false;
+        for (const Node *node = table->heads[fingerprint & table->mask].load(std::memory_order_acquire);
+             node != nullptr; node = node->next.load(std::memory_order_acquire)) {
+            if (Equal(node, key, fingerprint)) {
+                // The node is immutable and can't be freed during the read, the copy is never torn
+                value = node->value;
+                found = true;
+                break;
+            }
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (shard.version.load(std::memory_order_relaxed) == version) {
+            return found;
+        }
+    }
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+void ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::set(const Key &key, const Tp &value, const int64_t weight) {
+    const uint64_t hash = static_cast<uint64_t>(hash_(key));
+    RecordRequest(key, hash, weight);
+    Store(key, Fingerprint(hash), value);
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+bool ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::Store(const Key &key, const uint64_t fingerprint,
+                                                              const Tp &value, Tp *existing) {
+    // The copies are made before the version becomes odd, so readers wait less
+    std::unique_ptr<Node> owned_node(new Node(fingerprint, key, value));
+    Shard &shard = ShardOf(fingerprint);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    Table *table = shard.table.load(std::memory_order_relaxed);
+    std::atomic<Node *> *link = &table->heads[fingerprint & table->mask];
+    Node *node = link->load(std::memory_order_relaxed);
+    while (node != nullptr && !Equal(node, key, fingerprint)) {
+        link = &node->next;
+        node = link->load(std::memory_order_relaxed);
+    }
+    if (node != nullptr && existing != nullptr) {
+        *existing = node->value;
+        return false;
+    }
+
+    Node *new_node = owned_node.release();
+    shard.version.fetch_add(1, std::memory_order_acq_rel);
+    if (node != nullptr) {
+        new_node->next.store(node->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        link->store(new_node, std::memory_order_release);
+    } else {
+        std::atomic<Node *> &head = table->heads[fingerprint & table->mask];
+        new_node->next.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        head.store(new_node, std::memory_order_release);
+        if (shard.size.fetch_add(1, std::memory_order_relaxed) + 1 > 2 * (table->mask + 1)) {
+            Grow(shard);
+        }
+    }
+
+    shard.version.fetch_add(1, std::memory_order_release);
+    if (node != nullptr) {
+        Retire(shard, node);
+    }
+    return true;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+bool ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::erase(const Key &key) {
+    const uint64_t fingerprint = Fingerprint(static_cast<uint64_t>(hash_(key)));
+    Shard &shard = ShardOf(fingerprint);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    Table *table = shard.table.load(std::memory_order_relaxed);
+    std::atomic<Node *> *link = &table->heads[fingerprint & table->mask];
+    Node *node = link->load(std::memory_order_relaxed);
+    while (node != nullptr && !Equal(node, key, fingerprint)) {
+        link = &node->next;
+        node = link->load(std::memory_order_relaxed);
+    }
+    if (node == nullptr) {
+        return false;
+    }
+    shard.version.fetch_add(1, std::memory_order_acq_rel);
+    link->store(node->next.load(std::memory_order_relaxed), std::memory_order_release);
+    shard.size.fetch_sub(1, std::memory_order_relaxed);
+    shard.version.fetch_add(1, std::memory_order_release);
+    Retire(shard, node);
+    return true;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+std::vector<Key> ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::get_top_k(const size_t number) {
+    for (size_t i = 0; i < concurrent_detail::kMaxThreads; ++i) {
+        FlushBuffer(slots_[i]);
+    }
+    std::lock_guard<std::mutex> lock(analyzer_mutex_);
+    // #sleep well at night
+    try {
+        return analyzer_.GetTopKKeys(number);
+    } catch (std::exception &e) {
+        return std::vector<Key>();
+    }
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+void ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::set_loader(std::function<Tp(const Key &)> loader) {
+    loader_ = std::move(loader);
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+Tp ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::get_or_load(const Key &key, const int64_t weight) {
+    if (!loader_) {
+        throw std::logic_error("ConcurrentMapGetFreshTopK: no loader is set");
+    }
+    const uint64_t hash = static_cast<uint64_t>(hash_(key));
+    RecordRequest(key, hash, weight);
+    const uint64_t fingerprint = Fingerprint(hash);
+    Tp value;
+    if (Find(key, fingerprint, value)) {
+        return value;
+    }
+    if (!IsHot(key)) {
+        return Load(key, fingerprint);
+    }
+    return single_flight_.Do(key, [this, &key, fingerprint]() -> Tp {
+        // The previous load of the key may have finished after our miss
+        Tp stored;
+        if (Find(key, fingerprint, stored)) {
+            return stored;
+        }
+        return Load(key, fingerprint);
+    });
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+size_t ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::size() const {
+    size_t size = 0;
+    for (size_t s = 0; s < shards_count_; ++s) {
+        size += shards_[s].size.load(std::memory_order_relaxed);
+    }
+    return size;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+Tp ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::Load(const Key &key, const uint64_t fingerprint) {
+    const Tp value = loader_(key);
+    // A `set` made during the load is newer than the loaded value, it is kept and returned
+    Tp existing;
+    if (!Store(key, fingerprint, value, &existing)) {
+        return existing;
+    }
+    return value;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+bool ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::IsHot(const Key &key) const {
+    const std::shared_ptr<const std::vector<Key>> hot_keys = std::atomic_load(&hot_keys_);
+    return std::binary_search(hot_keys->begin(), hot_keys->end(), key, Compare());
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+void ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::Grow(Shard &shard) {
+    Table *old_table = shard.table.load(std::memory_order_relaxed);
+    Table *new_table = new Table((old_table->mask + 1) * 2);
+    // Nodes are relinked: a reader walking a chain now may jump to another one, the odd version makes it retry
+    for (size_t i = 0; i <= old_table->mask; ++i) {
+        for (Node *node = old_table->heads[i].load(std::memory_order_relaxed); node != nullptr;) {
+            Node *next = node->next.load(std::memory_order_relaxed);
+            std::atomic<Node *> &head = new_table->heads[node->fingerprint & new_table->mask];
+            node->next.store(head.load(std::memory_order_relaxed), std::memory_order_release);
+            head.store(node, std::memory_order_release);
+            node = next;
+        }
+    }
+    shard.table.store(new_table, std::memory_order_release);
+    shard.retired_tables.push_back(std::make_pair(global_epoch_.load(), old_table));
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+void ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::Retire(Shard &shard, Node *node) {
+    shard.retired_nodes.push_back(std::make_pair(global_epoch_.load(), node));
+    if (shard.retired_nodes.size() >= kReclaimBatch) {
+        Reclaim(shard);
+    }
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+void ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::Reclaim(Shard &shard) {
+    uint64_t epoch = global_epoch_.load();
+    bool readers_are_current = true;
+    for (size_t i = 0; i < concurrent_detail::kMaxThreads && readers_are_current; ++i) {
+        const uint64_t reader_epoch = slots_[i].epoch.load();
+        readers_are_current = reader_epoch == 0 || reader_epoch == epoch;
+    }
+    if (readers_are_current && global_epoch_.compare_exchange_strong(epoch, epoch + 1)) {
+        ++epoch;
+    }
+
+    // A reader which could see an object retired at epoch e has announced e or less, the epoch can't pass e + 1
+    // until it finishes
+    size_t kept = 0;
+    for (size_t i = 0; i < shard.retired_nodes.size(); ++i) {
+        if (shard.retired_nodes[i].first + 2 <= epoch) {
+            delete shard.retired_nodes[i].second;
+        } else {
+            shard.retired_nodes[kept++] = shard.retired_nodes[i];
+        }
+    }
+    shard.retired_nodes.resize(kept);
+    kept = 0;
+    for (size_t i = 0; i < shard.retired_tables.size(); ++i) {
+        if (shard.retired_tables[i].first + 2 <= epoch) {
+            delete shard.retired_tables[i].second;
+        } else {
+            shard.retired_tables[kept++] = shard.retired_tables[i];
+        }
+    }
+    shard.retired_tables.resize(kept);
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+void ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::RecordRequest(const Key &key, const uint64_t hash,
+                                                                      const int64_t weight) {
+    if (weight < 1) {
+        throw std::invalid_argument("ConcurrentMapGetFreshTopK: weight of a request must be positive");
+    }
+    ThreadSlot &slot = slots_[concurrent_detail::CurrentThreadId()];
+    while (slot.buffer_lock.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+    slot.buffer.push_back(Request{key, hash, weight});
+    const bool full = slot.buffer.size() >= kBufferSize;
+    slot.buffer_lock.clear(std::memory_order_release);
+    if (full) {
+        FlushBuffer(slot);
+    }
+}
+
+template<typename Key, typename Tp, typename Compare, typename Hash>
+void ConcurrentMapGetFreshTopK<Key, Tp, Compare, Hash>::FlushBuffer(ThreadSlot &slot) {
+    std::vector<Request> requests;
+    while (slot.buffer_lock.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+    requests.swap(slot.buffer);
+    slot.buffer_lock.clear(std::memory_order_release);
+    if (requests.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(analyzer_mutex_);
+    for (size_t i = 0; i < requests.size(); ++i) {
+        // #sleep well at night
+        try {
+            analyzer_.AddKeyWithHash(requests[i].key, requests[i].hash, requests[i].weight);
+        } catch (std::exception &e) {
+            // don't try again add this key - an exception is a rare situation, this action doesn't affect statistics
+        }
+    }
+    if (analyzer_.epoch() != hot_keys_epoch_) {
+        std::vector<Key> hot_keys;
+        // #sleep well at night
+        try {
+            hot_keys = analyzer_.GetTopKKeys();
+        } catch (std::exception &e) {
+            // misses are not coalesced until the next epoch
+        }
+        std::sort(hot_keys.begin(), hot_keys.end(), Compare());
+        std::atomic_store(&hot_keys_, std::shared_ptr<const std::vector<Key>>(
+                std::make_shared<const std::vector<Key>>(std::move(hot_keys))));
+        // GetTopKKeys may rotate buckets too
+        hot_keys_epoch_ = analyzer_.epoch();
+    }
+}
+
+#endif //VKTEST_CONCURRENT_MAP_GET_FRESH_TOP_K_H
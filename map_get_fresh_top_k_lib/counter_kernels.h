@@ -0,0 +1,245 @@
+// Counter kernels implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_COUNTER_KERNELS_H
+#define VKTEST_COUNTER_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
+/**
+ *  Scans over contiguous arrays of bucket counters and fingerprints (look SoaCounterBucket).
+ *
+ *  Every kernel has an AVX2 version (4 counters per instruction), an SSE4.2 version (2 counters per instruction) and
+ *  a scalar fallback, the version is chosen at compile time by the target flags (e.g. -mavx2 or -march=native).
+ *  Arrays don't have to be aligned, tails are processed by scalar code.
+ */
+namespace counter_kernels {
+
+/**
+ *  @brief  Index of the first fingerprint equal to `fingerprint` starting from `from`, `size` if there is no one.
+ */
+inline size_t FindFingerprint(const uint64_t *fingerprints, const size_t size, const uint64_t fingerprint,
+                              size_t from = 0) {
+    size_t i = from;
+#if defined(__AVX2__)
+    const __m256i needle = _mm256_set1_epi64x(static_cast<long long>(fingerprint));
+    for (; i + 4 <= size; i += 4) {
+        const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(fingerprints + i));
+        const int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(values, needle)));
+        if (mask != 0) {
+            return i + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+    }
+#elif defined(__SSE4_2__)
+    const __m128i needle = _mm_set1_epi64x(static_cast<long long>(fingerprint));
+    for (; i + 2 <= size; i += 2) {
+        const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(fingerprints + i));
+        const int mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(values, needle)));
+        if (mask != 0) {
+            return i + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        if (fingerprints[i] == fingerprint) {
+            return i;
+        }
+    }
+    return size;
+}
+
+/**
+ *  @brief  Index of the first zero counter, `size` if there is no one.
+ */
+inline size_t FindZero(const int64_t *counters, const size_t size) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    for (; i + 4 <= size; i += 4) {
+        const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(counters + i));
+        const int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(values, zero)));
+        if (mask != 0) {
+            return i + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+    }
+#elif defined(__SSE4_2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 2 <= size; i += 2) {
+        const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(counters + i));
+        const int mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(values, zero)));
+        if (mask != 0) {
+            return i + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        if (counters[i] == 0) {
+            return i;
+        }
+    }
+    return size;
+}
+
+/**
+ *  @brief  Decrease every positive counter by one.
+ */
+inline void DecrementPositive(int64_t *counters, const size_t size) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    for (; i + 4 <= size; i += 4) {
+        __m256i *address = reinterpret_cast<__m256i *>(counters + i);
+        const __m256i values = _mm256_loadu_si256(address);
+        // (values > 0) is -1 in the lanes to decrement
+        _mm256_storeu_si256(address, _mm256_add_epi64(values, _mm256_cmpgt_epi64(values, zero)));
+    }
+#elif defined(__SSE4_2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 2 <= size; i += 2) {
+        __m128i *address = reinterpret_cast<__m128i *>(counters + i);
+        const __m128i values = _mm_loadu_si128(address);
+        _mm_storeu_si128(address, _mm_add_epi64(values, _mm_cmpgt_epi64(values, zero)));
+    }
+#endif
+    for (; i < size; ++i) {
+        counters[i] -= counters[i] > 0;
+    }
+}
+
+/**
+ *  @brief  Decrease every counter by `delta`, counters which would become negative become zero.
+ */
+inline void SubtractSaturating(int64_t *counters, const size_t size, const int64_t delta) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i subtrahend = _mm256_set1_epi64x(static_cast<long long>(delta));
+    for (; i + 4 <= size; i += 4) {
+        __m256i *address = reinterpret_cast<__m256i *>(counters + i);
+        const __m256i values = _mm256_sub_epi64(_mm256_loadu_si256(address), subtrahend);
+        // There is no 64-bit max before AVX-512, lanes with (values > 0) are kept by the mask
+        _mm256_storeu_si256(address, _mm256_and_si256(values, _mm256_cmpgt_epi64(values, zero)));
+    }
+#elif defined(__SSE4_2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i subtrahend = _mm_set1_epi64x(static_cast<long long>(delta));
+    for (; i + 2 <= size; i += 2) {
+        __m128i *address = reinterpret_cast<__m128i *>(counters + i);
+        const __m128i values = _mm_sub_epi64(_mm_loadu_si128(address), subtrahend);
+        _mm_storeu_si128(address, _mm_and_si128(values, _mm_cmpgt_epi64(values, zero)));
+    }
+#endif
+    for (; i < size; ++i) {
+        counters[i] = counters[i] > delta ? counters[i] - delta : 0;
+    }
+}
+
+/**
+ *  @brief  Minimum of the counters, INT64_MAX if `size` is zero.
+ */
+inline int64_t FindMin(const int64_t *counters, const size_t size) {
+    size_t i = 0;
+    int64_t result = INT64_MAX;
+#if defined(__AVX2__)
+    if (size >= 4) {
+        __m256i minimum = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(counters));
+        for (i = 4; i + 4 <= size; i += 4) {
+            const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(counters + i));
+            minimum = _mm256_blendv_epi8(minimum, values, _mm256_cmpgt_epi64(minimum, values));
+        }
+        alignas(32) int64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), minimum);
+        for (size_t lane = 0; lane < 4; ++lane) {
+            result = lanes[lane] < result ? lanes[lane] : result;
+        }
+    }
+#elif defined(__SSE4_2__)
+    if (size >= 2) {
+        __m128i minimum = _mm_loadu_si128(reinterpret_cast<const __m128i *>(counters));
+        for (i = 2; i + 2 <= size; i += 2) {
+            const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(counters + i));
+            minimum = _mm_blendv_epi8(minimum, values, _mm_cmpgt_epi64(minimum, values));
+        }
+        alignas(16) int64_t lanes[2];
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanes), minimum);
+        result = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+    }
+#endif
+    for (; i < size; ++i) {
+        result = counters[i] < result ? counters[i] : result;
+    }
+    return result;
+}
+
+/**
+ *  @brief  Write indices of counters >= `threshold` to `indices`, return their number.
+ *
+ *  `indices` must have room for `size` elements.
+ */
+inline size_t CollectAtLeast(const int64_t *counters, const size_t size, const int64_t threshold,
+                             uint32_t *indices) {
+    size_t i = 0;
+    size_t found = 0;
+#if defined(__AVX2__)
+    // counter >= threshold  <=>  counter > threshold - 1
+    const __m256i bound = _mm256_set1_epi64x(static_cast<long long>(threshold - 1));
+    for (; i + 4 <= size; i += 4) {
+        const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(counters + i));
+        unsigned mask = static_cast<unsigned>(
+                _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(values, bound))));
+        while (mask != 0) {
+            indices[found++] = static_cast<uint32_t>(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+#elif defined(__SSE4_2__)
+    const __m128i bound = _mm_set1_epi64x(static_cast<long long>(threshold - 1));
+    for (; i + 2 <= size; i += 2) {
+        const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(counters + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(values, bound))));
+        while (mask != 0) {
+            indices[found++] = static_cast<uint32_t>(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        if (counters[i] >= threshold) {
+            indices[found++] = static_cast<uint32_t>(i);
+        }
+    }
+    return found;
+}
+
+/**
+ *  @brief  target[i] = max(target[i], source[i]) for bytes, e.g. merging of HyperLogLog registers.
+ */
+inline void MaxBytes(uint8_t *target, const uint8_t *source, const size_t size) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 32 <= size; i += 32) {
+        const __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(target + i));
+        const __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(target + i), _mm256_max_epu8(left, right));
+    }
+#elif defined(__SSE4_2__)
+    for (; i + 16 <= size; i += 16) {
+        const __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i *>(target + i));
+        const __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(target + i), _mm_max_epu8(left, right));
+    }
+#endif
+    for (; i < size; ++i) {
+        target[i] = source[i] > target[i] ? source[i] : target[i];
+    }
+}
+
+}
+
+#endif //VKTEST_COUNTER_KERNELS_H
@@ -0,0 +1,179 @@
+// Doorkeeper implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_DOORKEEPER_H
+#define VKTEST_DOORKEEPER_H
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+#include "integer_keys.h"
+
+/**
+ *  @brief Filter of keys seen for the first time in the current or the previous epoch.
+ *
+ *  Two Bloom filters over key fingerprints: the current epoch and the previous one. `Admit` remembers the key in the
+ *  current filter and says whether it has been seen before in one of them, `Rotate` is called at every epoch change.
+ *  So a key which is requested at least once per epoch is always admitted after its very first request.
+ *
+ *  False positives only admit a one-hit key, there are no false negatives.
+ *
+ *  Rejected requests are also remembered in a direct-mapped table (fingerprint, weight, epoch) of ~expected_keys / 4
+ *  slots, so the first admission of a key reports the weight rejected before it (the count correction). A rejected
+ *  request whose slot has been taken by another key is not reported: counts are only ever underestimated.
+ */
+class Doorkeeper {
+public:
+    /**
+     *  @brief Doorkeeper constructor.
+     *
+     *  @param expected_keys  Expected number of different keys per epoch.
+     *  @param false_positive_rate  Desired share of one-hit keys admitted by mistake, defaults to 0.01.
+     *
+     *  Memory: 2 * ~1.44 * expected_keys * log2(1 / false_positive_rate) bits, rounded up to a power of two.
+     */
+    explicit Doorkeeper(size_t expected_keys, double false_positive_rate = 0.01);
+
+    /**
+     *  @brief  Remember the key, return true if it has been seen in this or the previous epoch.
+     *
+     *  Time complexity: O(number of hash functions).
+     */
+    bool Admit(uint64_t fingerprint);
+
+    /**
+     *  @brief  Admit with the count correction.
+     *  @param  weight  Weight of the request, remembered if it is rejected.
+     *  @param  rejected_weight  Set to the weight of the rejected request of the key if this is its first admission
+     *          after it, 0 otherwise.
+     *  @param  rejected_in_previous_epoch  Set to whether that request was made before the last `Rotate`.
+     */
+    bool Admit(uint64_t fingerprint, int64_t weight, int64_t &rejected_weight, bool &rejected_in_previous_epoch);
+
+    /**
+     *  @brief  Start a new epoch: the current filter becomes the previous one, the new current one is empty.
+     */
+    void Rotate();
+
+    size_t bits_count() const {
+        return (mask_ + 1) * 2;
+    }
+
+    size_t hashes_count() const {
+        return hashes_count_;
+    }
+
+    size_t memory_usage() const {
+        return sizeof(*this) + (current_.capacity() + previous_.capacity()) * sizeof(uint64_t) +
+               rejected_.capacity() * sizeof(Rejection);
+    }
+
+private:
+    struct Rejection {
+        uint32_t tag;
+        uint32_t epoch;
+        // 0 if the slot is free
+        int64_t weight;
+    };
+
+    // Sets the bits of the key, returns true if all of them have been set already
+    bool TestAndSet(std::vector<uint64_t> &filter, uint64_t first, uint64_t second) const;
+
+    bool Test(const std::vector<uint64_t> &filter, uint64_t first, uint64_t second) const;
+
+    std::vector<uint64_t> current_;
+    std::vector<uint64_t> previous_;
+    // Bit index mask, a filter has mask_ + 1 bits
+    size_t mask_;
+    size_t hashes_count_;
+    std::vector<Rejection> rejected_;
+    uint32_t epoch_;
+};
+
+inline Doorkeeper::Doorkeeper(const size_t expected_keys, const double false_positive_rate)
+        : current_(), previous_(), mask_(0), hashes_count_(0), rejected_(), epoch_(0) {
+    if (expected_keys == 0 || !(false_positive_rate > 0 && false_positive_rate < 1)) {
+        throw std::invalid_argument("Doorkeeper: expected keys must be positive, false positive rate in (0, 1)");
+    }
+    const double log2 = std::log(2.0);
+    const double optimal_bits = -(double) expected_keys * std::log(false_positive_rate) / (log2 * log2);
+    size_t bits = 64;
+    while ((double) bits < optimal_bits) {
+        bits *= 2;
+    }
+    mask_ = bits - 1;
+    hashes_count_ = std::max<size_t>(1, static_cast<size_t>(std::round((double) bits / expected_keys * log2)));
+    hashes_count_ = std::min<size_t>(hashes_count_, 16);
+    current_.assign(bits / 64, 0);
+    previous_.assign(bits / 64, 0);
+    size_t slots = 64;
+    while (slots < expected_keys / 4) {
+        slots *= 2;
+    }
+    const Rejection free_slot = {0, 0, 0};
+    rejected_.assign(slots, free_slot);
+}
+
+inline bool Doorkeeper::Admit(const uint64_t fingerprint) {
+    int64_t rejected_weight;
+    bool rejected_in_previous_epoch;
+    return Admit(fingerprint, 1, rejected_weight, rejected_in_previous_epoch);
+}
+
+inline bool Doorkeeper::Admit(const uint64_t fingerprint, const int64_t weight, int64_t &rejected_weight,
+                              bool &rejected_in_previous_epoch) {
+    // Double hashing (Kirsch-Mitzenmacher): the i-th bit is first + i * second
+    const uint64_t mixed = IntegerKeyHash<uint64_t>::Mix(fingerprint);
+    const uint64_t first = mixed & 0xffffffffULL;
+    const uint64_t second = (mixed >> 32) | 1;
+    const bool admitted = TestAndSet(current_, first, second) || Test(previous_, first, second);
+
+    // The slot and the tag are taken from other bits than the filter ones
+    Rejection &rejection = rejected_[(fingerprint >> 32) & (rejected_.size() - 1)];
+    const uint32_t tag = static_cast<uint32_t>(fingerprint);
+    rejected_weight = 0;
+    rejected_in_previous_epoch = false;
+    if (!admitted) {
+        rejection.tag = tag;
+        rejection.epoch = epoch_;
+        rejection.weight = weight;
+    } else if (rejection.weight != 0 && rejection.tag == tag && epoch_ - rejection.epoch <= 1) {
+        rejected_weight = rejection.weight;
+        rejected_in_previous_epoch = rejection.epoch != epoch_;
+        rejection.weight = 0;
+    }
+    return admitted;
+}
+
+inline void Doorkeeper::Rotate() {
+    current_.swap(previous_);
+    std::fill(current_.begin(), current_.end(), 0);
+    ++epoch_;
+}
+
+inline bool Doorkeeper::TestAndSet(std::vector<uint64_t> &filter, const uint64_t first, const uint64_t second) const {
+    bool seen = true;
+    for (size_t i = 0; i < hashes_count_; ++i) {
+        const size_t bit = static_cast<size_t>(first + i * second) & mask_;
+        const uint64_t flag = 1ULL << (bit & 63);
+        seen &= (filter[bit >> 6] & flag) != 0;
+        filter[bit >> 6] |= flag;
+    }
+    return seen;
+}
+
+inline bool Doorkeeper::Test(const std::vector<uint64_t> &filter, const uint64_t first, const uint64_t second) const {
+    for (size_t i = 0; i < hashes_count_; ++i) {
+        const size_t bit = static_cast<size_t>(first + i * second) & mask_;
+        if ((filter[bit >> 6] & (1ULL << (bit & 63))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif //VKTEST_DOORKEEPER_H
@@ -0,0 +1,220 @@
+// FixedFrequencyEstimationAnalyzer implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_FIXED_FREQUENCY_ESTIMATION_ANALYZER_H
+#define VKTEST_FIXED_FREQUENCY_ESTIMATION_ANALYZER_H
+
+#include <array>
+#include <string>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <functional>
+
+#include "counter_kernels.h"
+#include "integer_keys.h"
+
+/**
+ *  @brief Duplicate key request frequency analyzer with compile-time configuration.
+ *
+ *  @tparam Key  Type of key objects.
+ *  @tparam NumBuckets  Amount of buckets.
+ *  @tparam BucketSize  Size of each bucket.
+ *  @tparam ShareNum  Numerator of the share of requests for keys to be considered as "very frequent".
+ *  @tparam ShareDen  Denominator of the share, e.g. ShareNum = 1, ShareDen = 10 for 10%.
+ *  @tparam Compare  Comparison function object type, defaults to less<Key>.
+ *  @tparam Hash  Hash function object type for key fingerprints, defaults to DefaultKeyHash<Key>
+ *  (IntegerKeyHash for fixed-width integer keys, hash<Key> otherwise).
+ *
+ *  The same algorithm as FrequencyEstimationAnalyzer for a fixed production configuration: buckets are std::arrays
+ *  in a ring, so there are no allocations after construction, every per-bucket pass has a compile-time trip count
+ *  and the "very frequent" threshold is computed in integers by a constexpr function.
+ *
+ *  A slot with zero counter is free: keys are never erased, a zero slot is just reused by the next new key.
+ */
+template<typename Key, size_t NumBuckets, size_t BucketSize, int64_t ShareNum, int64_t ShareDen,
+        typename Compare = std::less<Key>, typename Hash = DefaultKeyHash<Key>>
+class FixedFrequencyEstimationAnalyzer {
+    static_assert(NumBuckets > 0 && BucketSize > 0, "Buckets must not be empty");
+    static_assert(0 < ShareNum && ShareNum < ShareDen, "Share must be in (0, 1)");
+
+public:
+    /**
+     *  @brief  Minimum counter of a key which can be very frequent among `n` requests.
+     *
+     *  floor(n * share) - ceil(n * (1 - share) / BucketSize) - 2, the same bound as in FrequencyEstimationAnalyzer.
+     */
+    static constexpr int64_t MinVeryFrequentCount(int64_t n) {
+        return n * ShareNum / ShareDen -
+               (n * (ShareDen - ShareNum) + ShareDen * static_cast<int64_t>(BucketSize) - 1) /
+               (ShareDen * static_cast<int64_t>(BucketSize)) - 2;
+    }
+
+    /**
+     *  @brief Fixed analyzer constructor.
+     *
+     *  @param control_time  Timespan, defaults to 60 seconds.
+     */
+    explicit FixedFrequencyEstimationAnalyzer(std::chrono::duration<double> control_time = std::chrono::seconds(60));
+
+    /**
+     *  @brief  Transfer information about a newly added key.
+     *
+     *  Time complexity: O(NumBuckets * BucketSize), no allocations.
+     */
+    void AddKey(const Key &key);
+
+    /**
+     *  @brief  Get vector of very frequently asked keys for the last time (look FrequencyEstimationAnalyzer).
+     */
+    std::vector<Key> GetTopKKeys(size_t number = 0);
+
+private:
+    static const size_t kBucketsCount = NumBuckets + 1;
+
+    struct FixedBucket {
+        alignas(64) std::array<int64_t, BucketSize> counters;
+        alignas(64) std::array<uint64_t, BucketSize> fingerprints;
+        std::array<Key, BucketSize> keys;
+        std::chrono::system_clock::time_point created_at;
+        int64_t add_new_key_count;
+    };
+
+    void DeleteOldAddNewBuckets();
+
+    void AddKeyToBucket(FixedBucket &bucket, const Key &key, uint64_t fingerprint) const;
+
+    static void ResetBucket(FixedBucket &bucket, std::chrono::system_clock::time_point created_at);
+
+    FixedBucket &Bucket(size_t index);
+
+    const std::chrono::duration<double> full_control_time_;
+    const Hash hash_;
+
+    // Ring of buckets from the oldest one (buckets_[first_]) to the newest one
+    std::array<FixedBucket, kBucketsCount> buckets_;
+    size_t first_;
+    size_t count_;
+};
+
+template<typename Key, size_t NumBuckets, size_t BucketSize, int64_t ShareNum, int64_t ShareDen, typename Compare,
+        typename Hash>
+FixedFrequencyEstimationAnalyzer<Key, NumBuckets, BucketSize, ShareNum, ShareDen, Compare, Hash>::
+FixedFrequencyEstimationAnalyzer(const std::chrono::duration<double> control_time)
+        : full_control_time_(control_time / NumBuckets * (NumBuckets + 1)), hash_(), buckets_(), first_(0),
+          count_(0) {};
+
+template<typename Key, size_t NumBuckets, size_t BucketSize, int64_t ShareNum, int64_t ShareDen, typename Compare,
+        typename Hash>
+const size_t FixedFrequencyEstimationAnalyzer<Key, NumBuckets, BucketSize, ShareNum, ShareDen, Compare, Hash>::
+        kBucketsCount;
+
+template<typename Key, size_t NumBuckets, size_t BucketSize, int64_t ShareNum, int64_t ShareDen, typename Compare,
+        typename Hash>
+void FixedFrequencyEstimationAnalyzer<Key, NumBuckets, BucketSize, ShareNum, ShareDen, Compare, Hash>::AddKey(
+        const Key &key) {
+    DeleteOldAddNewBuckets();
+    const uint64_t fingerprint = static_cast<uint64_t>(hash_(key));
+    for (size_t i = 0; i < count_; ++i) {
+        FixedBucket &bucket = Bucket(i);
+        ++bucket.add_new_key_count;
+        AddKeyToBucket(bucket, key, fingerprint);
+    }
+}
+
+template<typename Key, size_t NumBuckets, size_t BucketSize, int64_t ShareNum, int64_t ShareDen, typename Compare,
+        typename Hash>
+std::vector<Key>
+FixedFrequencyEstimationAnalyzer<Key, NumBuckets, BucketSize, ShareNum, ShareDen, Compare, Hash>::GetTopKKeys(
+        const size_t number) {
+    DeleteOldAddNewBuckets();
+    const FixedBucket &bucket = Bucket(0);
+
+    // Zero counters are free slots, they are never reported
+    const int64_t min_count = number == 0 ? std::max<int64_t>(MinVeryFrequentCount(bucket.add_new_key_count), 1) : 1;
+    std::array<uint32_t, BucketSize> indices;
+    const size_t found = counter_kernels::CollectAtLeast(bucket.counters.data(), BucketSize, min_count,
+                                                         indices.data());
+    std::sort(indices.begin(), indices.begin() + found, [&bucket](uint32_t left, uint32_t right) {
+        return bucket.counters[left] > bucket.counters[right];
+    });
+
+    const size_t result_size = number == 0 ? found : std::min(found, number);
+    std::vector<Key> result;
+    result.reserve(result_size);
+    for (size_t i = 0; i < result_size; ++i) {
+        result.push_back(bucket.keys[indices[i]]);
+    }
+    return result;
+}
+
+template<typename Key, size_t NumBuckets, size_t BucketSize, int64_t ShareNum, int64_t ShareDen, typename Compare,
+        typename Hash>
+void FixedFrequencyEstimationAnalyzer<Key, NumBuckets, BucketSize, ShareNum, ShareDen, Compare, Hash>::
+DeleteOldAddNewBuckets() {
+    const std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+    while (count_ > 0 && now - Bucket(0).created_at > full_control_time_) {
+        first_ = (first_ + 1) % kBucketsCount;
+        --count_;
+    }
+
+    if (count_ == 0 || now - Bucket(count_ - 1).created_at > full_control_time_ / kBucketsCount) {
+        if (count_ == kBucketsCount) {
+            first_ = (first_ + 1) % kBucketsCount;
+            --count_;
+        }
+        ResetBucket(Bucket(count_), now);
+        ++count_;
+    }
+}
+
+template<typename Key, size_t NumBuckets, size_t BucketSize, int64_t ShareNum, int64_t ShareDen, typename Compare,
+        typename Hash>
+void FixedFrequencyEstimationAnalyzer<Key, NumBuckets, BucketSize, ShareNum, ShareDen, Compare, Hash>::
+AddKeyToBucket(FixedBucket &bucket, const Key &key, const uint64_t fingerprint) const {
+    const Compare compare;
+
+    // IncrementCounter: a match in a zero slot is fine, it is the same as a new counter
+    const uint64_t *fingerprints = bucket.fingerprints.data();
+    for (size_t i = counter_kernels::FindFingerprint(fingerprints, BucketSize, fingerprint);
+         i < BucketSize; i = counter_kernels::FindFingerprint(fingerprints, BucketSize, fingerprint, i + 1)) {
+        if (!compare(bucket.keys[i], key) && !compare(key, bucket.keys[i])) {
+            ++bucket.counters[i];
+            return;
+        }
+    }
+
+    // CreateNewCounter
+    const size_t index = counter_kernels::FindZero(bucket.counters.data(), BucketSize);
+    if (index < BucketSize) {
+        bucket.counters[index] = 1;
+        bucket.fingerprints[index] = fingerprint;
+        bucket.keys[index] = key;
+        return;
+    }
+
+    // DecreaseAllCounters
+    counter_kernels::DecrementPositive(bucket.counters.data(), BucketSize);
+}
+
+template<typename Key, size_t NumBuckets, size_t BucketSize, int64_t ShareNum, int64_t ShareDen, typename Compare,
+        typename Hash>
+void FixedFrequencyEstimationAnalyzer<Key, NumBuckets, BucketSize, ShareNum, ShareDen, Compare, Hash>::ResetBucket(
+        FixedBucket &bucket, const std::chrono::system_clock::time_point created_at) {
+    bucket.counters.fill(0);
+    bucket.created_at = created_at;
+    bucket.add_new_key_count = 0;
+}
+
+template<typename Key, size_t NumBuckets, size_t BucketSize, int64_t ShareNum, int64_t ShareDen, typename Compare,
+        typename Hash>
+typename FixedFrequencyEstimationAnalyzer<Key, NumBuckets, BucketSize, ShareNum, ShareDen, Compare, Hash>::FixedBucket &
+FixedFrequencyEstimationAnalyzer<Key, NumBuckets, BucketSize, ShareNum, ShareDen, Compare, Hash>::Bucket(
+        const size_t index) {
+    return buckets_[(first_ + index) % kBucketsCount];
+}
+
+#endif //VKTEST_FIXED_FREQUENCY_ESTIMATION_ANALYZER_H
@@ -0,0 +1,262 @@
+// FlatIntegerMap implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_FLAT_INTEGER_MAP_H
+#define VKTEST_FLAT_INTEGER_MAP_H
+
+#include <map>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <functional>
+#include <type_traits>
+
+#include "integer_keys.h"
+#include "memory_usage.h"
+
+/**
+ *  @brief Hash map for fixed-width integer keys with keys stored inline in a flat array.
+ *
+ *  @tparam Key  Type of key objects, IsFixedWidthIntegerKey<Key> must be true.
+ *  @tparam Tp  Type of mapped objects.
+ *
+ *  Open addressing with linear probing over a power-of-two array of (key, value index) slots, deletion by backward
+ *  shift (no tombstones). Values live in a std::deque and are never moved, so references and pointers returned by
+ *  `operator[]` and `find` stay valid until the key is erased, like in std::map. Erased value places are reused.
+ *  There is no per-key heap allocation: the slot array grows by doubling, the deque by chunks.
+ *
+ *  The subset of the std::map interface used by MapGetFreshTopK is provided; `find` returns a pointer to the
+ *  (key, value) pair, `end()` is nullptr.
+ */
+template<typename Key, typename Tp>
+class FlatIntegerMap {
+    static_assert(IsFixedWidthIntegerKey<Key>::value, "FlatIntegerMap is made for fixed-width integer keys");
+
+public:
+    typedef Key key_type;
+    typedef Tp mapped_type;
+    typedef std::pair<const Key, Tp> value_type;
+    typedef value_type *iterator;
+    typedef const value_type *const_iterator;
+
+    FlatIntegerMap();
+
+    Tp &operator[](const Key &key);
+
+    iterator find(const Key &key);
+
+    const_iterator find(const Key &key) const;
+
+    iterator end() {
+        return nullptr;
+    }
+
+    const_iterator end() const {
+        return nullptr;
+    }
+
+    size_t count(const Key &key) const;
+
+    /**
+     *  @brief  Remove the key. Returns the number of removed elements (0 or 1).
+     */
+    size_t erase(const Key &key);
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    /**
+     *  @brief  Number of slots of the flat array.
+     */
+    size_t capacity() const {
+        return slots_.size();
+    }
+
+    void clear();
+
+    /**
+     *  @brief  Memory of the slot array, the values and the free list. Time complexity: O(n).
+     */
+    MemoryUsage memory_usage() const;
+
+private:
+    static const uint32_t kEmpty = static_cast<uint32_t>(-1);
+
+    struct Slot {
+        Key key;
+        uint32_t value_index;
+    };
+
+    // Index of the slot of `key` or of the empty slot where it should be
+    size_t Probe(const Key &key) const;
+
+    void Grow();
+
+    std::vector<Slot> slots_;
+    std::deque<value_type> values_;
+    std::vector<uint32_t> free_values_;
+    size_t size_;
+    IntegerKeyHash<Key> hash_;
+};
+
+template<typename Key, typename Tp>
+const uint32_t FlatIntegerMap<Key, Tp>::kEmpty;
+
+template<typename Key, typename Tp>
+FlatIntegerMap<Key, Tp>::FlatIntegerMap()
+        : slots_(16, Slot{Key(), kEmpty}), values_(), free_values_(), size_(0), hash_() {};
+
+template<typename Key, typename Tp>
+Tp &FlatIntegerMap<Key, Tp>::operator[](const Key &key) {
+    size_t index = Probe(key);
+    if (slots_[index].value_index != kEmpty) {
+        return values_[slots_[index].value_index].second;
+    }
+
+    // Keep the load factor <= 1/2, linear probing degrades fast above it
+    if ((size_ + 1) * 2 > slots_.size()) {
+        Grow();
+        index = Probe(key);
+    }
+
+    uint32_t value_index;
+    if (!free_values_.empty()) {
+        value_index = free_values_.back();
+        free_values_.pop_back();
+        value_type *place = &values_[value_index];
+        place->~value_type();
+        new(place) value_type(key, Tp());
+    } else {
+        value_index = static_cast<uint32_t>(values_.size());
+        values_.emplace_back(key, Tp());
+    }
+    slots_[index].key = key;
+    slots_[index].value_index = value_index;
+    ++size_;
+    return values_[value_index].second;
+}
+
+template<typename Key, typename Tp>
+typename FlatIntegerMap<Key, Tp>::iterator FlatIntegerMap<Key, Tp>::find(const Key &key) {
+    const size_t index = Probe(key);
+    return slots_[index].value_index == kEmpty ? end() : &values_[slots_[index].value_index];
+}
+
+template<typename Key, typename Tp>
+typename FlatIntegerMap<Key, Tp>::const_iterator FlatIntegerMap<Key, Tp>::find(const Key &key) const {
+    const size_t index = Probe(key);
+    return slots_[index].value_index == kEmpty ? end() : &values_[slots_[index].value_index];
+}
+
+template<typename Key, typename Tp>
+size_t FlatIntegerMap<Key, Tp>::count(const Key &key) const {
+    return find(key) == end() ? 0 : 1;
+}
+
+template<typename Key, typename Tp>
+size_t FlatIntegerMap<Key, Tp>::erase(const Key &key) {
+    size_t index = Probe(key);
+    if (slots_[index].value_index == kEmpty) {
+        return 0;
+    }
+
+    // Release the value now, the place keeps a default one until it is reused
+    const uint32_t value_index = slots_[index].value_index;
+    value_type *place = &values_[value_index];
+    place->~value_type();
+    new(place) value_type(Key(), Tp());
+    free_values_.push_back(value_index);
+    --size_;
+
+    // Backward shift: move up the following slots which are not at their home position
+    const size_t mask = slots_.size() - 1;
+    size_t next = (index + 1) & mask;
+    while (slots_[next].value_index != kEmpty) {
+        const size_t home = hash_(slots_[next].key) & mask;
+        // `next` may fill the hole if its home is not in the cyclic range (index, next]
+        if (((next - home) & mask) >= ((next - index) & mask)) {
+            slots_[index] = slots_[next];
+            index = next;
+        }
+        next = (next + 1) & mask;
+    }
+    slots_[index].value_index = kEmpty;
+    return 1;
+}
+
+template<typename Key, typename Tp>
+void FlatIntegerMap<Key, Tp>::clear() {
+    slots_.assign(16, Slot{Key(), kEmpty});
+    values_.clear();
+    free_values_.clear();
+    size_ = 0;
+}
+
+template<typename Key, typename Tp>
+MemoryUsage FlatIntegerMap<Key, Tp>::memory_usage() const {
+    MemoryUsage usage;
+    usage.keys = slots_.capacity() * sizeof(Key);
+    for (auto it = values_.begin(); it != values_.end(); ++it) {
+        usage.values += sizeof(value_type) + HeapBytes(it->second);
+    }
+    usage.overhead = sizeof(*this) + slots_.capacity() * (sizeof(Slot) - sizeof(Key)) +
+                     free_values_.capacity() * sizeof(uint32_t);
+    return usage;
+}
+
+template<typename Key, typename Tp>
+size_t FlatIntegerMap<Key, Tp>::Probe(const Key &key) const {
+    const size_t mask = slots_.size() - 1;
+    size_t index = hash_(key) & mask;
+    while (slots_[index].value_index != kEmpty && slots_[index].key != key) {
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+template<typename Key, typename Tp>
+void FlatIntegerMap<Key, Tp>::Grow() {
+    std::vector<Slot> old_slots(slots_.size() * 2, Slot{Key(), kEmpty});
+    old_slots.swap(slots_);
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = 0; i < old_slots.size(); ++i) {
+        if (old_slots[i].value_index != kEmpty) {
+            size_t index = hash_(old_slots[i].key) & mask;
+            while (slots_[index].value_index != kEmpty) {
+                index = (index + 1) & mask;
+            }
+            slots_[index] = old_slots[i];
+        }
+    }
+}
+
+template<typename Key, typename Tp>
+MemoryUsage ContainerMemoryUsage(const FlatIntegerMap<Key, Tp> &map) {
+    return map.memory_usage();
+}
+
+/**
+ *  @brief  Container of MapGetFreshTopK data (and of other per-key indexes): std::map in general, FlatIntegerMap for
+ *  fixed-width integer keys with the default comparison and allocator.
+ */
+template<typename Key, typename Tp, typename Compare, typename Alloc, typename Enable = void>
+struct MapGetFreshTopKStorage {
+    typedef std::map<Key, Tp, Compare, Alloc> type;
+};
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+struct MapGetFreshTopKStorage<Key, Tp, Compare, Alloc, typename std::enable_if<
+        IsFixedWidthIntegerKey<Key>::value && std::is_same<Compare, std::less<Key>>::value &&
+        std::is_same<Alloc, std::allocator<std::pair<const Key, Tp>>>::value>::type> {
+    typedef FlatIntegerMap<Key, Tp> type;
+};
+
+#endif //VKTEST_FLAT_INTEGER_MAP_H
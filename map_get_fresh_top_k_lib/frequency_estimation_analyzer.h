@@ -1,249 +1,1189 @@
-// FrequencyEstimationAnalyzer implementation -*- C++ -*-
-
-// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
-
-#ifndef VKTEST_FREQUENCY_ESTIMATION_ANALYZER_H
-#define VKTEST_FREQUENCY_ESTIMATION_ANALYZER_H
-
-#include <string>
-#include <map>
-#include <chrono>
-#include <cmath>
-#include <list>
-#include <vector>
-#include <utility>
-#include <algorithm>
-#include <iostream>
-#include <exception>
-
-/**
- *  @brief Duplicate key request frequency analyzer.
- *
- *  @tparam Key  Type of key objects, defaults to std::string
- *  @tparam Compare  Comparison function object type, defaults to less<Key>.
- *  @tparam Alloc  Allocator type, defaults to allocator<const Key>.
- *
- *  Analyzer supports actual statistics for the last `control_time` time. It allows implementing the "show very
- *  frequently asked keys" function. Inside of it is a lot of buckets (small analyzers) - temporary objects what are
- *  keeping statistics for all the time since creation time. The statistics from the oldest bucket is considered as
- *  "actual". Look README.md for more details.
- */
-template<typename Key = std::string, typename Compare = std::less<Key>>
-class FrequencyEstimationAnalyzer {
-public:
-    /**
-     *  @brief Duplicate key request frequency analyzer constructor.
-     *
-     *  @param control_time  Timespan, defaults to 60 seconds.
-     *  @param share_very_frequent  Share of requests for keys to be considered as "very frequent", defaults to 0.1
-     *  (10%).
-     *  @param num_buckets  Amount of buckets, defaults to 12.
-     *  @param bucket_size  Size of each bucket, defaults to 54.
-     */
-    explicit FrequencyEstimationAnalyzer(std::chrono::duration<double> control_time = std::chrono::seconds(1),
-                                         double share_very_frequent = 0.1, size_t num_buckets = 12,
-                                         size_t bucket_size = 54);
-
-    /**
-     *  @brief  Transfer information about a newly added key.
-     *  @param  key  Added a key.
-     *
-     *  Time complexity: O(1).
-     */
-    void AddKey(const Key &key);
-
-    /**
-     *  @brief  Get vector of very frequently asked keys (>= ~10%) for the last time
-     *
-     *  @param number  Number of the requested top by frequency of requests in the last period keys.
-     *  @return  Vector of very frequently asked keys for the last time.
-     *
-     *  Vector size can be different. If `number` is specified, returns min of requested in the last minute different
-     *  keys and `number`. If it is not specified, returns only keys that have been requested at >= ~10% of requests in
-     *  the last period.
-     *
-     *  E.g. if `number` is not specified and there are not a single key which has been requested at >= ~10% of requests
-     *  in the last period, then the returned vector is empty.
-     *
-     *  Time complexity: O(1).
-     */
-    std::vector<Key> GetTopKKeys(int number = 0);
-
-private:
-    /**
-     *  @brief  Handy way of keeping bucket information (instead of using std::pair/std::tuple)
-     */
-    struct BucketInfo {
-        std::chrono::system_clock::time_point created_at;
-        std::map<Key, int64_t, Compare> bucket_data;
-        int64_t add_new_key_count;
-
-        explicit BucketInfo(std::chrono::system_clock::time_point created_at);
-    };
-
-    const std::chrono::duration<double> control_time_;
-    // The oldest bucket always includes statistics for the whole control_time and a bit more,
-    // but no more than full_control_time_
-    const std::chrono::duration<double> full_control_time_;
-    const size_t buckets_count_;
-    const size_t bucket_size_;
-    const double share_very_frequent_;
-
-    void DeleteOldAddNewBuckets();
-
-    // Three functions from the article "Frequency Estimation" (look README.md)
-    inline bool IncrementCounter(std::map<Key, int64_t> &bucket_data, const Key &key);
-
-    inline bool CreateNewCounter(std::map<Key, int64_t> &bucket_data, const Key &key);
-
-    inline void DecreaseAllCounters(std::map<Key, int64_t> &bucket_data, const Key &key);
-
-    void AddKeyToBucket(BucketInfo &bucket_info, const Key &key);
-
-    void AddKeyToBuckets(const Key &key);
-
-    std::vector<std::pair<int64_t, Key>> GetBucketSortedByFrequencyKeys(std::map<Key, int64_t> &bucket_data);
-
-    std::vector<Key>
-    WeedOutExtraKeysAndInfo(const std::vector<std::pair<int64_t, Key>> &bucket_vector, int64_t n, int number = 0) const;
-
-    std::list<BucketInfo> buckets_;
-};
-
-template<typename Key, typename Compare>
-FrequencyEstimationAnalyzer<Key, Compare>::FrequencyEstimationAnalyzer(
-        const std::chrono::duration<double> control_time, const double share_very_frequent, const size_t num_buckets,
-        const size_t bucket_size)
-        : control_time_(control_time),
-          full_control_time_(control_time / num_buckets * (num_buckets + 1)),
-          buckets_count_(num_buckets + 1), bucket_size_(bucket_size),
-          share_very_frequent_(share_very_frequent),
-          buckets_() {};
-
-template<typename Key, typename Compare>
-void FrequencyEstimationAnalyzer<Key, Compare>::AddKey(const Key &key) {
-    DeleteOldAddNewBuckets();
-    AddKeyToBuckets(key);
-}
-
-template<typename Key, typename Compare>
-std::vector<Key>
-FrequencyEstimationAnalyzer<Key, Compare>::GetTopKKeys(const int number) {
-    DeleteOldAddNewBuckets();
-    const std::vector<std::pair<int64_t, Key>> very_frequent_keys =
-            GetBucketSortedByFrequencyKeys(buckets_.front().bucket_data);
-    return WeedOutExtraKeysAndInfo(very_frequent_keys, buckets_.front().add_new_key_count, number);
-}
-
-template<typename Key, typename Compare>
-void FrequencyEstimationAnalyzer<Key, Compare>::DeleteOldAddNewBuckets() {
-    const std::chrono::time_point<std::chrono::system_clock> now = std::chrono::system_clock::now();
-    while (!buckets_.empty() && now - buckets_.front().created_at > full_control_time_) {
-        buckets_.pop_front();
-    }
-
-    if (now - buckets_.back().created_at > full_control_time_ / buckets_count_) {
-        buckets_.push_back(BucketInfo(now));
-    }
-}
-
-template<typename Key, typename Compare>
-bool FrequencyEstimationAnalyzer<Key, Compare>::IncrementCounter(
-        std::map<Key, int64_t> &bucket_data, const Key &key) {
-    auto it = bucket_data.find(key);
-    if (it != bucket_data.end()) {
-        ++it->second;
-        return true;
-    }
-    return false;
-}
-
-template<typename Key, typename Compare>
-bool FrequencyEstimationAnalyzer<Key, Compare>::CreateNewCounter(
-        std::map<Key, int64_t> &bucket_data, const Key &key) {
-    if (bucket_data.size() < bucket_size_) {
-        bucket_data.emplace(key, 1);
-        return true;
-    } else {
-        for (auto it = bucket_data.begin(); it != bucket_data.end(); ++it) {
-            if (it->second == 0) {
-                bucket_data.erase(it);
-                bucket_data[key] = 1;
-                return true;
-            }
-        }
-    }
-
-    return false;
-}
-
-template<typename Key, typename Compare>
-void FrequencyEstimationAnalyzer<Key, Compare>::DecreaseAllCounters(
-        std::map<Key, int64_t> &bucket_data, const Key &key) {
-    for (auto it = bucket_data.begin(); it != bucket_data.end(); ++it) {
-        if (it->second > 0) {
-            it->second--;
-        }
-    }
-}
-
-template<typename Key, typename Compare>
-void FrequencyEstimationAnalyzer<Key, Compare>::AddKeyToBucket(
-        FrequencyEstimationAnalyzer<Key, Compare>::BucketInfo &bucket_info,
-        const Key &key) {
-    if (!IncrementCounter(bucket_info.bucket_data, key)) {
-        if (!CreateNewCounter(bucket_info.bucket_data, key)) {
-            DecreaseAllCounters(bucket_info.bucket_data, key);
-        }
-    }
-}
-
-template<typename Key, typename Compare>
-void FrequencyEstimationAnalyzer<Key, Compare>::AddKeyToBuckets(const Key &key) {
-    for (auto it = buckets_.begin(); it != buckets_.end(); ++it) {
-        it->add_new_key_count++;
-        AddKeyToBucket(*it, key);
-    }
-}
-
-template<typename Key, typename Compare>
-std::vector<std::pair<int64_t, Key>>
-FrequencyEstimationAnalyzer<Key, Compare>::GetBucketSortedByFrequencyKeys(
-        std::map<Key, int64_t> &bucket_data) {
-    std::vector<std::pair<int64_t, Key>> bucket_vector;
-    for (auto it = bucket_data.begin(); it != bucket_data.end(); ++it) {
-        bucket_vector.emplace_back(it->second, it->first);
-    }
-    std::sort(bucket_vector.begin(), bucket_vector.end(),
-              [](std::pair<int64_t, Key> &left, std::pair<int64_t, Key> &right) {
-                  return left.first > right.first;
-              });
-    return bucket_vector;
-}
-
-template<typename Key, typename Compare>
-std::vector<Key>
-FrequencyEstimationAnalyzer<Key, Compare>::WeedOutExtraKeysAndInfo(
-        const std::vector<std::pair<int64_t, Key>> &bucket_vector, int64_t n, int number) const {
-    std::vector<Key> result;
-    const double min_num = floor((double) n * share_very_frequent_) -
-                           ceil((double) n * (1 - share_very_frequent_) / (double) bucket_size_) - 2;
-    if (number == 0) {
-        for (size_t i = 0; i < bucket_vector.size() && bucket_vector[i].first >= min_num; ++i) {
-            result.push_back(bucket_vector[i].second);
-        }
-    } else {
-        for (size_t i = 0; i < bucket_vector.size() && i < number; ++i) {
-            result.push_back(bucket_vector[i].second);
-        }
-    }
-    return result;
-}
-
-template<typename Key, typename Compare>
-FrequencyEstimationAnalyzer<Key, Compare>::BucketInfo::BucketInfo(
-        std::chrono::system_clock::time_point created_at) : created_at(created_at),
-                                                            bucket_data(),
-                                                            add_new_key_count(0) {};
-
-#endif //VKTEST_FREQUENCY_ESTIMATION_ANALYZER_H
+// FrequencyEstimationAnalyzer implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_FREQUENCY_ESTIMATION_ANALYZER_H
+#define VKTEST_FREQUENCY_ESTIMATION_ANALYZER_H
+
+#include <string>
+#include <map>
+#include <limits>
+#include <cstdint>
+#include <functional>
+#include <chrono>
+#include <cmath>
+#include <list>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+
+#include "bounded_queue.h"
+#include "counter_kernels.h"
+#include "doorkeeper.h"
+#include "frequency_summary.h"
+#include "hyper_log_log.h"
+#include "integer_keys.h"
+#include "memory_usage.h"
+#include "soa_counter_bucket.h"
+
+/**
+ *  @brief  Analyzer configuration chosen by FrequencyEstimationAnalyzer::ChooseSizing.
+ */
+struct AnalyzerSizing {
+    size_t num_buckets;
+    size_t bucket_size;
+    // Estimated memory of the analyzer with this configuration
+    size_t memory_bytes;
+};
+
+/**
+ *  @brief  Change of the set of very frequent keys between two bucket rotations.
+ */
+template<typename Key>
+struct HotSetChange {
+    // Number of the rotation (look FrequencyEstimationAnalyzer::epoch)
+    uint64_t epoch;
+    std::vector<Key> entered;
+    std::vector<Key> left;
+};
+
+/**
+ *  @brief Duplicate key request frequency analyzer.
+ *
+ *  @tparam Key  Type of key objects, defaults to std::string
+ *  @tparam Compare  Comparison function object type, defaults to less<Key>.
+ *  @tparam Hash  Hash function object type for key fingerprints, defaults to DefaultKeyHash<Key>
+ *  (IntegerKeyHash for fixed-width integer keys, hash<Key> otherwise).
+ *
+ *  Analyzer supports actual statistics for the last `control_time` time. It allows implementing the "show very
+ *  frequently asked keys" function. Inside of it is a lot of buckets (small analyzers) - temporary objects what are
+ *  keeping statistics for all the time since creation time. The statistics from the oldest bucket is considered as
+ *  "actual". Look README.md for more details.
+ *
+ *  Buckets keep counters, key fingerprints and keys in separate contiguous arrays (look SoaCounterBucket), so the
+ *  passes over a bucket are SIMD scans. The key is hashed once per request for all buckets.
+ */
+template<typename Key = std::string, typename Compare = std::less<Key>, typename Hash = DefaultKeyHash<Key>>
+class FrequencyEstimationAnalyzer {
+public:
+    /**
+     *  @brief Duplicate key request frequency analyzer constructor.
+     *
+     *  @param control_time  Timespan, defaults to 60 seconds.
+     *  @param share_very_frequent  Share of requests for keys to be considered as "very frequent", defaults to 0.1
+     *  (10%).
+     *  @param num_buckets  Amount of buckets, defaults to 12.
+     *  @param bucket_size  Size of each bucket, defaults to 54.
+     */
+    explicit FrequencyEstimationAnalyzer(std::chrono::duration<double> control_time = std::chrono::seconds(1),
+                                         double share_very_frequent = 0.1, size_t num_buckets = 12,
+                                         size_t bucket_size = 54);
+
+    /**
+     *  @brief  Choose the configuration from a memory budget and the accuracy.
+     *
+     *  @param memory_budget  Maximum memory of the analyzer in bytes.
+     *  @param share_very_frequent  Share of requests for keys to be considered as "very frequent".
+     *  @param error  Maximum underestimation of a key count as a share of all requests, in (0, share).
+     *  @param key_bytes  Average memory of a key including its heap data, defaults to sizeof(Key).
+     *  @param max_num_buckets  Upper bound of num_buckets (every bucket costs CPU time per request), defaults to 12.
+     *
+     *  bucket_size = ceil((1 - share) / error), the error bound of a bucket (look README.md), num_buckets is the
+     *  largest one which fits into the budget: more buckets make the time window sharper. Throws
+     *  std::invalid_argument if the arguments are out of range or even one bucket doesn't fit.
+     */
+    static AnalyzerSizing ChooseSizing(size_t memory_budget, double share_very_frequent, double error,
+                                       size_t key_bytes = sizeof(Key), size_t max_num_buckets = 12);
+
+    /**
+     *  @brief  Estimated memory of an analyzer with the configuration, for capacity planning.
+     */
+    static size_t EstimateMemory(size_t num_buckets, size_t bucket_size, size_t key_bytes = sizeof(Key));
+
+    /**
+     *  @brief  Analyzer with the configuration chosen by ChooseSizing.
+     */
+    static FrequencyEstimationAnalyzer FromMemoryBudget(std::chrono::duration<double> control_time,
+                                                        size_t memory_budget, double share_very_frequent = 0.1,
+                                                        double error = 0.01, size_t key_bytes = sizeof(Key));
+
+    /**
+     *  @brief  Memory used by the analyzer: keys, counters with fingerprints, overhead (buckets, the epoch summary,
+     *  the doorkeeper filters). There are no values.
+     *
+     *  Time complexity: O(num_buckets * bucket_size).
+     */
+    MemoryUsage memory_usage() const;
+
+    /**
+     *  @brief  Transfer information about a newly added key.
+     *  @param  key  Added a key.
+     *  @param  weight  Weight of the request (e.g. bytes served or CPU time), defaults to 1.
+     *
+     *  With weights the "very frequent" keys are the keys with >= ~10% of the total weight of the last period, the
+     *  guarantees of the algorithm are the same with the total weight instead of the number of requests. Weights must
+     *  be positive, otherwise std::invalid_argument is thrown.
+     *
+     *  Time complexity: O(1).
+     */
+    void AddKey(const Key &key, int64_t weight = 1);
+
+    /**
+     *  @brief  AddKey with the fingerprint computed by the caller (`HashKey`), so a caller which needs the hash of
+     *  the key anyway computes it once.
+     */
+    void AddKeyWithHash(const Key &key, uint64_t fingerprint, int64_t weight = 1);
+
+    /**
+     *  @brief  AddKeyWithHash at the time `now` read by the caller, so analyzers updated together read the clock
+     *  once. `now` must not decrease between calls.
+     */
+    void AddKeyWithHash(const Key &key, uint64_t fingerprint, int64_t weight,
+                        std::chrono::system_clock::time_point now);
+
+    /**
+     *  @brief  Fingerprint of the key used by the buckets.
+     */
+    uint64_t HashKey(const Key &key) const {
+        return static_cast<uint64_t>(hash_(key));
+    }
+
+    /**
+     *  @brief  Estimated number (or weight) of requests of the key in the actual statistics, 0 for keys which are
+     *  not tracked. Used as the frequency signal of cache eviction (look TinyLfuPolicy).
+     *
+     *  Time complexity: O(bucket_size / SIMD width).
+     */
+    int64_t EstimateFrequency(const Key &key) const;
+
+    /**
+     *  @brief  Call `callback` with the change of the very frequent keys set (the `GetTopKKeys()` result).
+     *  @return  Id of the subscription for Unsubscribe.
+     *
+     *  The set is computed once per bucket rotation (when the actual statistics move on), inside the AddKey or
+     *  GetTopKKeys call which makes the rotation, and subscribers get only the keys which entered or left it.
+     *  Callbacks are called only for non-empty changes, they must not call the analyzer.
+     */
+    size_t Subscribe(std::function<void(const HotSetChange<Key> &)> callback);
+
+    /**
+     *  @brief  Push changes of the very frequent keys set to a lock-free queue, a change is dropped if the queue
+     *  is full. The queue must outlive the subscription.
+     */
+    size_t Subscribe(BoundedQueue<HotSetChange<Key>> &queue);
+
+    void Unsubscribe(size_t subscription_id);
+
+    /**
+     *  @brief  Number of bucket rotations so far. The statistics only change their "epoch" at a rotation, so caches
+     *  of `GetTopKKeys` results can be refreshed when it changes.
+     */
+    uint64_t epoch() const {
+        return epoch_;
+    }
+
+    /**
+     *  @brief  Start the epoch which has begun at `epoch_start`: drop the buckets older than the control time and
+     *  create the bucket of the epoch, as AddKey does when the epoch has passed. Nothing is done if the newest bucket
+     *  has been created at `epoch_start` or later.
+     *
+     *  After the first call only the owner rotates the buckets: AddKey and the other calls don't start epochs by
+     *  themselves. So an owner of several analyzers starts all of them at the same boundaries (look
+     *  MultiDimensionalFrequencyEstimationAnalyzer).
+     *
+     *  Time complexity: O(1) besides the work of a rotation.
+     */
+    void RotateAt(std::chrono::system_clock::time_point epoch_start);
+
+    /**
+     *  @brief  Get vector of very frequently asked keys (>= ~10%) for the last time
+     *
+     *  @param number  Number of the requested top by frequency of requests in the last period keys.
+     *  @return  Vector of very frequently asked keys for the last time.
+     *
+     *  Vector size can be different. If `number` is specified, returns min of requested in the last minute different
+     *  keys and `number`. If it is not specified, returns only keys that have been requested at >= ~10% of requests in
+     *  the last period.
+     *
+     *  E.g. if `number` is not specified and there are not a single key which has been requested at >= ~10% of requests
+     *  in the last period, then the returned vector is empty.
+     *
+     *  Time complexity: O(1).
+     */
+    std::vector<Key> GetTopKKeys(int number = 0);
+
+    /**
+     *  @brief  Summary of the actual statistics (the oldest bucket), the same data `GetTopKKeys` works with.
+     *
+     *  Summaries of many instances can be combined by FrequencySummary::Merge to get the global top.
+     *
+     *  Time complexity: O(bucket_size).
+     */
+    FrequencySummary<Key, Compare> ExportWindowSummary();
+
+    /**
+     *  @brief  Summary of the last completed epoch (requests between the two latest bucket rotations).
+     *
+     *  Epoch summaries don't overlap, so an aggregator can `Merge` them into its own analyzer as they come.
+     *
+     *  Time complexity: O(bucket_size).
+     */
+    FrequencySummary<Key, Compare> ExportEpochSummary();
+
+    /**
+     *  @brief  Keys growing fastest: the largest increases of the share of requests between the two last completed
+     *  epochs, e.g. to warm caches up before the keys become very frequent.
+     *  @param number  Maximum number of keys, 0 for all keys which have grown.
+     *
+     *  Computed once per bucket rotation from the epoch summaries. The growth of a key is ranked by its lower bound
+     *  (the counter of the last epoch minus the upper bound of the previous one, as shares of the epoch requests), so
+     *  a reported key has certainly grown, and its true growth exceeds the bound by at most the sum of the error
+     *  bounds of the epochs divided by their request counts. Empty until two epochs with requests have completed.
+     *
+     *  Time complexity: O(number).
+     */
+    std::vector<Key> GetTrending(int number = 0);
+
+    /**
+     *  @brief  Add statistics of another instance as if its requests have arrived now.
+     *  @param  summary  Summary made by ExportEpochSummary (or ExportWindowSummary) of another instance.
+     *
+     *  The summary is merged into every bucket. Error bounds of the merged buckets are tracked explicitly and used by
+     *  `GetTopKKeys`, so very frequent keys of the whole set of instances are still reported.
+     *
+     *  Time complexity: O(num_buckets * (bucket_size + m) * log(bucket_size + m)), where m - size of the summary.
+     */
+    void Merge(const FrequencySummary<Key, Compare> &summary);
+
+    /**
+     *  @brief  Ingest only a random 1 of `period` requests, each with `period` times its weight.
+     *  @param  period  Sampling period, 1 (the default) turns sampling off.
+     *
+     *  Skipped requests cost one thread-local random number, so the analyzer CPU is ~1/period of the full one.
+     *  Counters and the total count stay unbiased estimates in the scale of all requests, so thresholds need no
+     *  change, but the error is wider: an estimated count c has a standard deviation of ~sqrt(c * period) on top
+     *  of the bucket error, so keys within a few such deviations of the threshold may be missed or reported
+     *  spuriously. Don't use sampling with less than ~100 * period requests per period of time.
+     *
+     *  Turns adaptive sampling off. Throws std::logic_error for a period above 1 with exact verification.
+     */
+    void SetSamplingPeriod(int64_t period);
+
+    /**
+     *  @brief  Choose the sampling period at every bucket rotation from the request rate of the last epoch.
+     *  @param  max_updates_per_second  Desired maximum rate of ingested requests, 0 turns adaptive sampling off.
+     *
+     *  The period becomes ceil(rate / max_updates_per_second), so under low load every request is ingested.
+     *  The error bounds are the same as for SetSamplingPeriod with the current period. Throws std::logic_error for
+     *  a positive rate with exact verification.
+     */
+    void SetAdaptiveSampling(double max_updates_per_second);
+
+    /**
+     *  @brief  Let keys into the buckets only from their second request in the current or the previous epoch.
+     *  @param  expected_keys_per_epoch  Expected number of different keys per epoch (control_time / num_buckets).
+     *  @param  false_positive_rate  Share of one-hit keys let in by mistake, defaults to 0.01.
+     *
+     *  One-hit keys of long-tail traffic then never take the miss path with DecreaseAllCounters over every bucket.
+     *  All requests are still counted in the total. The first admitted request of a key also brings the weight of
+     *  the filtered one (the count correction) to the buckets which existed at that time, so counters never
+     *  overestimate. A key requested less than once per epoch, or whose filtered request the doorkeeper has
+     *  forgotten, may be underestimated by one request per two epochs. Look Doorkeeper.
+     */
+    void EnableDoorkeeper(size_t expected_keys_per_epoch, double false_positive_rate = 0.01);
+
+    void DisableDoorkeeper();
+
+    int64_t sampling_period() const {
+        return sampling_period_;
+    }
+
+    /**
+     *  @brief  Count distinct keys of the control time with HyperLogLog sketches of `precision` (look HyperLogLog).
+     *
+     *  Every epoch has its own sketch updated by the fingerprint of the request (2^precision bytes per bucket), the
+     *  sketches of the window are merged on query. One-hit keys filtered by the doorkeeper are counted, with sampling
+     *  only sampled requests are. Keys of the current epoch before the call are not counted.
+     */
+    void EnableDistinctKeysCount(size_t precision = 12);
+
+    void DisableDistinctKeysCount();
+
+    /**
+     *  @brief  Estimated number of distinct keys requested in the last control time (and a bit more, as for
+     *  GetTopKKeys), throws std::logic_error if the count is disabled.
+     *
+     *  Time complexity: O(num_buckets * 2^precision / SIMD width).
+     */
+    uint64_t GetDistinctKeysCount();
+
+    /**
+     *  @brief  Verify very frequent keys by exact counts: `GetTopKKeys()` returns only keys which certainly have
+     *  >= share_very_frequent of the requests of the actual statistics.
+     *
+     *  The counters of the buckets give a superset of the very frequent keys (the threshold is lowered by the error
+     *  bound). At every bucket rotation the keys of this superset become candidates and their requests are counted
+     *  exactly per epoch, so the cost is proportional to the number of candidates (<= 1 / share + bucket_size error
+     *  slack), not to the number of keys. A key is verified if a lower bound of its count reaches the threshold:
+     *  the exact count of the actual statistics for keys which have been candidates since the oldest bucket was
+     *  created, the counter of the oldest bucket (which never overestimates) otherwise. So a key which has just
+     *  become very frequent may be missed for a few epochs, but no key below the threshold is reported.
+     *
+     *  With merged summaries the exact counts don't cover the requests of other instances, then keys are not
+     *  verified. Sampled counters and totals are estimates, so exact verification can't be combined with sampling:
+     *  std::logic_error is thrown if sampling is on. Counters sampled before the call stay in the statistics for
+     *  the control time.
+     */
+    void EnableExactVerification();
+
+    void DisableExactVerification();
+
+    /**
+     *  @brief  Verified very frequent keys with lower bounds of their counts in the actual statistics (exact for
+     *  keys tracked over the whole window), from the most frequent. Throws std::logic_error if the verification is
+     *  disabled.
+     *
+     *  Time complexity: O(bucket_size * log(bucket_size) + candidates * num_buckets).
+     */
+    std::vector<std::pair<Key, int64_t>> GetVerifiedTopKKeys();
+
+private:
+    /**
+     *  @brief  Handy way of keeping bucket information (instead of using std::pair/std::tuple)
+     */
+    struct BucketInfo {
+        std::chrono::system_clock::time_point created_at;
+        SoaCounterBucket<Key, Compare> bucket_data;
+        int64_t add_new_key_count;
+        // Maximum underestimation of any counter: number of DecreaseAllCounters calls plus errors of merged summaries
+        int64_t error_bound;
+        bool has_merged_summaries;
+        // Keys of the epoch the bucket was the newest in, empty if the distinct keys count is disabled
+        HyperLogLog distinct_keys;
+
+        BucketInfo(std::chrono::system_clock::time_point created_at, size_t bucket_size);
+    };
+
+    const std::chrono::duration<double> control_time_;
+    // The oldest bucket always includes statistics for the whole control_time and a bit more,
+    // but no more than full_control_time_
+    const std::chrono::duration<double> full_control_time_;
+    const size_t buckets_count_;
+    const size_t bucket_size_;
+    const double share_very_frequent_;
+
+    /**
+     *  @brief  Key counted exactly by the verification.
+     */
+    struct ExactCandidate {
+        Key key;
+        // The first epoch counted from its beginning
+        uint64_t since_epoch;
+        // Counts of the last buckets_count_ epochs, the epoch e is at e % buckets_count_
+        std::vector<int64_t> epoch_counts;
+    };
+
+    void DeleteOldAddNewBuckets();
+
+    void DeleteOldAddNewBuckets(std::chrono::system_clock::time_point now);
+
+    // Create the bucket of the epoch which begins at `now`
+    void StartEpoch(std::chrono::system_clock::time_point now);
+
+    // Three functions from the article "Frequency Estimation" (look README.md)
+    // (weighted as in Misra-Gries with weights: the decrement is the weight limited by the minimum counter)
+    inline bool IncrementCounter(SoaCounterBucket<Key, Compare> &bucket_data, const Key &key, uint64_t fingerprint,
+                                 int64_t weight);
+
+    inline bool CreateNewCounter(SoaCounterBucket<Key, Compare> &bucket_data, const Key &key, uint64_t fingerprint,
+                                 int64_t weight);
+
+    // Returns the value every counter has been decreased by
+    inline int64_t DecreaseAllCounters(SoaCounterBucket<Key, Compare> &bucket_data, int64_t weight);
+
+    void AddKeyToBucket(BucketInfo &bucket_info, const Key &key, uint64_t fingerprint, int64_t weight);
+
+    // GetTopKKeys without bucket rotation
+    std::vector<Key> ActualTopKKeys(int number);
+
+    // Very frequent keys sorted by Compare
+    std::vector<Key> SortedHotKeys();
+
+    void NotifyHotSetChange();
+
+    // Keys over the threshold of the actual statistics with their counters, from the most frequent
+    std::vector<std::pair<int64_t, Key>> ActualCandidates();
+
+    // Make the keys over the threshold the candidates of the verification, starting the epoch `since_epoch`
+    void RefreshExactCandidates(uint64_t since_epoch);
+
+    std::vector<std::pair<Key, int64_t>> VerifiedKeys();
+
+    void UpdateTrendingKeys(const FrequencySummary<Key, Compare> &previous, const FrequencySummary<Key, Compare> &last);
+
+    // Counts the request for adaptive sampling, returns false if it is skipped, else scales its weight
+    inline bool SampleRequest(int64_t &weight);
+
+    void AddKeyToBuckets(const Key &key, uint64_t fingerprint, int64_t weight);
+
+    std::vector<std::pair<int64_t, Key>>
+    GetBucketSortedByFrequencyKeys(const SoaCounterBucket<Key, Compare> &bucket_data, int64_t min_count);
+
+    // Minimum counter of a key which can be very frequent
+    double MinVeryFrequentCount(int64_t n, int64_t merged_error_bound) const;
+
+    std::vector<Key>
+    WeedOutExtraKeysAndInfo(const std::vector<std::pair<int64_t, Key>> &bucket_vector, int64_t n, int number = 0,
+                            int64_t merged_error_bound = 0) const;
+
+    FrequencySummary<Key, Compare> MakeSummary(const BucketInfo &bucket_info) const;
+
+    // xorshift64*, state is per thread, so there is no contention and no locking
+    static uint64_t NextRandom();
+
+    void SetSamplingPeriodValue(int64_t period);
+
+    const Hash hash_;
+
+    int64_t sampling_period_;
+    // A request is ingested if NextRandom() < sampling_threshold_
+    uint64_t sampling_threshold_;
+    double max_updates_per_second_;
+    // All requests (ingested or not) since the last bucket rotation, for adaptive sampling
+    int64_t requests_since_rotation_;
+
+    // Filter of first requests, nullptr if it is disabled
+    std::unique_ptr<Doorkeeper> doorkeeper_;
+    // 0 if the distinct keys count is disabled
+    size_t distinct_keys_precision_;
+
+    std::list<BucketInfo> buckets_;
+    uint64_t epoch_;
+    // Epochs are started by RotateAt only
+    bool external_rotation_;
+
+    std::map<size_t, std::function<void(const HotSetChange<Key> &)>> subscribers_;
+    size_t next_subscription_id_;
+    // The set of very frequent keys at the last rotation, sorted by Compare, only kept while there are subscribers
+    std::vector<Key> hot_keys_;
+    FrequencySummary<Key, Compare> last_epoch_summary_;
+    // Keys of the last epoch which have grown since the previous one, from the fastest growing
+    std::vector<Key> trending_keys_;
+
+    bool exact_verification_;
+    // Fingerprints of candidates_ for the SIMD search
+    std::vector<uint64_t> candidate_fingerprints_;
+    std::vector<ExactCandidate> candidates_;
+};
+
+template<typename Key, typename Compare, typename Hash>
+FrequencyEstimationAnalyzer<Key, Compare, Hash>::FrequencyEstimationAnalyzer(
+        const std::chrono::duration<double> control_time, const double share_very_frequent, const size_t num_buckets,
+        const size_t bucket_size)
+        : control_time_(control_time),
+          full_control_time_(control_time / num_buckets * (num_buckets + 1)),
+          buckets_count_(num_buckets + 1), bucket_size_(bucket_size),
+          share_very_frequent_(share_very_frequent), hash_(), sampling_period_(1),
+          sampling_threshold_(UINT64_MAX), max_updates_per_second_(0), requests_since_rotation_(0),
+          doorkeeper_(), distinct_keys_precision_(0), buckets_(), epoch_(0), external_rotation_(false),
+          subscribers_(), next_subscription_id_(0), hot_keys_(),
+          last_epoch_summary_(bucket_size), trending_keys_(), exact_verification_(false), candidate_fingerprints_(),
+          candidates_() {};
+
+template<typename Key, typename Compare, typename Hash>
+AnalyzerSizing FrequencyEstimationAnalyzer<Key, Compare, Hash>::ChooseSizing(
+        const size_t memory_budget, const double share_very_frequent, const double error, const size_t key_bytes,
+        const size_t max_num_buckets) {
+    if (!(share_very_frequent > 0 && share_very_frequent < 1) || !(error > 0 && error < share_very_frequent) ||
+        max_num_buckets == 0) {
+        throw std::invalid_argument("FrequencyEstimationAnalyzer: share must be in (0, 1), error in (0, share)");
+    }
+    AnalyzerSizing sizing;
+    sizing.bucket_size = static_cast<size_t>(ceil((1 - share_very_frequent) / error));
+    sizing.num_buckets = 0;
+    sizing.memory_bytes = 0;
+    for (size_t num_buckets = 1; num_buckets <= max_num_buckets; ++num_buckets) {
+        const size_t memory_bytes = EstimateMemory(num_buckets, sizing.bucket_size, key_bytes);
+        if (memory_bytes > memory_budget) {
+            break;
+        }
+        sizing.num_buckets = num_buckets;
+        sizing.memory_bytes = memory_bytes;
+    }
+    if (sizing.num_buckets == 0) {
+        throw std::invalid_argument("FrequencyEstimationAnalyzer: memory budget is too small for the error");
+    }
+    return sizing;
+}
+
+template<typename Key, typename Compare, typename Hash>
+size_t FrequencyEstimationAnalyzer<Key, Compare, Hash>::EstimateMemory(const size_t num_buckets,
+                                                                      const size_t bucket_size,
+                                                                      const size_t key_bytes) {
+    // Counter and fingerprint arrays, keys, the bucket with its list node and the alignment of the arrays
+    const size_t bucket_bytes = bucket_size * (sizeof(int64_t) + sizeof(uint64_t) + key_bytes) +
+                                sizeof(BucketInfo) + 2 * sizeof(void *) + 2 * AlignedArray<int64_t>::kAlignment;
+    // The epoch summary is a std::map of the newest bucket counters
+    const size_t summary_bytes = bucket_size * (sizeof(std::pair<const Key, int64_t>) - sizeof(Key) + key_bytes +
+                                                memory_usage_detail::kTreeNodeOverhead);
+    return sizeof(FrequencyEstimationAnalyzer) + (num_buckets + 1) * bucket_bytes + summary_bytes;
+}
+
+template<typename Key, typename Compare, typename Hash>
+FrequencyEstimationAnalyzer<Key, Compare, Hash> FrequencyEstimationAnalyzer<Key, Compare, Hash>::FromMemoryBudget(
+        const std::chrono::duration<double> control_time, const size_t memory_budget,
+        const double share_very_frequent, const double error, const size_t key_bytes) {
+    const AnalyzerSizing sizing = ChooseSizing(memory_budget, share_very_frequent, error, key_bytes);
+    return FrequencyEstimationAnalyzer(control_time, share_very_frequent, sizing.num_buckets, sizing.bucket_size);
+}
+
+template<typename Key, typename Compare, typename Hash>
+MemoryUsage FrequencyEstimationAnalyzer<Key, Compare, Hash>::memory_usage() const {
+    MemoryUsage usage;
+    for (auto it = buckets_.begin(); it != buckets_.end(); ++it) {
+        usage += it->bucket_data.memory_usage();
+        usage.overhead += sizeof(BucketInfo) - sizeof(it->bucket_data) + 2 * sizeof(void *) +
+                          it->distinct_keys.memory_usage() - sizeof(HyperLogLog);
+    }
+
+    // Values of the summary map are counters
+    MemoryUsage summary_usage = ContainerMemoryUsage(last_epoch_summary_.counters());
+    summary_usage.counters = summary_usage.values;
+    summary_usage.values = 0;
+    usage += summary_usage;
+
+    for (size_t i = 0; i < candidates_.size(); ++i) {
+        usage.keys += sizeof(Key) + HeapBytes(candidates_[i].key);
+        usage.counters += candidates_[i].epoch_counts.capacity() * sizeof(int64_t) + sizeof(uint64_t);
+        usage.overhead += sizeof(ExactCandidate) - sizeof(Key);
+    }
+
+    for (size_t i = 0; i < trending_keys_.size(); ++i) {
+        usage.keys += sizeof(Key) + HeapBytes(trending_keys_[i]);
+    }
+
+    usage.overhead += sizeof(*this) + (doorkeeper_ ? doorkeeper_->memory_usage() : 0);
+    return usage;
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::AddKey(const Key &key, const int64_t weight) {
+    AddKeyWithHash(key, HashKey(key), weight, std::chrono::system_clock::now());
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::AddKeyWithHash(const Key &key, const uint64_t fingerprint,
+                                                                     const int64_t weight) {
+    AddKeyWithHash(key, fingerprint, weight, std::chrono::system_clock::now());
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::AddKeyWithHash(const Key &key, const uint64_t fingerprint,
+                                                                     const int64_t weight,
+                                                                     const std::chrono::system_clock::time_point now) {
+    if (weight < 1) {
+        throw std::invalid_argument("FrequencyEstimationAnalyzer: weight of a request must be positive");
+    }
+    int64_t sampled_weight = weight;
+    if (!SampleRequest(sampled_weight)) {
+        return;
+    }
+    DeleteOldAddNewBuckets(now);
+    AddKeyToBuckets(key, fingerprint, sampled_weight);
+}
+
+template<typename Key, typename Compare, typename Hash>
+int64_t FrequencyEstimationAnalyzer<Key, Compare, Hash>::EstimateFrequency(const Key &key) const {
+    if (buckets_.empty()) {
+        return 0;
+    }
+    const SoaCounterBucket<Key, Compare> &bucket_data = buckets_.front().bucket_data;
+    const size_t index = bucket_data.Find(key, static_cast<uint64_t>(hash_(key)));
+    return index == SoaCounterBucket<Key, Compare>::npos ? 0 : bucket_data.counter(index);
+}
+
+template<typename Key, typename Compare, typename Hash>
+size_t FrequencyEstimationAnalyzer<Key, Compare, Hash>::Subscribe(
+        std::function<void(const HotSetChange<Key> &)> callback) {
+    if (subscribers_.empty()) {
+        hot_keys_ = SortedHotKeys();
+    }
+    subscribers_[next_subscription_id_] = std::move(callback);
+    return next_subscription_id_++;
+}
+
+template<typename Key, typename Compare, typename Hash>
+size_t FrequencyEstimationAnalyzer<Key, Compare, Hash>::Subscribe(BoundedQueue<HotSetChange<Key>> &queue) {
+    return Subscribe([&queue](const HotSetChange<Key> &change) {
+        queue.TryPush(change);
+    });
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::Unsubscribe(const size_t subscription_id) {
+    subscribers_.erase(subscription_id);
+    if (subscribers_.empty()) {
+        hot_keys_.clear();
+    }
+}
+
+template<typename Key, typename Compare, typename Hash>
+std::vector<Key> FrequencyEstimationAnalyzer<Key, Compare, Hash>::SortedHotKeys() {
+    std::vector<Key> hot_keys;
+    if (!buckets_.empty()) {
+        hot_keys = ActualTopKKeys(0);
+        std::sort(hot_keys.begin(), hot_keys.end(), Compare());
+    }
+    return hot_keys;
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::NotifyHotSetChange() {
+    std::vector<Key> hot_keys = SortedHotKeys();
+    HotSetChange<Key> change;
+    change.epoch = epoch_;
+    std::set_difference(hot_keys.begin(), hot_keys.end(), hot_keys_.begin(), hot_keys_.end(),
+                        std::back_inserter(change.entered), Compare());
+    std::set_difference(hot_keys_.begin(), hot_keys_.end(), hot_keys.begin(), hot_keys.end(),
+                        std::back_inserter(change.left), Compare());
+    hot_keys_.swap(hot_keys);
+
+    if (change.entered.empty() && change.left.empty()) {
+        return;
+    }
+    for (auto it = subscribers_.begin(); it != subscribers_.end(); ++it) {
+        it->second(change);
+    }
+}
+
+template<typename Key, typename Compare, typename Hash>
+bool FrequencyEstimationAnalyzer<Key, Compare, Hash>::SampleRequest(int64_t &weight) {
+    ++requests_since_rotation_;
+    if (sampling_period_ > 1) {
+        if (NextRandom() >= sampling_threshold_) {
+            return false;
+        }
+        weight *= sampling_period_;
+    }
+    return true;
+}
+
+template<typename Key, typename Compare, typename Hash>
+std::vector<Key>
+FrequencyEstimationAnalyzer<Key, Compare, Hash>::GetTopKKeys(const int number) {
+    DeleteOldAddNewBuckets();
+    return ActualTopKKeys(number);
+}
+
+template<typename Key, typename Compare, typename Hash>
+std::vector<Key> FrequencyEstimationAnalyzer<Key, Compare, Hash>::ActualTopKKeys(const int number) {
+    if (number == 0 && exact_verification_) {
+        const std::vector<std::pair<Key, int64_t>> verified = VerifiedKeys();
+        std::vector<Key> result;
+        for (size_t i = 0; i < verified.size(); ++i) {
+            result.push_back(verified[i].first);
+        }
+        return result;
+    }
+    const BucketInfo &actual_bucket = buckets_.front();
+    const int64_t merged_error_bound = actual_bucket.has_merged_summaries ? actual_bucket.error_bound : 0;
+    // Without `number` only the keys over the threshold are needed, they are filtered before sorting
+    const int64_t min_count = number == 0 ? static_cast<int64_t>(
+            ceil(MinVeryFrequentCount(actual_bucket.add_new_key_count, merged_error_bound))) : 0;
+    const std::vector<std::pair<int64_t, Key>> very_frequent_keys =
+            GetBucketSortedByFrequencyKeys(actual_bucket.bucket_data, min_count);
+    return WeedOutExtraKeysAndInfo(very_frequent_keys, actual_bucket.add_new_key_count, number, merged_error_bound);
+}
+
+template<typename Key, typename Compare, typename Hash>
+FrequencySummary<Key, Compare> FrequencyEstimationAnalyzer<Key, Compare, Hash>::ExportWindowSummary() {
+    DeleteOldAddNewBuckets();
+    return MakeSummary(buckets_.front());
+}
+
+template<typename Key, typename Compare, typename Hash>
+FrequencySummary<Key, Compare> FrequencyEstimationAnalyzer<Key, Compare, Hash>::ExportEpochSummary() {
+    DeleteOldAddNewBuckets();
+    return last_epoch_summary_;
+}
+
+template<typename Key, typename Compare, typename Hash>
+std::vector<Key> FrequencyEstimationAnalyzer<Key, Compare, Hash>::GetTrending(const int number) {
+    DeleteOldAddNewBuckets();
+    if (number == 0 || static_cast<size_t>(number) >= trending_keys_.size()) {
+        return trending_keys_;
+    }
+    return std::vector<Key>(trending_keys_.begin(), trending_keys_.begin() + number);
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::Merge(const FrequencySummary<Key, Compare> &summary) {
+    DeleteOldAddNewBuckets();
+    for (auto it = buckets_.begin(); it != buckets_.end(); ++it) {
+        FrequencySummary<Key, Compare> merged(bucket_size_, it->add_new_key_count, it->error_bound,
+                                              it->bucket_data.ToMap());
+        merged.Merge(summary);
+        it->bucket_data.Assign(merged.counters(), hash_);
+        it->add_new_key_count = merged.total_count();
+        it->error_bound = merged.error_bound();
+        it->has_merged_summaries = true;
+    }
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::SetSamplingPeriod(const int64_t period) {
+    if (period < 1) {
+        throw std::invalid_argument("FrequencyEstimationAnalyzer: sampling period must be positive");
+    }
+    if (period > 1 && exact_verification_) {
+        throw std::logic_error("FrequencyEstimationAnalyzer: exact verification doesn't work with sampling");
+    }
+    max_updates_per_second_ = 0;
+    SetSamplingPeriodValue(period);
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::SetAdaptiveSampling(const double max_updates_per_second) {
+    if (max_updates_per_second < 0) {
+        throw std::invalid_argument("FrequencyEstimationAnalyzer: rate of updates must be non-negative");
+    }
+    if (max_updates_per_second > 0 && exact_verification_) {
+        throw std::logic_error("FrequencyEstimationAnalyzer: exact verification doesn't work with sampling");
+    }
+    max_updates_per_second_ = max_updates_per_second;
+    if (max_updates_per_second == 0) {
+        SetSamplingPeriodValue(1);
+    }
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::EnableDoorkeeper(const size_t expected_keys_per_epoch,
+                                                                       const double false_positive_rate) {
+    doorkeeper_.reset(new Doorkeeper(expected_keys_per_epoch, false_positive_rate));
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::DisableDoorkeeper() {
+    doorkeeper_.reset();
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::EnableDistinctKeysCount(const size_t precision) {
+    HyperLogLog sketch(precision);
+    distinct_keys_precision_ = precision;
+    for (auto it = buckets_.begin(); it != buckets_.end(); ++it) {
+        it->distinct_keys = HyperLogLog();
+    }
+    if (!buckets_.empty()) {
+        buckets_.back().distinct_keys = sketch;
+    }
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::DisableDistinctKeysCount() {
+    distinct_keys_precision_ = 0;
+    for (auto it = buckets_.begin(); it != buckets_.end(); ++it) {
+        it->distinct_keys = HyperLogLog();
+    }
+}
+
+template<typename Key, typename Compare, typename Hash>
+uint64_t FrequencyEstimationAnalyzer<Key, Compare, Hash>::GetDistinctKeysCount() {
+    if (distinct_keys_precision_ == 0) {
+        throw std::logic_error("FrequencyEstimationAnalyzer: the distinct keys count is disabled");
+    }
+    DeleteOldAddNewBuckets();
+    HyperLogLog window(distinct_keys_precision_);
+    for (auto it = buckets_.begin(); it != buckets_.end(); ++it) {
+        window.Merge(it->distinct_keys);
+    }
+    return static_cast<uint64_t>(std::llround(window.Estimate()));
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::EnableExactVerification() {
+    if (exact_verification_) {
+        return;
+    }
+    if (sampling_period_ > 1 || max_updates_per_second_ > 0) {
+        throw std::logic_error("FrequencyEstimationAnalyzer: exact verification doesn't work with sampling");
+    }
+    exact_verification_ = true;
+    // The current epoch is counted from now, so it is not complete for the candidates
+    if (!buckets_.empty()) {
+        RefreshExactCandidates(epoch_ + 1);
+    }
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::DisableExactVerification() {
+    exact_verification_ = false;
+    candidate_fingerprints_.clear();
+    candidates_.clear();
+}
+
+template<typename Key, typename Compare, typename Hash>
+std::vector<std::pair<Key, int64_t>> FrequencyEstimationAnalyzer<Key, Compare, Hash>::GetVerifiedTopKKeys() {
+    if (!exact_verification_) {
+        throw std::logic_error("FrequencyEstimationAnalyzer: the exact verification is disabled");
+    }
+    DeleteOldAddNewBuckets();
+    return VerifiedKeys();
+}
+
+template<typename Key, typename Compare, typename Hash>
+std::vector<std::pair<int64_t, Key>> FrequencyEstimationAnalyzer<Key, Compare, Hash>::ActualCandidates() {
+    const BucketInfo &actual_bucket = buckets_.front();
+    const int64_t merged_error_bound = actual_bucket.has_merged_summaries ? actual_bucket.error_bound : 0;
+    const int64_t min_count = static_cast<int64_t>(
+            ceil(MinVeryFrequentCount(actual_bucket.add_new_key_count, merged_error_bound)));
+    return GetBucketSortedByFrequencyKeys(actual_bucket.bucket_data, min_count);
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::RefreshExactCandidates(const uint64_t since_epoch) {
+    const std::vector<std::pair<int64_t, Key>> actual = ActualCandidates();
+    const Compare compare;
+    std::vector<uint64_t> fingerprints;
+    std::vector<ExactCandidate> candidates;
+    for (size_t i = 0; i < actual.size(); ++i) {
+        const Key &key = actual[i].second;
+        const uint64_t fingerprint = static_cast<uint64_t>(hash_(key));
+        ExactCandidate candidate;
+        // Candidates of the previous epochs keep their counts
+        size_t j = counter_kernels::FindFingerprint(candidate_fingerprints_.data(), candidates_.size(), fingerprint);
+        while (j < candidates_.size() && (compare(candidates_[j].key, key) || compare(key, candidates_[j].key))) {
+            j = counter_kernels::FindFingerprint(candidate_fingerprints_.data(), candidates_.size(), fingerprint,
+                                                 j + 1);
+        }
+        if (j < candidates_.size()) {
+            candidate = std::move(candidates_[j]);
+        } else {
+            candidate.key = key;
+            candidate.since_epoch = since_epoch;
+            candidate.epoch_counts.assign(buckets_count_, 0);
+        }
+        // The slot of the new epoch held the counts of an epoch out of the window
+        if (since_epoch <= epoch_) {
+            candidate.epoch_counts[epoch_ % buckets_count_] = 0;
+        }
+        fingerprints.push_back(fingerprint);
+        candidates.push_back(std::move(candidate));
+    }
+    candidate_fingerprints_.swap(fingerprints);
+    candidates_.swap(candidates);
+}
+
+template<typename Key, typename Compare, typename Hash>
+std::vector<std::pair<Key, int64_t>> FrequencyEstimationAnalyzer<Key, Compare, Hash>::VerifiedKeys() {
+    const BucketInfo &actual_bucket = buckets_.front();
+    const std::vector<std::pair<int64_t, Key>> actual = ActualCandidates();
+    std::vector<std::pair<Key, int64_t>> result;
+    if (actual_bucket.has_merged_summaries) {
+        for (size_t i = 0; i < actual.size(); ++i) {
+            result.push_back(std::make_pair(actual[i].second, actual[i].first));
+        }
+        return result;
+    }
+
+    const double threshold = (double) actual_bucket.add_new_key_count * share_very_frequent_;
+    // The actual statistics are the epochs of all buckets
+    const uint64_t first_epoch = epoch_ + 1 - buckets_.size();
+    const Compare compare;
+    for (size_t i = 0; i < actual.size(); ++i) {
+        const Key &key = actual[i].second;
+        int64_t count = actual[i].first;
+        const uint64_t fingerprint = static_cast<uint64_t>(hash_(key));
+        for (size_t j = counter_kernels::FindFingerprint(candidate_fingerprints_.data(), candidates_.size(),
+                                                         fingerprint);
+             j < candidates_.size();
+             j = counter_kernels::FindFingerprint(candidate_fingerprints_.data(), candidates_.size(), fingerprint,
+                                                  j + 1)) {
+            const ExactCandidate &candidate = candidates_[j];
+            if (compare(candidate.key, key) || compare(key, candidate.key)) {
+                continue;
+            }
+            int64_t exact = 0;
+            for (uint64_t epoch = std::max(first_epoch, candidate.since_epoch); epoch <= epoch_; ++epoch) {
+                exact += candidate.epoch_counts[epoch % buckets_count_];
+            }
+            count = candidate.since_epoch <= first_epoch ? exact : std::max(count, exact);
+            break;
+        }
+        if ((double) count >= threshold) {
+            result.push_back(std::make_pair(key, count));
+        }
+    }
+    std::stable_sort(result.begin(), result.end(),
+                     [](const std::pair<Key, int64_t> &left, const std::pair<Key, int64_t> &right) {
+                         return left.second > right.second;
+                     });
+    return result;
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::UpdateTrendingKeys(const FrequencySummary<Key, Compare> &previous,
+                                                                         const FrequencySummary<Key, Compare> &last) {
+    trending_keys_.clear();
+    if (previous.total_count() == 0 || last.total_count() == 0) {
+        return;
+    }
+    const std::map<Key, int64_t, Compare> &previous_counters = previous.counters();
+    std::vector<std::pair<double, Key>> growth;
+    for (auto it = last.counters().begin(); it != last.counters().end(); ++it) {
+        // A key missing from a summary has at most error_bound requests
+        auto previous_it = previous_counters.find(it->first);
+        const int64_t previous_upper_bound = previous.error_bound() +
+                                             (previous_it == previous_counters.end() ? 0 : previous_it->second);
+        const double lower_bound = (double) it->second / (double) last.total_count() -
+                                   (double) previous_upper_bound / (double) previous.total_count();
+        if (lower_bound > 0) {
+            growth.push_back(std::make_pair(lower_bound, it->first));
+        }
+    }
+    std::sort(growth.begin(), growth.end(),
+              [](const std::pair<double, Key> &left, const std::pair<double, Key> &right) {
+                  return left.first > right.first;
+              });
+    trending_keys_.reserve(growth.size());
+    for (size_t i = 0; i < growth.size(); ++i) {
+        trending_keys_.push_back(growth[i].second);
+    }
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::SetSamplingPeriodValue(const int64_t period) {
+    sampling_period_ = period;
+    sampling_threshold_ = period == 1 ? UINT64_MAX : UINT64_MAX / static_cast<uint64_t>(period);
+}
+
+template<typename Key, typename Compare, typename Hash>
+uint64_t FrequencyEstimationAnalyzer<Key, Compare, Hash>::NextRandom() {
+    static thread_local uint64_t state = 0;
+    if (state == 0) {
+        // Different threads and instances of the process get different sequences
+        state = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) ^
+                reinterpret_cast<uintptr_t>(&state) ^ 0x9e3779b97f4a7c15ULL;
+        state |= 1;
+    }
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dULL;
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::DeleteOldAddNewBuckets() {
+    DeleteOldAddNewBuckets(std::chrono::system_clock::now());
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::DeleteOldAddNewBuckets(
+        const std::chrono::system_clock::time_point now) {
+    if (external_rotation_) {
+        return;
+    }
+    while (!buckets_.empty() && now - buckets_.front().created_at > full_control_time_) {
+        buckets_.pop_front();
+    }
+
+    if (buckets_.empty() || now - buckets_.back().created_at > full_control_time_ / buckets_count_) {
+        StartEpoch(now);
+    }
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::RotateAt(
+        const std::chrono::system_clock::time_point epoch_start) {
+    external_rotation_ = true;
+    if (!buckets_.empty() && epoch_start <= buckets_.back().created_at) {
+        return;
+    }
+    // Buckets of aligned epochs are exactly full_control_time_ apart, so their number is bounded too
+    while (!buckets_.empty() && (buckets_.size() >= buckets_count_ ||
+                                 epoch_start - buckets_.front().created_at > full_control_time_)) {
+        buckets_.pop_front();
+    }
+    StartEpoch(epoch_start);
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::StartEpoch(const std::chrono::system_clock::time_point now) {
+    // The newest bucket was created at the beginning of the epoch that has just ended
+    if (!buckets_.empty()) {
+        FrequencySummary<Key, Compare> epoch_summary = MakeSummary(buckets_.back());
+        UpdateTrendingKeys(last_epoch_summary_, epoch_summary);
+        last_epoch_summary_ = std::move(epoch_summary);
+
+        if (max_updates_per_second_ > 0) {
+            const double epoch_seconds = std::chrono::duration<double>(now - buckets_.back().created_at).count();
+            const double rate = (double) requests_since_rotation_ / std::max(epoch_seconds, 1e-9);
+            const int64_t period = static_cast<int64_t>(ceil(rate / max_updates_per_second_));
+            SetSamplingPeriodValue(std::max<int64_t>(period, 1));
+        }
+    }
+    requests_since_rotation_ = 0;
+    if (doorkeeper_) {
+        doorkeeper_->Rotate();
+    }
+    buckets_.push_back(BucketInfo(now, bucket_size_));
+    if (distinct_keys_precision_ != 0) {
+        buckets_.back().distinct_keys = HyperLogLog(distinct_keys_precision_);
+    }
+    ++epoch_;
+    if (exact_verification_) {
+        RefreshExactCandidates(epoch_);
+    }
+    if (!subscribers_.empty()) {
+        NotifyHotSetChange();
+    }
+}
+
+template<typename Key, typename Compare, typename Hash>
+bool FrequencyEstimationAnalyzer<Key, Compare, Hash>::IncrementCounter(
+        SoaCounterBucket<Key, Compare> &bucket_data, const Key &key, const uint64_t fingerprint, const int64_t weight) {
+    const size_t index = bucket_data.Find(key, fingerprint);
+    if (index != SoaCounterBucket<Key, Compare>::npos) {
+        bucket_data.counter(index) += weight;
+        return true;
+    }
+    return false;
+}
+
+template<typename Key, typename Compare, typename Hash>
+bool FrequencyEstimationAnalyzer<Key, Compare, Hash>::CreateNewCounter(
+        SoaCounterBucket<Key, Compare> &bucket_data, const Key &key, const uint64_t fingerprint, const int64_t weight) {
+    // Takes a free place or replaces a zero counter
+    return bucket_data.TryInsert(key, fingerprint, weight) != SoaCounterBucket<Key, Compare>::npos;
+}
+
+template<typename Key, typename Compare, typename Hash>
+int64_t FrequencyEstimationAnalyzer<Key, Compare, Hash>::DecreaseAllCounters(
+        SoaCounterBucket<Key, Compare> &bucket_data, const int64_t weight) {
+    // The bucket is full of positive counters here, so a unit request doesn't need the minimum
+    if (weight == 1) {
+        bucket_data.DecrementAll();
+        return 1;
+    }
+    const int64_t decrement = std::min(weight, bucket_data.MinCounter());
+    bucket_data.SubtractAll(decrement);
+    return decrement;
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::AddKeyToBucket(
+        FrequencyEstimationAnalyzer<Key, Compare, Hash>::BucketInfo &bucket_info,
+        const Key &key, const uint64_t fingerprint, const int64_t weight) {
+    if (!IncrementCounter(bucket_info.bucket_data, key, fingerprint, weight)) {
+        if (!CreateNewCounter(bucket_info.bucket_data, key, fingerprint, weight)) {
+            const int64_t decrement = DecreaseAllCounters(bucket_info.bucket_data, weight);
+            bucket_info.error_bound += decrement;
+            // The rest of the weight takes a counter which has just become zero
+            if (decrement < weight) {
+                CreateNewCounter(bucket_info.bucket_data, key, fingerprint, weight - decrement);
+            }
+        }
+    }
+}
+
+template<typename Key, typename Compare, typename Hash>
+void FrequencyEstimationAnalyzer<Key, Compare, Hash>::AddKeyToBuckets(const Key &key, const uint64_t fingerprint,
+                                                                      const int64_t weight) {
+    if (distinct_keys_precision_ != 0) {
+        // Fingerprints of custom Hash types may be poorly mixed
+        buckets_.back().distinct_keys.Add(IntegerKeyHash<uint64_t>::Mix(fingerprint));
+    }
+    if (!candidates_.empty()) {
+        const Compare compare;
+        for (size_t i = counter_kernels::FindFingerprint(candidate_fingerprints_.data(), candidates_.size(),
+                                                         fingerprint);
+             i < candidates_.size();
+             i = counter_kernels::FindFingerprint(candidate_fingerprints_.data(), candidates_.size(), fingerprint,
+                                                  i + 1)) {
+            if (!compare(candidates_[i].key, key) && !compare(key, candidates_[i].key)) {
+                candidates_[i].epoch_counts[epoch_ % buckets_count_] += weight;
+                break;
+            }
+        }
+    }
+    int64_t correction = 0;
+    bool rejected_in_previous_epoch = false;
+    if (doorkeeper_ && !doorkeeper_->Admit(fingerprint, weight, correction, rejected_in_previous_epoch)) {
+        for (auto it = buckets_.begin(); it != buckets_.end(); ++it) {
+            it->add_new_key_count += weight;
+        }
+        return;
+    }
+
+    for (auto it = buckets_.begin(); it != buckets_.end(); ++it) {
+        it->add_new_key_count += weight;
+        // The first admission also counts the request stopped by the doorkeeper, in the buckets which existed then
+        const bool saw_rejected = !rejected_in_previous_epoch || &*it != &buckets_.back();
+        AddKeyToBucket(*it, key, fingerprint, saw_rejected ? weight + correction : weight);
+    }
+}
+
+template<typename Key, typename Compare, typename Hash>
+std::vector<std::pair<int64_t, Key>>
+FrequencyEstimationAnalyzer<Key, Compare, Hash>::GetBucketSortedByFrequencyKeys(
+        const SoaCounterBucket<Key, Compare> &bucket_data, const int64_t min_count) {
+    std::vector<std::pair<int64_t, Key>> bucket_vector;
+    bucket_data.CollectAtLeast(min_count, bucket_vector);
+    std::sort(bucket_vector.begin(), bucket_vector.end(),
+              [](const std::pair<int64_t, Key> &left, const std::pair<int64_t, Key> &right) {
+                  return left.first > right.first;
+              });
+    return bucket_vector;
+}
+
+template<typename Key, typename Compare, typename Hash>
+double FrequencyEstimationAnalyzer<Key, Compare, Hash>::MinVeryFrequentCount(
+        const int64_t n, const int64_t merged_error_bound) const {
+    // The bound from the article doesn't hold for merged buckets, their tracked error bound is used instead
+    const double error = std::max(ceil((double) n * (1 - share_very_frequent_) / (double) bucket_size_),
+                                  (double) merged_error_bound);
+    return floor((double) n * share_very_frequent_) - error - 2;
+}
+
+template<typename Key, typename Compare, typename Hash>
+std::vector<Key>
+FrequencyEstimationAnalyzer<Key, Compare, Hash>::WeedOutExtraKeysAndInfo(
+        const std::vector<std::pair<int64_t, Key>> &bucket_vector, int64_t n, int number,
+        int64_t merged_error_bound) const {
+    std::vector<Key> result;
+    const double min_num = MinVeryFrequentCount(n, merged_error_bound);
+    if (number == 0) {
+        for (size_t i = 0; i < bucket_vector.size() && bucket_vector[i].first >= min_num; ++i) {
+            result.push_back(bucket_vector[i].second);
+        }
+    } else {
+        for (size_t i = 0; i < bucket_vector.size() && i < number; ++i) {
+            result.push_back(bucket_vector[i].second);
+        }
+    }
+    return result;
+}
+
+template<typename Key, typename Compare, typename Hash>
+FrequencySummary<Key, Compare> FrequencyEstimationAnalyzer<Key, Compare, Hash>::MakeSummary(
+        const BucketInfo &bucket_info) const {
+    return FrequencySummary<Key, Compare>(bucket_size_, bucket_info.add_new_key_count, bucket_info.error_bound,
+                                          bucket_info.bucket_data.ToMap());
+}
+
+template<typename Key, typename Compare, typename Hash>
+FrequencyEstimationAnalyzer<Key, Compare, Hash>::BucketInfo::BucketInfo(
+        std::chrono::system_clock::time_point created_at, const size_t bucket_size)
+        : created_at(created_at),
+          bucket_data(bucket_size),
+          add_new_key_count(0),
+          error_bound(0),
+          has_merged_summaries(false),
+          distinct_keys() {};
+
+#endif //VKTEST_FREQUENCY_ESTIMATION_ANALYZER_H
@@ -0,0 +1,283 @@
+// FrequencySummary implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_FREQUENCY_SUMMARY_H
+#define VKTEST_FREQUENCY_SUMMARY_H
+
+#include <string>
+#include <map>
+#include <cmath>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+#include "integer_keys.h"
+
+/**
+ *  @brief Binary (de)serialization of keys for FrequencySummary.
+ *
+ *  Specialized for std::string, arithmetic types and fixed-width integer keys (128-bit ones too). Specialize it for
+ *  your own key type to make summaries with such keys serializable.
+ */
+template<typename Key, typename Enable = void>
+struct KeySerializer;
+
+namespace frequency_summary_detail {
+
+inline void WriteVarint(std::string &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+inline uint64_t ReadVarint(const std::string &in, size_t &pos) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= in.size()) {
+            throw std::invalid_argument("FrequencySummary: truncated varint");
+        }
+        const uint8_t byte = static_cast<uint8_t>(in[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw std::invalid_argument("FrequencySummary: malformed varint");
+}
+
+}
+
+template<>
+struct KeySerializer<std::string> {
+    static void Write(std::string &out, const std::string &key) {
+        frequency_summary_detail::WriteVarint(out, key.size());
+        out += key;
+    }
+
+    static std::string Read(const std::string &in, size_t &pos) {
+        const uint64_t size = frequency_summary_detail::ReadVarint(in, pos);
+        if (size > in.size() - pos) {
+            throw std::invalid_argument("FrequencySummary: truncated key");
+        }
+        std::string key = in.substr(pos, size);
+        pos += size;
+        return key;
+    }
+};
+
+template<typename Key>
+struct KeySerializer<Key, typename std::enable_if<
+        std::is_arithmetic<Key>::value || IsFixedWidthIntegerKey<Key>::value>::type> {
+    static void Write(std::string &out, const Key &key) {
+        char bytes[sizeof(Key)];
+        memcpy(bytes, &key, sizeof(Key));
+        out.append(bytes, sizeof(Key));
+    }
+
+    static Key Read(const std::string &in, size_t &pos) {
+        if (sizeof(Key) > in.size() - pos) {
+            throw std::invalid_argument("FrequencySummary: truncated key");
+        }
+        Key key;
+        memcpy(&key, in.data() + pos, sizeof(Key));
+        pos += sizeof(Key);
+        return key;
+    }
+};
+
+/**
+ *  @brief Mergeable Misra-Gries summary of a stream part (one bucket of FrequencyEstimationAnalyzer).
+ *
+ *  @tparam Key  Type of key objects, defaults to std::string
+ *  @tparam Compare  Comparison function object type, defaults to less<Key>.
+ *
+ *  Holds at most `bucket_size` counters, the number of requests `total_count` and `error_bound` - the maximum
+ *  underestimation of any counter (a key absent from the summary is considered to have counter 0). Summaries of
+ *  different instances are combined by `Merge` as described in "Mergeable Summaries" (Agarwal et al.): counters are
+ *  added up, then the (bucket_size + 1)-th largest counter is subtracted from all of them, and the error bounds are
+ *  summed up with the subtracted value. So the merged summary keeps the guarantee of the original ones: every key
+ *  requested at >= `share` of all requests has counter >= share * total_count - error_bound.
+ *
+ *  `Serialize`/`Deserialize` convert the summary to a compact binary blob (varints, keys by KeySerializer).
+ */
+template<typename Key = std::string, typename Compare = std::less<Key>>
+class FrequencySummary {
+public:
+    explicit FrequencySummary(size_t bucket_size = 54);
+
+    FrequencySummary(size_t bucket_size, int64_t total_count, int64_t error_bound,
+                     std::map<Key, int64_t, Compare> counters);
+
+    /**
+     *  @brief  Combine with the summary of another stream part.
+     *
+     *  Time complexity: O((k + m) log(k + m)), where k, m - numbers of counters of both summaries.
+     */
+    void Merge(const FrequencySummary &other);
+
+    /**
+     *  @brief  Keys which can be requested at >= `share` of requests, or `number` top keys if `number` is specified.
+     */
+    std::vector<Key> GetTopKKeys(double share = 0.1, size_t number = 0) const;
+
+    std::string Serialize() const;
+
+    /**
+     *  @brief  Restore the summary from a blob made by `Serialize`. Throws std::invalid_argument on malformed data.
+     */
+    static FrequencySummary Deserialize(const std::string &blob);
+
+    size_t bucket_size() const;
+
+    int64_t total_count() const;
+
+    int64_t error_bound() const;
+
+    const std::map<Key, int64_t, Compare> &counters() const;
+
+private:
+    static const uint32_t kMagic = 0x31534546; // "FES1"
+
+    size_t bucket_size_;
+    int64_t total_count_;
+    int64_t error_bound_;
+    std::map<Key, int64_t, Compare> counters_;
+};
+
+template<typename Key, typename Compare>
+const uint32_t FrequencySummary<Key, Compare>::kMagic;
+
+template<typename Key, typename Compare>
+FrequencySummary<Key, Compare>::FrequencySummary(const size_t bucket_size)
+        : bucket_size_(bucket_size), total_count_(0), error_bound_(0), counters_() {};
+
+template<typename Key, typename Compare>
+FrequencySummary<Key, Compare>::FrequencySummary(const size_t bucket_size, const int64_t total_count,
+                                                 const int64_t error_bound, std::map<Key, int64_t, Compare> counters)
+        : bucket_size_(bucket_size), total_count_(total_count), error_bound_(error_bound),
+          counters_(std::move(counters)) {};
+
+template<typename Key, typename Compare>
+void FrequencySummary<Key, Compare>::Merge(const FrequencySummary &other) {
+    for (auto it = other.counters_.begin(); it != other.counters_.end(); ++it) {
+        counters_[it->first] += it->second;
+    }
+    total_count_ += other.total_count_;
+    error_bound_ += other.error_bound_;
+
+    if (counters_.size() > bucket_size_) {
+        std::vector<int64_t> values;
+        values.reserve(counters_.size());
+        for (auto it = counters_.begin(); it != counters_.end(); ++it) {
+            values.push_back(it->second);
+        }
+        std::nth_element(values.begin(), values.begin() + bucket_size_, values.end(), std::greater<int64_t>());
+        const int64_t cut = values[bucket_size_];
+
+        for (auto it = counters_.begin(); it != counters_.end();) {
+            it->second -= cut;
+            if (it->second <= 0) {
+                it = counters_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        error_bound_ += cut;
+    }
+}
+
+template<typename Key, typename Compare>
+std::vector<Key> FrequencySummary<Key, Compare>::GetTopKKeys(const double share, const size_t number) const {
+    std::vector<std::pair<int64_t, Key>> sorted;
+    sorted.reserve(counters_.size());
+    for (auto it = counters_.begin(); it != counters_.end(); ++it) {
+        sorted.emplace_back(it->second, it->first);
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const std::pair<int64_t, Key> &left, const std::pair<int64_t, Key> &right) {
+                  return left.first > right.first;
+              });
+
+    std::vector<Key> result;
+    const double min_num = floor((double) total_count_ * share) - (double) error_bound_;
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        if (number == 0 ? sorted[i].first < min_num : i >= number) {
+            break;
+        }
+        result.push_back(sorted[i].second);
+    }
+    return result;
+}
+
+template<typename Key, typename Compare>
+std::string FrequencySummary<Key, Compare>::Serialize() const {
+    using frequency_summary_detail::WriteVarint;
+
+    std::string blob;
+    WriteVarint(blob, kMagic);
+    WriteVarint(blob, bucket_size_);
+    WriteVarint(blob, static_cast<uint64_t>(total_count_));
+    WriteVarint(blob, static_cast<uint64_t>(error_bound_));
+    WriteVarint(blob, counters_.size());
+    for (auto it = counters_.begin(); it != counters_.end(); ++it) {
+        KeySerializer<Key>::Write(blob, it->first);
+        WriteVarint(blob, static_cast<uint64_t>(it->second));
+    }
+    return blob;
+}
+
+template<typename Key, typename Compare>
+FrequencySummary<Key, Compare> FrequencySummary<Key, Compare>::Deserialize(const std::string &blob) {
+    using frequency_summary_detail::ReadVarint;
+
+    size_t pos = 0;
+    if (ReadVarint(blob, pos) != kMagic) {
+        throw std::invalid_argument("FrequencySummary: bad magic");
+    }
+    const size_t bucket_size = ReadVarint(blob, pos);
+    const int64_t total_count = static_cast<int64_t>(ReadVarint(blob, pos));
+    const int64_t error_bound = static_cast<int64_t>(ReadVarint(blob, pos));
+    const uint64_t size = ReadVarint(blob, pos);
+    if (size > blob.size() - pos) {
+        throw std::invalid_argument("FrequencySummary: bad number of counters");
+    }
+
+    std::map<Key, int64_t, Compare> counters;
+    for (uint64_t i = 0; i < size; ++i) {
+        Key key = KeySerializer<Key>::Read(blob, pos);
+        counters[key] = static_cast<int64_t>(ReadVarint(blob, pos));
+    }
+    if (pos != blob.size()) {
+        throw std::invalid_argument("FrequencySummary: trailing bytes");
+    }
+    return FrequencySummary(bucket_size, total_count, error_bound, std::move(counters));
+}
+
+template<typename Key, typename Compare>
+size_t FrequencySummary<Key, Compare>::bucket_size() const {
+    return bucket_size_;
+}
+
+template<typename Key, typename Compare>
+int64_t FrequencySummary<Key, Compare>::total_count() const {
+    return total_count_;
+}
+
+template<typename Key, typename Compare>
+int64_t FrequencySummary<Key, Compare>::error_bound() const {
+    return error_bound_;
+}
+
+template<typename Key, typename Compare>
+const std::map<Key, int64_t, Compare> &FrequencySummary<Key, Compare>::counters() const {
+    return counters_;
+}
+
+#endif //VKTEST_FREQUENCY_SUMMARY_H
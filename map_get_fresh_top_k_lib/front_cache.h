@@ -0,0 +1,105 @@
+// FrontCache implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_FRONT_CACHE_H
+#define VKTEST_FRONT_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "counter_kernels.h"
+
+/**
+ *  @brief Tiny table of pointers to the values of the hottest keys.
+ *
+ *  @tparam Key  Type of key objects.
+ *  @tparam Tp  Type of mapped objects.
+ *  @tparam Compare  Comparison function object type, keys are equal if neither is less than the other.
+ *  @tparam Capacity  Maximum number of keys, defaults to 16 (with the 10% share there are at most 10 very frequent
+ *  keys).
+ *
+ *  Fingerprints are packed into cache lines and scanned by counter_kernels::FindFingerprint, the key itself is
+ *  compared only on a fingerprint match. The owner fills the table from the analyzer top and must `Erase` a key
+ *  (or `Clear` the table) before the pointed value is destroyed.
+ */
+template<typename Key, typename Tp, typename Compare = std::less<Key>, size_t Capacity = 16>
+class FrontCache {
+public:
+    FrontCache() : size_(0) {};
+
+    /**
+     *  @brief  Pointer to the value of `key`, nullptr if the key is not in the table.
+     *
+     *  Time complexity: O(Capacity / SIMD width).
+     */
+    Tp *Find(const Key &key, uint64_t fingerprint) const;
+
+    /**
+     *  @brief  Add a key, returns false if the table is full.
+     */
+    bool Insert(const Key &key, uint64_t fingerprint, Tp *value);
+
+    void Erase(const Key &key, uint64_t fingerprint);
+
+    void Clear() {
+        size_ = 0;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    static constexpr size_t capacity() {
+        return Capacity;
+    }
+
+private:
+    alignas(64) uint64_t fingerprints_[Capacity];
+    Tp *values_[Capacity];
+    Key keys_[Capacity];
+    size_t size_;
+};
+
+template<typename Key, typename Tp, typename Compare, size_t Capacity>
+Tp *FrontCache<Key, Tp, Compare, Capacity>::Find(const Key &key, const uint64_t fingerprint) const {
+    const Compare compare;
+    for (size_t i = counter_kernels::FindFingerprint(fingerprints_, size_, fingerprint);
+         i < size_; i = counter_kernels::FindFingerprint(fingerprints_, size_, fingerprint, i + 1)) {
+        if (!compare(keys_[i], key) && !compare(key, keys_[i])) {
+            return values_[i];
+        }
+    }
+    return nullptr;
+}
+
+template<typename Key, typename Tp, typename Compare, size_t Capacity>
+bool FrontCache<Key, Tp, Compare, Capacity>::Insert(const Key &key, const uint64_t fingerprint, Tp *value) {
+    if (size_ == Capacity) {
+        return false;
+    }
+    fingerprints_[size_] = fingerprint;
+    values_[size_] = value;
+    keys_[size_] = key;
+    ++size_;
+    return true;
+}
+
+template<typename Key, typename Tp, typename Compare, size_t Capacity>
+void FrontCache<Key, Tp, Compare, Capacity>::Erase(const Key &key, const uint64_t fingerprint) {
+    const Compare compare;
+    for (size_t i = counter_kernels::FindFingerprint(fingerprints_, size_, fingerprint);
+         i < size_; i = counter_kernels::FindFingerprint(fingerprints_, size_, fingerprint, i + 1)) {
+        if (!compare(keys_[i], key) && !compare(key, keys_[i])) {
+            // The last entry takes the place of the erased one
+            --size_;
+            fingerprints_[i] = fingerprints_[size_];
+            values_[i] = values_[size_];
+            keys_[i] = keys_[size_];
+            return;
+        }
+    }
+}
+
+#endif //VKTEST_FRONT_CACHE_H
@@ -0,0 +1,213 @@
+// HierarchicalFrequencyEstimationAnalyzer implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_HIERARCHICAL_FREQUENCY_ESTIMATION_ANALYZER_H
+#define VKTEST_HIERARCHICAL_FREQUENCY_ESTIMATION_ANALYZER_H
+
+#include <string>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+
+#include "frequency_estimation_analyzer.h"
+#include "integer_keys.h"
+#include "memory_usage.h"
+
+/**
+ *  @brief  FNV-1a hash of strings which can be computed for all prefixes in one pass: the state after n characters
+ *  gives the hash of the first n characters.
+ */
+struct PrefixHash {
+    static uint64_t Begin() {
+        return 14695981039346656037ULL;
+    }
+
+    static uint64_t Update(const uint64_t state, const char c) {
+        return (state ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+    }
+
+    // FNV-1a has weak low bits, the buckets compare whole fingerprints, so they are mixed
+    static uint64_t Finalize(const uint64_t state) {
+        return IntegerKeyHash<uint64_t>::Mix(state);
+    }
+
+    size_t operator()(const std::string &key) const {
+        uint64_t state = Begin();
+        for (size_t i = 0; i < key.size(); ++i) {
+            state = Update(state, key[i]);
+        }
+        return static_cast<size_t>(Finalize(state));
+    }
+};
+
+/**
+ *  @brief Hierarchical heavy hitters: very frequent prefixes of string keys (e.g. "/api/v2/user/" of URLs).
+ *
+ *  A prefix can be requested in >= ~10% of requests even if none of its keys is. Every level of the hierarchy is a
+ *  FrequencyEstimationAnalyzer of prefixes: the prefix of a key at a level is the key up to the n-th delimiter
+ *  (including it) or the first n characters, the last level is the whole key. A key which is shorter than the level
+ *  is its own prefix, so every level counts every request and shares are of all requests.
+ *
+ *  `AddKey` hashes the key once: the rolling PrefixHash state gives fingerprints of all prefixes, and the clock is
+ *  read once for all levels. Prefixes are nested, so they are built by appending to one reused buffer and a request
+ *  allocates nothing for them. What remains is one pass over the key plus one analyzer update per level: a request
+ *  costs about as much as `levels_count()` requests to a single FrequencyEstimationAnalyzer.
+ */
+class HierarchicalFrequencyEstimationAnalyzer {
+public:
+    typedef FrequencyEstimationAnalyzer<std::string, std::less<std::string>, PrefixHash> LevelAnalyzer;
+
+    /**
+     *  @brief Analyzer of prefixes ending with a delimiter.
+     *
+     *  @param delimiter  Prefixes end with it, e.g. '/' for URLs or ' ' for search queries.
+     *  @param max_depth  Number of prefix levels: the prefixes up to the 1st, ..., `max_depth`-th delimiter.
+     *  @param control_time, share_very_frequent, num_buckets, bucket_size  Configuration of every level (look
+     *  FrequencyEstimationAnalyzer).
+     */
+    HierarchicalFrequencyEstimationAnalyzer(char delimiter, size_t max_depth,
+                                            std::chrono::duration<double> control_time = std::chrono::seconds(60),
+                                            double share_very_frequent = 0.1, size_t num_buckets = 12,
+                                            size_t bucket_size = 54);
+
+    /**
+     *  @brief Analyzer of fixed-length prefixes.
+     *
+     *  @param prefix_lengths  Lengths of prefixes of the levels, increasing.
+     */
+    explicit HierarchicalFrequencyEstimationAnalyzer(const std::vector<size_t> &prefix_lengths,
+                                                     std::chrono::duration<double> control_time =
+                                                     std::chrono::seconds(60),
+                                                     double share_very_frequent = 0.1, size_t num_buckets = 12,
+                                                     size_t bucket_size = 54);
+
+    /**
+     *  @brief  Transfer information about a newly added key to all levels.
+     *
+     *  Time complexity: O(key length + number of levels).
+     */
+    void AddKey(const std::string &key, int64_t weight = 1);
+
+    /**
+     *  @brief  Very frequent prefixes of a level, look FrequencyEstimationAnalyzer::GetTopKKeys.
+     *  @param  level  From 0 (the shortest prefixes) to levels_count() - 1 (whole keys).
+     */
+    std::vector<std::string> GetTopKKeys(size_t level, int number = 0);
+
+    /**
+     *  @brief  Very frequent prefixes of all levels from the shortest ones, each prefix once.
+     */
+    std::vector<std::string> GetHotPrefixes();
+
+    size_t levels_count() const {
+        return levels_.size();
+    }
+
+    MemoryUsage memory_usage() const;
+
+private:
+    void CreateLevels(size_t count, std::chrono::duration<double> control_time, double share_very_frequent,
+                      size_t num_buckets, size_t bucket_size);
+
+    // Prefixes end at delimiters if `prefix_lengths_` is empty
+    const char delimiter_;
+    const std::vector<size_t> prefix_lengths_;
+    std::vector<LevelAnalyzer> levels_;
+    // Prefix of the current key passed to the levels, its capacity is reused by the next keys
+    std::string prefix_;
+};
+
+inline HierarchicalFrequencyEstimationAnalyzer::HierarchicalFrequencyEstimationAnalyzer(
+        const char delimiter, const size_t max_depth, const std::chrono::duration<double> control_time,
+        const double share_very_frequent, const size_t num_buckets, const size_t bucket_size)
+        : delimiter_(delimiter), prefix_lengths_(), levels_(), prefix_() {
+    if (max_depth == 0) {
+        throw std::invalid_argument("HierarchicalFrequencyEstimationAnalyzer: max depth must be positive");
+    }
+    CreateLevels(max_depth + 1, control_time, share_very_frequent, num_buckets, bucket_size);
+}
+
+inline HierarchicalFrequencyEstimationAnalyzer::HierarchicalFrequencyEstimationAnalyzer(
+        const std::vector<size_t> &prefix_lengths, const std::chrono::duration<double> control_time,
+        const double share_very_frequent, const size_t num_buckets, const size_t bucket_size)
+        : delimiter_('\0'), prefix_lengths_(prefix_lengths), levels_(), prefix_() {
+    if (prefix_lengths.empty() || prefix_lengths.front() == 0 ||
+        std::adjacent_find(prefix_lengths.begin(), prefix_lengths.end(), std::greater_equal<size_t>()) !=
+        prefix_lengths.end()) {
+        throw std::invalid_argument("HierarchicalFrequencyEstimationAnalyzer: prefix lengths must increase from 1");
+    }
+    CreateLevels(prefix_lengths.size() + 1, control_time, share_very_frequent, num_buckets, bucket_size);
+}
+
+inline void HierarchicalFrequencyEstimationAnalyzer::AddKey(const std::string &key, const int64_t weight) {
+    if (weight < 1) {
+        throw std::invalid_argument("HierarchicalFrequencyEstimationAnalyzer: weight of a request must be positive");
+    }
+    const std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+    const size_t prefix_levels = levels_.size() - 1;
+    size_t level = 0;
+    uint64_t state = PrefixHash::Begin();
+    prefix_.clear();
+    for (size_t i = 0; i < key.size(); ++i) {
+        state = PrefixHash::Update(state, key[i]);
+        if (level == prefix_levels) {
+            continue;
+        }
+        const bool prefix_end = prefix_lengths_.empty() ? key[i] == delimiter_ : i + 1 == prefix_lengths_[level];
+        if (prefix_end && i + 1 < key.size()) {
+            prefix_.append(key, prefix_.size(), i + 1 - prefix_.size());
+            levels_[level].AddKeyWithHash(prefix_, PrefixHash::Finalize(state), weight, now);
+            ++level;
+        }
+    }
+    // The key is its own prefix at the remaining levels
+    const uint64_t fingerprint = PrefixHash::Finalize(state);
+    for (; level < levels_.size(); ++level) {
+        levels_[level].AddKeyWithHash(key, fingerprint, weight, now);
+    }
+}
+
+inline std::vector<std::string> HierarchicalFrequencyEstimationAnalyzer::GetTopKKeys(const size_t level,
+                                                                                     const int number) {
+    if (level >= levels_.size()) {
+        throw std::invalid_argument("HierarchicalFrequencyEstimationAnalyzer: no such level");
+    }
+    return levels_[level].GetTopKKeys(number);
+}
+
+inline std::vector<std::string> HierarchicalFrequencyEstimationAnalyzer::GetHotPrefixes() {
+    std::vector<std::string> prefixes;
+    for (size_t level = 0; level < levels_.size(); ++level) {
+        const std::vector<std::string> level_prefixes = levels_[level].GetTopKKeys();
+        for (size_t i = 0; i < level_prefixes.size(); ++i) {
+            if (std::find(prefixes.begin(), prefixes.end(), level_prefixes[i]) == prefixes.end()) {
+                prefixes.push_back(level_prefixes[i]);
+            }
+        }
+    }
+    return prefixes;
+}
+
+inline MemoryUsage HierarchicalFrequencyEstimationAnalyzer::memory_usage() const {
+    MemoryUsage usage;
+    for (size_t level = 0; level < levels_.size(); ++level) {
+        usage += levels_[level].memory_usage();
+    }
+    usage.overhead += sizeof(*this) + prefix_lengths_.capacity() * sizeof(size_t) + prefix_.capacity();
+    return usage;
+}
+
+inline void HierarchicalFrequencyEstimationAnalyzer::CreateLevels(
+        const size_t count, const std::chrono::duration<double> control_time, const double share_very_frequent,
+        const size_t num_buckets, const size_t bucket_size) {
+    levels_.reserve(count);
+    for (size_t level = 0; level < count; ++level) {
+        levels_.push_back(LevelAnalyzer(control_time, share_very_frequent, num_buckets, bucket_size));
+    }
+}
+
+#endif //VKTEST_HIERARCHICAL_FREQUENCY_ESTIMATION_ANALYZER_H
@@ -0,0 +1,159 @@
+// HotKeyAdmissionController implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_HOT_KEY_ADMISSION_CONTROLLER_H
+#define VKTEST_HOT_KEY_ADMISSION_CONTROLLER_H
+
+#include <chrono>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+
+#include "counter_kernels.h"
+
+/**
+ *  @brief Rate limiter of the very frequent keys: a token bucket per hot key, other keys are always admitted.
+ *
+ *  @tparam Key  Type of key objects.
+ *  @tparam Compare  Comparison function object type, keys are equal if neither is less than the other.
+ *  @tparam Capacity  Maximum number of hot keys, defaults to 16 (as FrontCache).
+ *
+ *  The owner assigns the hot set (the analyzer top) at every bucket rotation. A request of a key out of the hot set
+ *  costs one scan of the fingerprint table (counter_kernels::FindFingerprint), a hot key takes a token of its
+ *  bucket: buckets are refilled at `max_requests_per_second` up to `burst` tokens. Keys which stay hot keep their
+ *  buckets across assignments, a new hot key starts with a full bucket.
+ */
+template<typename Key, typename Compare = std::less<Key>, size_t Capacity = 16>
+class HotKeyAdmissionController {
+public:
+    /**
+     *  @param max_requests_per_second  Rate of requests admitted for every hot key.
+     *  @param burst  Maximum number of tokens of a bucket, defaults to the rate (one second of requests).
+     */
+    explicit HotKeyAdmissionController(double max_requests_per_second, double burst = 0);
+
+    /**
+     *  @brief  Take tokens for a request of `key` of `weight`, false if the key is hot and over its rate.
+     *
+     *  Time complexity: O(Capacity / SIMD width).
+     */
+    bool Admit(const Key &key, uint64_t fingerprint, int64_t weight = 1,
+               std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+    /**
+     *  @brief  Replace the hot set with `keys` (at most Capacity first ones).
+     *
+     *  Time complexity: O(Capacity^2 / SIMD width).
+     */
+    void Assign(const std::vector<Key> &keys, const std::vector<uint64_t> &fingerprints,
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+    size_t size() const {
+        return size_;
+    }
+
+    /**
+     *  @brief  Number of requests refused so far.
+     */
+    uint64_t throttled_count() const {
+        return throttled_count_;
+    }
+
+    size_t memory_usage() const {
+        return sizeof(*this);
+    }
+
+private:
+    struct TokenBucket {
+        double tokens;
+        std::chrono::steady_clock::time_point refilled_at;
+    };
+
+    size_t Find(const Key &key, uint64_t fingerprint) const;
+
+    const double max_requests_per_second_;
+    const double burst_;
+
+    // Allocated by new, which doesn't over-align objects in C++11
+    uint64_t fingerprints_[Capacity];
+    Key keys_[Capacity];
+    TokenBucket buckets_[Capacity];
+    size_t size_;
+    uint64_t throttled_count_;
+};
+
+template<typename Key, typename Compare, size_t Capacity>
+HotKeyAdmissionController<Key, Compare, Capacity>::HotKeyAdmissionController(const double max_requests_per_second,
+                                                                             const double burst)
+        : max_requests_per_second_(max_requests_per_second), burst_(burst > 0 ? burst : max_requests_per_second),
+          size_(0), throttled_count_(0) {
+    if (!(max_requests_per_second > 0) || burst_ < 1) {
+        throw std::invalid_argument("HotKeyAdmissionController: rate must be positive and burst at least 1");
+    }
+}
+
+template<typename Key, typename Compare, size_t Capacity>
+bool HotKeyAdmissionController<Key, Compare, Capacity>::Admit(const Key &key, const uint64_t fingerprint,
+                                                              const int64_t weight,
+                                                              const std::chrono::steady_clock::time_point now) {
+    const size_t index = Find(key, fingerprint);
+    if (index == size_) {
+        return true;
+    }
+    TokenBucket &bucket = buckets_[index];
+    const double elapsed = std::chrono::duration<double>(now - bucket.refilled_at).count();
+    if (elapsed > 0) {
+        bucket.tokens = std::min(burst_, bucket.tokens + elapsed * max_requests_per_second_);
+        bucket.refilled_at = now;
+    }
+    if (bucket.tokens < (double) weight) {
+        ++throttled_count_;
+        return false;
+    }
+    bucket.tokens -= (double) weight;
+    return true;
+}
+
+template<typename Key, typename Compare, size_t Capacity>
+void HotKeyAdmissionController<Key, Compare, Capacity>::Assign(const std::vector<Key> &keys,
+                                                               const std::vector<uint64_t> &fingerprints,
+                                                               const std::chrono::steady_clock::time_point now) {
+    if (keys.size() != fingerprints.size()) {
+        throw std::invalid_argument("HotKeyAdmissionController: keys and fingerprints must be of the same size");
+    }
+    const size_t size = std::min(keys.size(), Capacity);
+    TokenBucket buckets[Capacity];
+    for (size_t i = 0; i < size; ++i) {
+        const size_t index = Find(keys[i], fingerprints[i]);
+        if (index != size_) {
+            buckets[i] = buckets_[index];
+        } else {
+            buckets[i].tokens = burst_;
+            buckets[i].refilled_at = now;
+        }
+    }
+    for (size_t i = 0; i < size; ++i) {
+        fingerprints_[i] = fingerprints[i];
+        keys_[i] = keys[i];
+        buckets_[i] = buckets[i];
+    }
+    size_ = size;
+}
+
+template<typename Key, typename Compare, size_t Capacity>
+size_t HotKeyAdmissionController<Key, Compare, Capacity>::Find(const Key &key, const uint64_t fingerprint) const {
+    const Compare compare;
+    for (size_t i = counter_kernels::FindFingerprint(fingerprints_, size_, fingerprint);
+         i < size_; i = counter_kernels::FindFingerprint(fingerprints_, size_, fingerprint, i + 1)) {
+        if (!compare(keys_[i], key) && !compare(key, keys_[i])) {
+            return i;
+        }
+    }
+    return size_;
+}
+
+#endif //VKTEST_HOT_KEY_ADMISSION_CONTROLLER_H
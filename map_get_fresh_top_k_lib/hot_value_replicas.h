@@ -0,0 +1,210 @@
+// HotValueReplicas implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_HOT_VALUE_REPLICAS_H
+#define VKTEST_HOT_VALUE_REPLICAS_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+
+#include <sched.h>
+
+#include "counter_kernels.h"
+
+/**
+ *  @brief Copies of the values of the hottest keys, one copy per CPU core.
+ *
+ *  @tparam Key  Type of key objects.
+ *  @tparam Tp  Type of mapped objects, copy assignable.
+ *  @tparam Compare  Comparison function object type, keys are equal if neither is less than the other.
+ *  @tparam Capacity  Maximum number of keys, defaults to 16 (as FrontCache).
+ *
+ *  A key requested by every core makes its value cache line bounce between the cores. Here every replica has its
+ *  own cache lines and spin lock, a reader takes the replica of the core it runs on (sched_getcpu), so reads of the
+ *  hottest keys stay core-local and the lock is practically never contended. Writers update every replica.
+ *
+ *  `Read` may be called from any threads at any time, writers (`Assign`, `Update`, `Erase`) must be serialized.
+ */
+template<typename Key, typename Tp, typename Compare = std::less<Key>, size_t Capacity = 16>
+class HotValueReplicas {
+public:
+    /**
+     *  @param replicas_count  Number of copies, defaults to the number of hardware threads.
+     */
+    explicit HotValueReplicas(size_t replicas_count = 0);
+
+    /**
+     *  @brief  Copy the value of `key` to `value` from the replica of the current core, false if the key is not
+     *  replicated.
+     *
+     *  Time complexity: O(Capacity / SIMD width) plus the copy of the value.
+     */
+    bool Read(const Key &key, uint64_t fingerprint, Tp &value) const;
+
+    /**
+     *  @brief  Replace the replicated keys with `keys` (at most Capacity first ones).
+     *
+     *  Time complexity: O(replicas_count * Capacity).
+     */
+    void Assign(const std::vector<Key> &keys, const std::vector<uint64_t> &fingerprints,
+                const std::vector<const Tp *> &values);
+
+    /**
+     *  @brief  Change the value of a replicated key in every replica, nothing happens for other keys.
+     */
+    void Update(const Key &key, uint64_t fingerprint, const Tp &value);
+
+    void Erase(const Key &key, uint64_t fingerprint);
+
+    size_t replicas_count() const {
+        return replicas_count_;
+    }
+
+    size_t memory_usage() const {
+        return sizeof(*this) + replicas_count_ * sizeof(Replica);
+    }
+
+private:
+    struct Replica {
+        mutable std::atomic_flag lock;
+        size_t size;
+        uint64_t fingerprints[Capacity];
+        Key keys[Capacity];
+        Tp values[Capacity];
+        // The next replica starts in another cache line
+        char padding[64];
+
+        Replica() : size(0) {
+            lock.clear();
+        }
+
+        size_t Find(const Key &key, uint64_t fingerprint) const;
+    };
+
+    // Guards a replica for the lifetime of the object
+    class ReplicaLock {
+    public:
+        explicit ReplicaLock(const Replica &replica) : replica_(replica) {
+            while (replica_.lock.test_and_set(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+        }
+
+        ~ReplicaLock() {
+            replica_.lock.clear(std::memory_order_release);
+        }
+
+    private:
+        const Replica &replica_;
+    };
+
+    const Replica &LocalReplica() const;
+
+    const size_t replicas_count_;
+    std::unique_ptr<Replica[]> replicas_;
+};
+
+template<typename Key, typename Tp, typename Compare, size_t Capacity>
+HotValueReplicas<Key, Tp, Compare, Capacity>::HotValueReplicas(const size_t replicas_count)
+        : replicas_count_(replicas_count != 0 ? replicas_count
+                                              : std::max<size_t>(1, std::thread::hardware_concurrency())),
+          replicas_(new Replica[replicas_count_]) {
+}
+
+template<typename Key, typename Tp, typename Compare, size_t Capacity>
+bool HotValueReplicas<Key, Tp, Compare, Capacity>::Read(const Key &key, const uint64_t fingerprint,
+                                                        Tp &value) const {
+    const Replica &replica = LocalReplica();
+    ReplicaLock lock(replica);
+    const size_t index = replica.Find(key, fingerprint);
+    if (index == replica.size) {
+        return false;
+    }
+    value = replica.values[index];
+    return true;
+}
+
+template<typename Key, typename Tp, typename Compare, size_t Capacity>
+void HotValueReplicas<Key, Tp, Compare, Capacity>::Assign(const std::vector<Key> &keys,
+                                                          const std::vector<uint64_t> &fingerprints,
+                                                          const std::vector<const Tp *> &values) {
+    if (keys.size() != fingerprints.size() || keys.size() != values.size()) {
+        throw std::invalid_argument("HotValueReplicas: keys, fingerprints and values must be of the same size");
+    }
+    const size_t size = std::min(keys.size(), Capacity);
+    for (size_t r = 0; r < replicas_count_; ++r) {
+        Replica &replica = replicas_[r];
+        ReplicaLock lock(replica);
+        for (size_t i = 0; i < size; ++i) {
+            replica.fingerprints[i] = fingerprints[i];
+            replica.keys[i] = keys[i];
+            replica.values[i] = *values[i];
+        }
+        replica.size = size;
+    }
+}
+
+template<typename Key, typename Tp, typename Compare, size_t Capacity>
+void HotValueReplicas<Key, Tp, Compare, Capacity>::Update(const Key &key, const uint64_t fingerprint,
+                                                          const Tp &value) {
+    for (size_t r = 0; r < replicas_count_; ++r) {
+        Replica &replica = replicas_[r];
+        ReplicaLock lock(replica);
+        const size_t index = replica.Find(key, fingerprint);
+        if (index == replica.size) {
+            // Every replica has the same keys
+            return;
+        }
+        replica.values[index] = value;
+    }
+}
+
+template<typename Key, typename Tp, typename Compare, size_t Capacity>
+void HotValueReplicas<Key, Tp, Compare, Capacity>::Erase(const Key &key, const uint64_t fingerprint) {
+    for (size_t r = 0; r < replicas_count_; ++r) {
+        Replica &replica = replicas_[r];
+        ReplicaLock lock(replica);
+        const size_t index = replica.Find(key, fingerprint);
+        if (index == replica.size) {
+            return;
+        }
+        // The last entry takes the place of the erased one
+        --replica.size;
+        replica.fingerprints[index] = replica.fingerprints[replica.size];
+        replica.keys[index] = replica.keys[replica.size];
+        replica.values[index] = replica.values[replica.size];
+    }
+}
+
+template<typename Key, typename Tp, typename Compare, size_t Capacity>
+size_t HotValueReplicas<Key, Tp, Compare, Capacity>::Replica::Find(const Key &key, const uint64_t fingerprint) const {
+    const Compare compare;
+    for (size_t i = counter_kernels::FindFingerprint(fingerprints, size, fingerprint);
+         i < size; i = counter_kernels::FindFingerprint(fingerprints, size, fingerprint, i + 1)) {
+        if (!compare(keys[i], key) && !compare(key, keys[i])) {
+            return i;
+        }
+    }
+    return size;
+}
+
+template<typename Key, typename Tp, typename Compare, size_t Capacity>
+const typename HotValueReplicas<Key, Tp, Compare, Capacity>::Replica &
+HotValueReplicas<Key, Tp, Compare, Capacity>::LocalReplica() const {
+    const int cpu = sched_getcpu();
+    if (cpu >= 0) {
+        return replicas_[static_cast<size_t>(cpu) % replicas_count_];
+    }
+    // Without sched_getcpu threads are spread over the replicas
+    return replicas_[std::hash<std::thread::id>()(std::this_thread::get_id()) % replicas_count_];
+}
+
+#endif //VKTEST_HOT_VALUE_REPLICAS_H
@@ -0,0 +1,105 @@
+// Integer key traits implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_INTEGER_KEYS_H
+#define VKTEST_INTEGER_KEYS_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+/**
+ *  @brief  True for trivially copyable fixed-width integer keys: 32-bit, 64-bit and (where supported) 128-bit.
+ *
+ *  Such keys are stored inline in flat arrays (look FlatIntegerMap) and hashed by IntegerKeyHash.
+ */
+template<typename Key>
+struct IsFixedWidthIntegerKey
+        : std::integral_constant<bool, std::is_integral<Key>::value && (sizeof(Key) == 4 || sizeof(Key) == 8)> {
+};
+
+#if defined(__SIZEOF_INT128__)
+template<>
+struct IsFixedWidthIntegerKey<__int128> : std::true_type {
+};
+
+template<>
+struct IsFixedWidthIntegerKey<unsigned __int128> : std::true_type {
+};
+#endif
+
+/**
+ *  @brief  Fast hash of fixed-width integer keys (splitmix64 finalizer).
+ *
+ *  The finalizer is a bijection of 64-bit values, so 32-bit and 64-bit keys never collide in 64-bit hashes.
+ */
+template<typename Key>
+struct IntegerKeyHash {
+    static uint64_t Mix(uint64_t value) {
+        value ^= value >> 30;
+        value *= 0xbf58476d1ce4e5b9ULL;
+        value ^= value >> 27;
+        value *= 0x94d049bb133111ebULL;
+        value ^= value >> 31;
+        return value;
+    }
+
+    size_t operator()(const Key &key) const {
+        return Hash(key, std::integral_constant<bool, (sizeof(Key) > sizeof(uint64_t))>());
+    }
+
+private:
+    static size_t Hash(const Key &key, std::false_type) {
+        return static_cast<size_t>(Mix(static_cast<uint64_t>(key)));
+    }
+
+    static size_t Hash(const Key &key, std::true_type) {
+        const uint64_t low = static_cast<uint64_t>(key);
+        const uint64_t high = static_cast<uint64_t>(key >> 64);
+        return static_cast<size_t>(Mix(low) ^ Mix(high + 0x9e3779b97f4a7c15ULL));
+    }
+};
+
+/**
+ *  @brief  Default hash of keys for analyzers: IntegerKeyHash for fixed-width integer keys, std::hash otherwise.
+ */
+template<typename Key, typename Enable = void>
+struct DefaultKeyHash : std::hash<Key> {
+};
+
+template<typename Key>
+struct DefaultKeyHash<Key, typename std::enable_if<IsFixedWidthIntegerKey<Key>::value>::type>
+        : IntegerKeyHash<Key> {
+};
+
+/**
+ *  @brief  Hash of strings with a custom allocator (e.g. ArenaString), which std::hash doesn't support: the
+ *  characters are mixed 8 bytes at a time by the IntegerKeyHash finalizer.
+ */
+template<typename CharT, typename Traits, typename Alloc>
+struct DefaultKeyHash<std::basic_string<CharT, Traits, Alloc>,
+        typename std::enable_if<!std::is_same<Alloc, std::allocator<CharT>>::value>::type> {
+    size_t operator()(const std::basic_string<CharT, Traits, Alloc> &key) const {
+        const char *data = reinterpret_cast<const char *>(key.data());
+        const size_t size = key.size() * sizeof(CharT);
+        uint64_t hash = IntegerKeyHash<uint64_t>::Mix(size);
+        size_t offset = 0;
+        for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t)) {
+            uint64_t chunk;
+            memcpy(&chunk, data + offset, sizeof(chunk));
+            hash = IntegerKeyHash<uint64_t>::Mix(hash ^ chunk);
+        }
+        if (offset < size) {
+            uint64_t chunk = 0;
+            memcpy(&chunk, data + offset, size - offset);
+            hash = IntegerKeyHash<uint64_t>::Mix(hash ^ chunk ^ 0x9e3779b97f4a7c15ULL);
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+#endif //VKTEST_INTEGER_KEYS_H
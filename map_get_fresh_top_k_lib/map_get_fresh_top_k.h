@@ -1,145 +1,953 @@
-// MapGetFreshTopK implementation -*- C++ -*-
-
-// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
-
-#ifndef VKTEST_MAPGETFRESHTOPK_H
-#define VKTEST_MAPGETFRESHTOPK_H
-
-#include <string>
-#include <map>
-#include <chrono>
-#include <list>
-#include <vector>
-#include <utility>
-#include <algorithm>
-#include <iostream>
-#include <exception>
-
-#include "frequency_estimation_analyzer.h"
-
-/**
- *  @brief A modification of standard STL map with the additional "show keys asked most
- *  frequently for the last period function.
- *
- *  @tparam Key  Type of key objects, defaults to std::string
- *  @tparam Tp  Type of mapped objects, defaults to std::string
- *  @tparam Compare  Comparison function object type, defaults to less<Key>.
- *  @tparam Alloc  Allocator type, defaults to allocator<pair<const Key, Tp>.
- *
- *  By default accordingly to the given task this map is string->string,
- *  additional function get_top_k shows all keys asked most frequently
- *  accordingly to the "frequency estimation algorithm" (check README.md)
- *  for 10% and for the last minute by default. If no argument is provided,
- *  then shows only keys which were in >= ~10% of requests. If the argument
- *  `number` is provided, then tries to show `number` top keys.
- */
-template<typename Key = std::string, typename Tp = std::string, typename Compare = std::less<Key>, typename Alloc = std::allocator<std::pair<const Key, Tp>>>
-class MapGetFreshTopK {
-public:
-    /**
-     *  @brief Duplicate key request frequency analyzer constructor.
-     *
-     *  @param control_time  Timespan, defaults to 60 seconds.
-     *  @param share_to_be_very_frequent  Share of requests for keys to be
-     *  considered as "very frequent", defaults to 0.1 (10%).
-     *  @param num_buckets  Amount of buckets, defaults to 12.
-     *  @param bucket_size  Size of each bucket, defaults to 54.
-     */
-    explicit MapGetFreshTopK(std::chrono::duration<double> control_time = std::chrono::seconds(60),
-                             double share_to_be_very_frequent = 0.1, size_t num_buckets = 12,
-                             size_t bucket_size = 54);
-
-    /**
-     *  @brief  Access to %map data.
-     *  @param  key  The key for which data should be retrieved.
-     *  @return  A reference to the data of the (key, data) %pair.
-     *
-     *  Returns data associated with the key `key`. If the key
-     *  does not exist, a pair with that key is created using
-     *  default values, which is then returned.
-     *
-     *  Time complexity: O(log(n)), where n - size of the map
-     */
-    Tp &get(const Key &key);
-
-    /**
-     *  @brief  Add or change %map data.
-     *  @param  key  The key for which data should be added or changed. If data
-     *          whose key is equivalent is present, then change it.
-     *  @param  value  The value which should be associated with the `key`.
-     *
-     *  If the key does not exist, a pair with that key is created using `value`.
-     *  Else change the value of data associated with the key `key` to the data
-     *  `value`.
-     *
-     *  Time complexity: O(log(n)), where n is the size of the map.
-     */
-    void set(const Key &key, const Tp &value);
-
-    /**
-     *  @brief  Print very frequently asked keys.
-     *  @param number  Number of the requested top by frequency of requests in the last period keys.
-     *  @return  Vector with frequently asked keys for the last minute.
-     *
-     *  Returned vector size can be different. If `number` is specified, returns min of requested in the last minute
-     *  different keys and `number`, but the top can be wrong, because math theory is designed for keys requested in
-     *  >= ~10% of requests. If it is not specified, returns only keys that have been requested at >= ~10% of
-     *  requests in the last period accordingly to the "frequency estimation algorithm".
-     *
-     *  E.g. if `number` is not specified and there are not a single key which has been requested at >= ~10% of requests
-     *  in the last period, then the returned vector is empty.
-     *
-     *  Time complexity: O(1).
-     */
-    std::vector<Key> get_top_k(const size_t number = 0);
-
-private:
-
-    std::map<Key, Tp, Compare, Alloc> map_;
-    FrequencyEstimationAnalyzer<Key, Compare> analyzer_;
-};
-
-template<typename Key, typename Tp, typename Compare, typename Alloc>
-MapGetFreshTopK<Key, Tp, Compare, Alloc>::MapGetFreshTopK(
-        const std::chrono::duration<double> control_time, const double share_to_be_very_frequent,
-        const size_t num_buckets,
-        const size_t bucket_size): analyzer_(
-        FrequencyEstimationAnalyzer<Key, Compare>(control_time, share_to_be_very_frequent, num_buckets, bucket_size)) {
-};
-
-template<typename Key, typename Tp, typename Compare, typename Alloc>
-Tp &MapGetFreshTopK<Key, Tp, Compare, Alloc>::get(const Key &key) {
-    // #sleep well at night
-    try {
-        analyzer_.AddKey(key);
-    } catch (std::exception &e) {
-        // don't try again add this key - an exception is a rare situation, this action doesn't affect statistics
-    }
-
-    return map_[key];
-}
-
-template<typename Key, typename Tp, typename Compare, typename Alloc>
-void MapGetFreshTopK<Key, Tp, Compare, Alloc>::set(const Key &key, const Tp &value) {
-    map_[key] = value;
-
-    // #sleep well at night
-    try {
-        analyzer_.AddKey(key);
-    } catch (std::exception &e) {
-        // don't try again add this key - an exception is a rare situation, this action doesn't affect statistics
-    }
-}
-
-template<typename Key, typename Tp, typename Compare, typename Alloc>
-std::vector<Key>
-MapGetFreshTopK<Key, Tp, Compare, Alloc>::get_top_k(size_t number) {
-    // #sleep well at night
-    try {
-        return analyzer_.GetTopKKeys(number);
-    } catch (std::exception &e) {
-        return std::vector<Key>();
-    }
-}
-
-#endif //VKTEST_MAPGETFRESHTOPK_H
+// MapGetFreshTopK implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_MAPGETFRESHTOPK_H
+#define VKTEST_MAPGETFRESHTOPK_H
+
+#include <string>
+#include <map>
+#include <chrono>
+#include <list>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <memory>
+#include <type_traits>
+#include <functional>
+
+#include "async_frequency_estimation_analyzer.h"
+#include "frequency_estimation_analyzer.h"
+#include "flat_integer_map.h"
+#include "front_cache.h"
+#include "hot_key_admission_controller.h"
+#include "hot_value_replicas.h"
+#include "multi_dimensional_frequency_estimation_analyzer.h"
+#include "slab_allocator.h"
+#include "timing_wheel.h"
+#include "tiny_lfu_policy.h"
+#include "memory_usage.h"
+#include "integer_keys.h"
+
+/**
+ *  @brief  Operations of MapGetFreshTopK counted separately by `enable_per_operation_top_k`.
+ */
+enum class MapOperation {
+    // get and try_get
+    kGet,
+    kSet
+};
+
+/**
+ *  @brief A modification of standard STL map with the additional "show keys asked most
+ *  frequently for the last period function.
+ *
+ *  @tparam Key  Type of key objects, defaults to std::string
+ *  @tparam Tp  Type of mapped objects, defaults to std::string
+ *  @tparam Compare  Comparison function object type, defaults to less<Key>.
+ *  @tparam Alloc  Allocator type, defaults to allocator<pair<const Key, Tp>.
+ *
+ *  By default accordingly to the given task this map is string->string,
+ *  additional function get_top_k shows all keys asked most frequently
+ *  accordingly to the "frequency estimation algorithm" (check README.md)
+ *  for 10% and for the last minute by default. If no argument is provided,
+ *  then shows only keys which were in >= ~10% of requests. If the argument
+ *  `number` is provided, then tries to show `number` top keys.
+ *
+ *  Values of the very frequent keys are reached through a small FrontCache refreshed from the analyzer top at every
+ *  bucket rotation, so the keys with the most lookups don't walk the map.
+ *
+ *  With `enable_hot_value_replicas` the values of the front cache keys are also copied per CPU core for readers in
+ *  other threads (`read_replica`), then values must be changed through `set`.
+ *
+ *  With `enable_hot_key_admission` requests of the very frequent keys are rate limited (`should_admit`).
+ *
+ *  With `set_capacity` the map becomes a bounded cache (W-TinyLFU eviction driven by the analyzer statistics).
+ *
+ *  With `enable_async_analyzer` the statistics are updated by a dedicated thread, `get` and `set` only push keys to
+ *  its queue.
+ *
+ *  With `enable_exact_verification` the candidates of the top are counted exactly, so `get_top_k()` has no false
+ *  positives. It can't be combined with sampling, whose counts are estimates.
+ *
+ *  With `enable_per_operation_top_k` read-hot and write-hot keys are also told apart: `get_top_k(MapOperation)`.
+ *
+ *  `get` and `set` take an optional weight of the request (bytes served, CPU time), then the top is the keys with
+ *  >= ~10% of the total weight.
+ *
+ *  For fixed-width integer keys (32-bit, 64-bit, 128-bit IDs) with the default Compare and Alloc the data is kept
+ *  in a FlatIntegerMap and the analyzer hashes keys by IntegerKeyHash, so there are no per-key heap allocations
+ *  besides the values themselves. For string keys and values ArenaMapGetFreshTopK keeps the nodes and the strings in
+ *  slab blocks (SlabAllocator).
+ */
+
+template<typename Key = std::string, typename Tp = std::string, typename Compare = std::less<Key>, typename Alloc = std::allocator<std::pair<const Key, Tp>>>
+class MapGetFreshTopK {
+public:
+    /**
+     *  @brief Duplicate key request frequency analyzer constructor.
+     *
+     *  @param control_time  Timespan, defaults to 60 seconds.
+     *  @param share_to_be_very_frequent  Share of requests for keys to be
+     *  considered as "very frequent", defaults to 0.1 (10%).
+     *  @param num_buckets  Amount of buckets, defaults to 12.
+     *  @param bucket_size  Size of each bucket, defaults to 54.
+     */
+    explicit MapGetFreshTopK(std::chrono::duration<double> control_time = std::chrono::seconds(60),
+                             double share_to_be_very_frequent = 0.1, size_t num_buckets = 12,
+                             size_t bucket_size = 54);
+
+    /**
+     *  @brief  Access to %map data.
+     *  @param  key  The key for which data should be retrieved.
+     *  @param  weight  Weight of the request for the statistics (e.g. size of the value in bytes), defaults to 1.
+     *  @return  A reference to the data of the (key, data) %pair.
+     *
+     *  Returns data associated with the key `key`. If the key
+     *  does not exist, a pair with that key is created using
+     *  default values (or the value of the loader, look `set_loader`), which is then returned.
+     *
+     *  With `enable_hot_value_replicas` change values through `set` only: writes through the returned reference
+     *  bypass the replicas, which serve the old value till the next bucket rotation.
+     *
+     *  Time complexity: O(log(n)), where n - size of the map (O(1) on average for integer keys)
+     */
+    Tp &get(const Key &key, int64_t weight = 1);
+
+    /**
+     *  @brief  Access to %map data without insertion.
+     *  @return  A pointer to the data of the key, nullptr if the key does not exist.
+     *
+     *  The request is counted in statistics like in `get`. Use it in cache mode (look `set_capacity`), where a miss
+     *  should go to the backing store and then to `set`. Writes through the pointer bypass the hot value replicas
+     *  like in `get`.
+     */
+    Tp *try_get(const Key &key, int64_t weight = 1);
+
+    /**
+     *  @brief  Make `get` read through: the value of a missing key is `loader(key)` instead of the default one.
+     *  Exceptions of the loader are passed to the caller of `get`, nothing is inserted then.
+     *
+     *  The map is used by one thread, so there is nothing to coalesce, look ConcurrentMapGetFreshTopK::get_or_load
+     *  for concurrent loads.
+     */
+    void set_loader(std::function<Tp(const Key &)> loader);
+
+    /**
+     *  @brief  Add or change %map data.
+     *  @param  key  The key for which data should be added or changed. If data
+     *          whose key is equivalent is present, then change it.
+     *  @param  value  The value which should be associated with the `key`.
+     *  @param  weight  Weight of the request for the statistics, defaults to 1.
+     *
+     *  If the key does not exist, a pair with that key is created using `value`.
+     *  Else change the value of data associated with the key `key` to the data
+     *  `value`.
+     *
+     *  Time complexity: O(log(n)), where n is the size of the map (O(1) on average for integer keys).
+     */
+    void set(const Key &key, const Tp &value, int64_t weight = 1);
+
+    /**
+     *  @brief  `set` with a time to live: the key is erased when `ttl` passes, unless it is set again before.
+     *
+     *  Expired keys are missing for `get` and `try_get` right away and are erased by the timing wheel (look
+     *  TimingWheel) at every bucket rotation of the analyzer or by `expire`, so the cost of expiration is
+     *  proportional to the number of expired keys, not to the size of the map. `set` without a TTL makes the key
+     *  permanent again. References returned by `get` are valid until the key expires. Lookups of keys without a TTL
+     *  only check the fingerprint table of the wheel (TimingWheel::MayHaveDeadline), they don't read the clock.
+     *
+     *  Time complexity: O(log(n)), where n is the size of the map.
+     */
+    void set(const Key &key, const Tp &value, std::chrono::duration<double> ttl, int64_t weight = 1);
+
+    /**
+     *  @brief  Erase the keys whose TTL has passed. Returns their number.
+     *
+     *  Called at every bucket rotation of the analyzer, call it on a timer if requests may stop for a long time.
+     */
+    size_t expire();
+
+    /**
+     *  @brief  Remove the key. Returns true if it has been in the map.
+     *
+     *  Not counted in statistics.
+     */
+    bool erase(const Key &key);
+
+    /**
+     *  @brief  Turn on cache mode: keep at most `max_entries` keys, 0 turns it off (no limit, the default).
+     *
+     *  Keys to keep are chosen by the W-TinyLFU policy (look TinyLfuPolicy) with analyzer counters as frequencies:
+     *  cold keys are evicted in LRU order, very frequent ones are kept. Cache mode can only be turned on for an empty
+     *  map (otherwise std::logic_error is thrown), the limit can be changed at any time. References returned by
+     *  `get` are valid until the key is evicted, i.e. until the next insertion of another key.
+     */
+    void set_capacity(size_t max_entries);
+
+    size_t size() const;
+
+    /**
+     *  @brief  Memory used by the map: keys and values of the data, counters of the analyzer, overhead of the data
+     *  structures (nodes, the analyzer keys, the front cache, the cache policy).
+     *
+     *  Time complexity: O(n), where n is the size of the map.
+     */
+    MemoryUsage memory_usage() const;
+
+    /**
+     *  @brief  Map with the analyzer configuration chosen from its memory budget and the accuracy (look
+     *  FrequencyEstimationAnalyzer::ChooseSizing). The budget doesn't include the data itself.
+     */
+    static MapGetFreshTopK FromMemoryBudget(std::chrono::duration<double> control_time, size_t analyzer_memory_budget,
+                                            double share_to_be_very_frequent = 0.1, double error = 0.01,
+                                            size_t key_bytes = sizeof(Key));
+
+    /**
+     *  @brief  Print very frequently asked keys.
+     *  @param number  Number of the requested top by frequency of requests in the last period keys.
+     *  @return  Vector with frequently asked keys for the last minute.
+     *
+     *  Returned vector size can be different. If `number` is specified, returns min of requested in the last minute
+     *  different keys and `number`, but the top can be wrong, because math theory is designed for keys requested in
+     *  >= ~10% of requests. If it is not specified, returns only keys that have been requested at >= ~10% of
+     *  requests in the last period accordingly to the "frequency estimation algorithm".
+     *
+     *  E.g. if `number` is not specified and there are not a single key which has been requested at >= ~10% of requests
+     *  in the last period, then the returned vector is empty.
+     *
+     *  Time complexity: O(1).
+     */
+    std::vector<Key> get_top_k(const size_t number = 0);
+
+    /**
+     *  @brief  Very frequent keys of one operation, e.g. `get_top_k(MapOperation::kSet)` are the keys hot for writes.
+     *  Throws std::logic_error if `enable_per_operation_top_k` has not been called.
+     */
+    std::vector<Key> get_top_k(MapOperation operation, size_t number = 0);
+
+    /**
+     *  @brief  Keep a top per operation besides the common one (look MultiDimensionalFrequencyEstimationAnalyzer),
+     *  counting from now on. The tops per operation and the common top start their epochs at the same aligned
+     *  boundaries, a request hashes the key and reads the clock once and updates the counters of both tops.
+     *
+     *  In async mode the tops per operation are still updated by the calling thread, and the common top rotates by
+     *  itself in the thread of the analyzer. The async analyzer can't be enabled after the call (std::logic_error).
+     */
+    void enable_per_operation_top_k();
+
+    /**
+     *  @brief  Update statistics only for a random 1 of `period` requests (look
+     *  FrequencyEstimationAnalyzer::SetSamplingPeriod for the error bounds).
+     */
+    void set_sampling_period(int64_t period);
+
+    /**
+     *  @brief  Choose the sampling period from the load, at most `max_updates_per_second` statistics updates per
+     *  second (look FrequencyEstimationAnalyzer::SetAdaptiveSampling), 0 turns sampling off.
+     */
+    void set_adaptive_sampling(double max_updates_per_second);
+
+    /**
+     *  @brief  Keep one-hit keys out of the statistics buckets (look FrequencyEstimationAnalyzer::EnableDoorkeeper).
+     *  @param  expected_keys_per_epoch  Expected number of different keys per control_time / num_buckets.
+     */
+    void enable_doorkeeper(size_t expected_keys_per_epoch, double false_positive_rate = 0.01);
+
+    /**
+     *  @brief  Count distinct requested keys of the control time (look
+     *  FrequencyEstimationAnalyzer::EnableDistinctKeysCount).
+     */
+    void enable_distinct_keys_count(size_t precision = 12);
+
+    /**
+     *  @brief  Estimated number of distinct keys requested in the last period, throws std::logic_error if the count
+     *  is not enabled.
+     */
+    uint64_t distinct_keys_count();
+
+    /**
+     *  @brief  Count the candidates of the top exactly, so `get_top_k()` has no false positives (look
+     *  FrequencyEstimationAnalyzer::EnableExactVerification). Throws std::logic_error if sampling is on, and
+     *  sampling can't be turned on after it.
+     */
+    void enable_exact_verification();
+
+    /**
+     *  @brief  Keys growing fastest between the two last completed epochs (look
+     *  FrequencyEstimationAnalyzer::GetTrending), at most `number` of them if it is specified.
+     */
+    std::vector<Key> get_trending(size_t number = 0);
+
+    /**
+     *  @brief  Verified very frequent keys with their counts in the last period, throws std::logic_error if the
+     *  verification is not enabled.
+     */
+    std::vector<std::pair<Key, int64_t>> get_verified_top_k();
+
+    /**
+     *  @brief  Get keys which entered or left the `get_top_k()` set, once per bucket rotation (look
+     *  FrequencyEstimationAnalyzer::Subscribe). The callback is called inside `get`, `set` or `get_top_k`.
+     *  @return  Id of the subscription for unsubscribe_hot_set_changes.
+     */
+    size_t subscribe_hot_set_changes(std::function<void(const HotSetChange<Key> &)> callback);
+
+    size_t subscribe_hot_set_changes(BoundedQueue<HotSetChange<Key>> &queue);
+
+    void unsubscribe_hot_set_changes(size_t subscription_id);
+
+    /**
+     *  @brief  Move the analyzer to a dedicated thread (look AsyncFrequencyEstimationAnalyzer): `get` and `set` only
+     *  push keys to a queue of `queue_capacity` keys, `get_top_k` returns the last published top.
+     *
+     *  Configure the analyzer (sampling, doorkeeper, subscriptions, distinct keys) before, after the call these
+     *  methods and cache mode throw std::logic_error. It can't be turned off.
+     */
+    void enable_async_analyzer(size_t queue_capacity = 65536, OverflowPolicy overflow_policy = OverflowPolicy::kDrop);
+
+    /**
+     *  @brief  Wait until the analyzer thread counts the requests made so far, nothing to do without it.
+     */
+    void flush_analyzer();
+
+    /**
+     *  @brief  Requests not counted because the queue of the analyzer thread was full.
+     */
+    uint64_t dropped_requests() const;
+
+    /**
+     *  @brief  Keep copies of the values of the very frequent keys (the front cache keys) per CPU core, look
+     *  HotValueReplicas. `replicas_count` defaults to the number of hardware threads.
+     *
+     *  The replicas are refilled at every bucket rotation and updated by `set`, so values must be changed through
+     *  `set`: values changed through references returned by `get` or `try_get` are not seen by the replicas till
+     *  the next rotation.
+     */
+    void enable_hot_value_replicas(size_t replicas_count = 0);
+
+    /**
+     *  @brief  Copy the value of a very frequent key from the replica of the current core, false if the key is not
+     *  replicated (then use `get` under the lock of the map).
+     *
+     *  Unlike the other methods it may be called from any thread concurrently with everything but the destruction
+     *  of the map and `enable_hot_value_replicas`. Not counted in statistics.
+     */
+    bool read_replica(const Key &key, Tp &value) const;
+
+    /**
+     *  @brief  Limit requests of every very frequent key to `max_requests_per_second` with bursts of `burst`
+     *  requests (defaults to the rate), look HotKeyAdmissionController. The hot set is refreshed at every bucket
+     *  rotation.
+     */
+    void enable_hot_key_admission(double max_requests_per_second, double burst = 0);
+
+    /**
+     *  @brief  Whether a request of `key` may go on (to `get`, `set` or the backend), false if the key is very
+     *  frequent and over its rate. Always true without `enable_hot_key_admission`.
+     *
+     *  Refused requests are counted in statistics here (as reads), admitted ones by the following `get` or `set`,
+     *  so a throttled key stays very frequent while its traffic lasts.
+     *
+     *  Time complexity: one scan of a table of at most 16 fingerprints for keys which are not very frequent.
+     */
+    bool should_admit(const Key &key, int64_t weight = 1);
+
+    /**
+     *  @brief  Number of requests refused by `should_admit`.
+     */
+    uint64_t throttled_requests() const;
+
+    const FrontCache<Key, Tp, Compare> &front_cache() const;
+
+private:
+    void AddKeyToAnalyzer(const Key &key, uint64_t fingerprint, int64_t weight, MapOperation operation);
+
+    uint64_t AnalyzerEpoch() const;
+
+    // The analyzer for configuration, throws std::logic_error in async mode
+    FrequencyEstimationAnalyzer<Key, Compare> &SynchronousAnalyzer();
+
+    // Start the epoch of the tops per operation in the synchronous analyzer too
+    void RotateWithOperations(std::chrono::system_clock::time_point now);
+
+    // Insert the loaded (or default) value of a missing key
+    Tp &InsertMissing(const Key &key);
+
+    // Fill the front cache with the top of the analyzer if the epoch has changed
+    void RefreshFrontCache();
+
+    // Cache mode: register a new key in the policy and drop evicted keys
+    void AdmitNewKey(const Key &key);
+
+    void EraseEvictedKeys();
+
+    // Whether the key has a TTL which has passed
+    bool IsExpired(const Key &key, uint64_t fingerprint) const;
+
+    // `set` of the key with the fingerprint, without touching its TTL
+    void SetWithHash(const Key &key, uint64_t fingerprint, const Tp &value, int64_t weight);
+
+
+    typename MapGetFreshTopKStorage<Key, Tp, Compare, Alloc>::type map_;
+    // Only hashes keys after it is moved to async_analyzer_
+    FrequencyEstimationAnalyzer<Key, Compare> analyzer_;
+    std::unique_ptr<AsyncFrequencyEstimationAnalyzer<Key, Compare>> async_analyzer_;
+    // Has no dimensions until `enable_per_operation_top_k`, the common top is analyzer_
+    MultiDimensionalFrequencyEstimationAnalyzer<Key, MapOperation, Compare> operation_analyzer_;
+    bool per_operation_top_k_;
+    FrontCache<Key, Tp, Compare> front_cache_;
+    uint64_t front_cache_epoch_;
+    // nullptr if cache mode is off
+    std::unique_ptr<TinyLfuPolicy<Key, Compare>> cache_policy_;
+    std::vector<Key> evicted_keys_;
+    // nullptr if replicas are off, else copies of the front cache values
+    std::unique_ptr<HotValueReplicas<Key, Tp, Compare>> replicas_;
+    // nullptr if the admission control is off, else token buckets of the analyzer top
+    std::unique_ptr<HotKeyAdmissionController<Key, Compare>> admission_;
+    std::function<Tp(const Key &)> loader_;
+    // nullptr until the first `set` with a TTL
+    std::unique_ptr<TimingWheel<Key, Compare>> ttl_;
+};
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+MapGetFreshTopK<Key, Tp, Compare, Alloc>::MapGetFreshTopK(
+        const std::chrono::duration<double> control_time, const double share_to_be_very_frequent,
+        const size_t num_buckets,
+        const size_t bucket_size): analyzer_(
+        FrequencyEstimationAnalyzer<Key, Compare>(control_time, share_to_be_very_frequent, num_buckets, bucket_size)),
+        async_analyzer_(),
+        operation_analyzer_(control_time, share_to_be_very_frequent, num_buckets, bucket_size, false),
+        per_operation_top_k_(false), front_cache_(), front_cache_epoch_(0), cache_policy_(), evicted_keys_(),
+        replicas_(), admission_(), loader_(), ttl_() {
+};
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+Tp &MapGetFreshTopK<Key, Tp, Compare, Alloc>::get(const Key &key, const int64_t weight) {
+    const uint64_t fingerprint = analyzer_.HashKey(key);
+    // #sleep well at night
+    try {
+        AddKeyToAnalyzer(key, fingerprint, weight, MapOperation::kGet);
+    } catch (std::exception &e) {
+        // don't try again add this key - an exception is a rare situation, this action doesn't affect statistics
+    }
+
+    RefreshFrontCache();
+    if (IsExpired(key, fingerprint)) {
+        erase(key);
+    }
+    Tp *value = front_cache_.Find(key, fingerprint);
+    if (value != nullptr) {
+        return *value;
+    }
+    if (!cache_policy_ && !loader_) {
+        return map_[key];
+    }
+
+    auto it = map_.find(key);
+    if (it != map_.end()) {
+        if (cache_policy_) {
+            cache_policy_->Touch(key);
+        }
+        return it->second;
+    }
+    Tp &inserted = InsertMissing(key);
+    if (cache_policy_) {
+        // The new key is in the policy window, so its own admission never evicts it
+        AdmitNewKey(key);
+    }
+    return inserted;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+Tp *MapGetFreshTopK<Key, Tp, Compare, Alloc>::try_get(const Key &key, const int64_t weight) {
+    const uint64_t fingerprint = analyzer_.HashKey(key);
+    // #sleep well at night
+    try {
+        AddKeyToAnalyzer(key, fingerprint, weight, MapOperation::kGet);
+    } catch (std::exception &e) {
+        // don't try again add this key - an exception is a rare situation, this action doesn't affect statistics
+    }
+
+    RefreshFrontCache();
+    if (IsExpired(key, fingerprint)) {
+        erase(key);
+    }
+    Tp *value = front_cache_.Find(key, fingerprint);
+    if (value != nullptr) {
+        return value;
+    }
+    auto it = map_.find(key);
+    if (it == map_.end()) {
+        return nullptr;
+    }
+    if (cache_policy_) {
+        cache_policy_->Touch(key);
+    }
+    return &it->second;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::set_loader(std::function<Tp(const Key &)> loader) {
+    loader_ = std::move(loader);
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::set(const Key &key, const Tp &value, const int64_t weight) {
+    const uint64_t fingerprint = analyzer_.HashKey(key);
+    if (ttl_ && ttl_->MayHaveDeadline(fingerprint)) {
+        ttl_->Cancel(key);
+    }
+    SetWithHash(key, fingerprint, value, weight);
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::set(const Key &key, const Tp &value,
+                                                   const std::chrono::duration<double> ttl, const int64_t weight) {
+    const uint64_t fingerprint = analyzer_.HashKey(key);
+    if (!ttl_) {
+        ttl_.reset(new TimingWheel<Key, Compare>());
+    }
+    // Before the value, so the expiration at a rotation inside of `set` sees the new deadline
+    ttl_->ScheduleWithHash(key, fingerprint, std::chrono::steady_clock::now() +
+                                             std::chrono::duration_cast<std::chrono::steady_clock::duration>(ttl));
+    SetWithHash(key, fingerprint, value, weight);
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::SetWithHash(const Key &key, const uint64_t fingerprint,
+                                                           const Tp &value, const int64_t weight) {
+    Tp *cached_value = front_cache_.Find(key, fingerprint);
+    if (cached_value != nullptr) {
+        *cached_value = value;
+        if (replicas_) {
+            replicas_->Update(key, fingerprint, value);
+        }
+    } else if (!cache_policy_) {
+        map_[key] = value;
+    } else {
+        auto it = map_.find(key);
+        if (it != map_.end()) {
+            it->second = value;
+            cache_policy_->Touch(key);
+        } else {
+            map_[key] = value;
+            AdmitNewKey(key);
+        }
+    }
+
+    // #sleep well at night
+    try {
+        AddKeyToAnalyzer(key, fingerprint, weight, MapOperation::kSet);
+    } catch (std::exception &e) {
+        // don't try again add this key - an exception is a rare situation, this action doesn't affect statistics
+    }
+
+    RefreshFrontCache();
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+size_t MapGetFreshTopK<Key, Tp, Compare, Alloc>::expire() {
+    if (!ttl_) {
+        return 0;
+    }
+    std::vector<Key> expired;
+    ttl_->Advance(std::chrono::steady_clock::now(), expired);
+    size_t erased = 0;
+    for (size_t i = 0; i < expired.size(); ++i) {
+        erased += erase(expired[i]) ? 1 : 0;
+    }
+    return erased;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+std::vector<Key>
+MapGetFreshTopK<Key, Tp, Compare, Alloc>::get_top_k(size_t number) {
+    // #sleep well at night
+    try {
+        if (async_analyzer_) {
+            return async_analyzer_->GetTopKKeys(number);
+        }
+        return SynchronousAnalyzer().GetTopKKeys(number);
+    } catch (std::exception &e) {
+        return std::vector<Key>();
+    }
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+std::vector<Key> MapGetFreshTopK<Key, Tp, Compare, Alloc>::get_top_k(const MapOperation operation,
+                                                                    const size_t number) {
+    if (!per_operation_top_k_) {
+        throw std::logic_error("MapGetFreshTopK: tops per operation are not enabled");
+    }
+    // #sleep well at night
+    try {
+        return operation_analyzer_.GetTopKKeys(operation, static_cast<int>(number));
+    } catch (std::exception &e) {
+        return std::vector<Key>();
+    }
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::enable_per_operation_top_k() {
+    per_operation_top_k_ = true;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::set_sampling_period(const int64_t period) {
+    SynchronousAnalyzer().SetSamplingPeriod(period);
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::set_adaptive_sampling(const double max_updates_per_second) {
+    SynchronousAnalyzer().SetAdaptiveSampling(max_updates_per_second);
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::enable_doorkeeper(const size_t expected_keys_per_epoch,
+                                                                 const double false_positive_rate) {
+    SynchronousAnalyzer().EnableDoorkeeper(expected_keys_per_epoch, false_positive_rate);
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::enable_distinct_keys_count(const size_t precision) {
+    SynchronousAnalyzer().EnableDistinctKeysCount(precision);
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+uint64_t MapGetFreshTopK<Key, Tp, Compare, Alloc>::distinct_keys_count() {
+    return SynchronousAnalyzer().GetDistinctKeysCount();
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::enable_exact_verification() {
+    SynchronousAnalyzer().EnableExactVerification();
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+std::vector<Key> MapGetFreshTopK<Key, Tp, Compare, Alloc>::get_trending(const size_t number) {
+    return SynchronousAnalyzer().GetTrending(static_cast<int>(number));
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+std::vector<std::pair<Key, int64_t>> MapGetFreshTopK<Key, Tp, Compare, Alloc>::get_verified_top_k() {
+    return SynchronousAnalyzer().GetVerifiedTopKKeys();
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+size_t MapGetFreshTopK<Key, Tp, Compare, Alloc>::subscribe_hot_set_changes(
+        std::function<void(const HotSetChange<Key> &)> callback) {
+    return SynchronousAnalyzer().Subscribe(std::move(callback));
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+size_t MapGetFreshTopK<Key, Tp, Compare, Alloc>::subscribe_hot_set_changes(BoundedQueue<HotSetChange<Key>> &queue) {
+    return SynchronousAnalyzer().Subscribe(queue);
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::unsubscribe_hot_set_changes(const size_t subscription_id) {
+    SynchronousAnalyzer().Unsubscribe(subscription_id);
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::enable_async_analyzer(const size_t queue_capacity,
+                                                                     const OverflowPolicy overflow_policy) {
+    if (async_analyzer_) {
+        return;
+    }
+    if (cache_policy_) {
+        throw std::logic_error("MapGetFreshTopK: cache mode needs the synchronous analyzer");
+    }
+    if (per_operation_top_k_) {
+        throw std::logic_error("MapGetFreshTopK: the tops per operation rotate the synchronous analyzer");
+    }
+    // The hash function is const, so it stays in analyzer_ after the move
+    async_analyzer_.reset(
+            new AsyncFrequencyEstimationAnalyzer<Key, Compare>(std::move(analyzer_), queue_capacity, overflow_policy));
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::flush_analyzer() {
+    if (async_analyzer_) {
+        async_analyzer_->Flush();
+    }
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+uint64_t MapGetFreshTopK<Key, Tp, Compare, Alloc>::dropped_requests() const {
+    return async_analyzer_ ? async_analyzer_->dropped_count() : 0;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::enable_hot_value_replicas(const size_t replicas_count) {
+    replicas_.reset(new HotValueReplicas<Key, Tp, Compare>(replicas_count));
+    // The replicas are filled by the next refresh of the front cache
+    front_cache_epoch_ = AnalyzerEpoch() + 1;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+bool MapGetFreshTopK<Key, Tp, Compare, Alloc>::read_replica(const Key &key, Tp &value) const {
+    return replicas_ && replicas_->Read(key, analyzer_.HashKey(key), value);
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::enable_hot_key_admission(const double max_requests_per_second,
+                                                                        const double burst) {
+    admission_.reset(new HotKeyAdmissionController<Key, Compare>(max_requests_per_second, burst));
+    // The hot set is filled by the next refresh of the front cache
+    front_cache_epoch_ = AnalyzerEpoch() + 1;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+bool MapGetFreshTopK<Key, Tp, Compare, Alloc>::should_admit(const Key &key, const int64_t weight) {
+    if (!admission_) {
+        return true;
+    }
+    RefreshFrontCache();
+    const uint64_t fingerprint = analyzer_.HashKey(key);
+    if (admission_->Admit(key, fingerprint, weight)) {
+        return true;
+    }
+    // #sleep well at night
+    try {
+        AddKeyToAnalyzer(key, fingerprint, weight, MapOperation::kGet);
+    } catch (std::exception &e) {
+        // don't try again add this key - an exception is a rare situation, this action doesn't affect statistics
+    }
+    return false;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+uint64_t MapGetFreshTopK<Key, Tp, Compare, Alloc>::throttled_requests() const {
+    return admission_ ? admission_->throttled_count() : 0;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+const FrontCache<Key, Tp, Compare> &MapGetFreshTopK<Key, Tp, Compare, Alloc>::front_cache() const {
+    return front_cache_;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+Tp &MapGetFreshTopK<Key, Tp, Compare, Alloc>::InsertMissing(const Key &key) {
+    if (!loader_) {
+        return map_[key];
+    }
+    // Loaded before the insertion, so a failed load leaves the map unchanged
+    Tp value = loader_(key);
+    Tp &inserted = map_[key];
+    inserted = std::move(value);
+    return inserted;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::RefreshFrontCache() {
+    if (front_cache_epoch_ == AnalyzerEpoch()) {
+        return;
+    }
+
+    front_cache_.Clear();
+    // Bucket rotations are the ticks of the background expiration
+    expire();
+    std::vector<Key> top;
+    // #sleep well at night
+    try {
+        top = async_analyzer_ ? async_analyzer_->GetTopKKeys() : analyzer_.GetTopKKeys();
+    } catch (std::exception &e) {
+        // the cache stays empty until the next epoch, `get` and `set` work without it
+    }
+    // GetTopKKeys may rotate buckets too
+    front_cache_epoch_ = AnalyzerEpoch();
+    if (admission_) {
+        std::vector<uint64_t> top_fingerprints;
+        for (size_t i = 0; i < top.size(); ++i) {
+            top_fingerprints.push_back(analyzer_.HashKey(top[i]));
+        }
+        admission_->Assign(top, top_fingerprints);
+    }
+
+    std::vector<Key> cached_keys;
+    std::vector<uint64_t> fingerprints;
+    std::vector<const Tp *> values;
+    for (size_t i = 0; i < top.size() && i < front_cache_.capacity(); ++i) {
+        // Only existing values are cached: the cache never inserts into the map
+        auto it = map_.find(top[i]);
+        if (it != map_.end()) {
+            front_cache_.Insert(top[i], analyzer_.HashKey(top[i]), &it->second);
+            if (replicas_) {
+                cached_keys.push_back(top[i]);
+                fingerprints.push_back(analyzer_.HashKey(top[i]));
+                values.push_back(&it->second);
+            }
+        }
+    }
+    if (replicas_) {
+        replicas_->Assign(cached_keys, fingerprints, values);
+    }
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+bool MapGetFreshTopK<Key, Tp, Compare, Alloc>::erase(const Key &key) {
+    const uint64_t fingerprint = analyzer_.HashKey(key);
+    front_cache_.Erase(key, fingerprint);
+    if (replicas_) {
+        replicas_->Erase(key, fingerprint);
+    }
+    if (cache_policy_) {
+        cache_policy_->Erase(key);
+    }
+    if (ttl_ && ttl_->MayHaveDeadline(fingerprint)) {
+        ttl_->Cancel(key);
+    }
+    return map_.erase(key) > 0;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::set_capacity(const size_t max_entries) {
+    if (max_entries == 0) {
+        cache_policy_.reset();
+        return;
+    }
+    if (async_analyzer_) {
+        throw std::logic_error("MapGetFreshTopK: cache mode needs the synchronous analyzer");
+    }
+    if (!cache_policy_) {
+        if (!map_.empty()) {
+            throw std::logic_error("MapGetFreshTopK: cache mode can only be turned on for an empty map");
+        }
+        cache_policy_.reset(new TinyLfuPolicy<Key, Compare>(max_entries));
+        return;
+    }
+    const FrequencyEstimationAnalyzer<Key, Compare> &analyzer = analyzer_;
+    cache_policy_->SetCapacity(max_entries, [&analyzer](const Key &key) { return analyzer.EstimateFrequency(key); },
+                               evicted_keys_);
+    EraseEvictedKeys();
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+size_t MapGetFreshTopK<Key, Tp, Compare, Alloc>::size() const {
+    return map_.size();
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+MemoryUsage MapGetFreshTopK<Key, Tp, Compare, Alloc>::memory_usage() const {
+    MemoryUsage usage = ContainerMemoryUsage(map_);
+    // The analyzer keeps copies of hot keys only, they are the analyzer's overhead
+    const MemoryUsage analyzer_usage = async_analyzer_ ? async_analyzer_->memory_usage() : analyzer_.memory_usage();
+    usage.counters += analyzer_usage.counters;
+    usage.overhead += analyzer_usage.keys + analyzer_usage.overhead;
+    usage.overhead += sizeof(*this) - sizeof(map_) - sizeof(analyzer_) - sizeof(operation_analyzer_);
+    const MemoryUsage operation_usage = operation_analyzer_.memory_usage();
+    usage.counters += operation_usage.counters;
+    usage.overhead += operation_usage.keys + operation_usage.overhead;
+    if (cache_policy_) {
+        usage.overhead += cache_policy_->memory_usage().total();
+    }
+    if (replicas_) {
+        usage.overhead += replicas_->memory_usage();
+    }
+    if (admission_) {
+        usage.overhead += admission_->memory_usage();
+    }
+    if (ttl_) {
+        usage.overhead += ttl_->memory_usage().total();
+    }
+    return usage;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+MapGetFreshTopK<Key, Tp, Compare, Alloc> MapGetFreshTopK<Key, Tp, Compare, Alloc>::FromMemoryBudget(
+        const std::chrono::duration<double> control_time, const size_t analyzer_memory_budget,
+        const double share_to_be_very_frequent, const double error, const size_t key_bytes) {
+    const AnalyzerSizing sizing = FrequencyEstimationAnalyzer<Key, Compare>::ChooseSizing(
+            analyzer_memory_budget, share_to_be_very_frequent, error, key_bytes);
+    return MapGetFreshTopK(control_time, share_to_be_very_frequent, sizing.num_buckets, sizing.bucket_size);
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::AddKeyToAnalyzer(const Key &key, const uint64_t fingerprint,
+                                                                const int64_t weight, const MapOperation operation) {
+    if (!per_operation_top_k_) {
+        if (async_analyzer_) {
+            async_analyzer_->AddKey(key, weight);
+        } else {
+            analyzer_.AddKeyWithHash(key, fingerprint, weight);
+        }
+        return;
+    }
+    const std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+    if (async_analyzer_) {
+        async_analyzer_->AddKey(key, weight);
+    } else {
+        RotateWithOperations(now);
+        analyzer_.AddKeyWithHash(key, fingerprint, weight, now);
+    }
+    operation_analyzer_.AddKeyWithHash(key, fingerprint, operation, weight, now);
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+uint64_t MapGetFreshTopK<Key, Tp, Compare, Alloc>::AnalyzerEpoch() const {
+    return async_analyzer_ ? async_analyzer_->epoch() : analyzer_.epoch();
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+FrequencyEstimationAnalyzer<Key, Compare> &MapGetFreshTopK<Key, Tp, Compare, Alloc>::SynchronousAnalyzer() {
+    if (async_analyzer_) {
+        throw std::logic_error("MapGetFreshTopK: the analyzer is in async mode");
+    }
+    if (per_operation_top_k_) {
+        RotateWithOperations(std::chrono::system_clock::now());
+    }
+    return analyzer_;
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::RotateWithOperations(const std::chrono::system_clock::time_point now) {
+    operation_analyzer_.Rotate(now);
+    analyzer_.RotateAt(operation_analyzer_.epoch_start());
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::AdmitNewKey(const Key &key) {
+    const FrequencyEstimationAnalyzer<Key, Compare> &analyzer = analyzer_;
+    cache_policy_->Insert(key, [&analyzer](const Key &other) { return analyzer.EstimateFrequency(other); },
+                          evicted_keys_);
+    EraseEvictedKeys();
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+void MapGetFreshTopK<Key, Tp, Compare, Alloc>::EraseEvictedKeys() {
+    for (size_t i = 0; i < evicted_keys_.size(); ++i) {
+        const uint64_t fingerprint = analyzer_.HashKey(evicted_keys_[i]);
+        front_cache_.Erase(evicted_keys_[i], fingerprint);
+        if (replicas_) {
+            replicas_->Erase(evicted_keys_[i], fingerprint);
+        }
+        if (ttl_ && ttl_->MayHaveDeadline(fingerprint)) {
+            ttl_->Cancel(evicted_keys_[i]);
+        }
+        map_.erase(evicted_keys_[i]);
+    }
+    evicted_keys_.clear();
+}
+
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+bool MapGetFreshTopK<Key, Tp, Compare, Alloc>::IsExpired(const Key &key, const uint64_t fingerprint) const {
+    // Keys which have never had a TTL don't read the clock
+    return ttl_ && ttl_->MayHaveDeadline(fingerprint) && ttl_->IsExpired(key, std::chrono::steady_clock::now());
+}
+
+/**
+ *  @brief  MapGetFreshTopK with string keys, the nodes and the characters of keys and values in slab blocks of the
+ *  current thread (look SlabArena): no malloc calls for the data, freed nodes and strings are reused by new ones.
+ *  `set` assigns into the existing value, so a value which fits the capacity of the old one is overwritten in place.
+ *
+ *  @tparam Tp  Type of mapped objects, defaults to ArenaString.
+ */
+template<typename Tp = ArenaString>
+using ArenaMapGetFreshTopK = MapGetFreshTopK<ArenaString, Tp, std::less<ArenaString>,
+        SlabAllocator<std::pair<const ArenaString, Tp>>>;
+
+#endif //VKTEST_MAPGETFRESHTOPK_H
@@ -0,0 +1,140 @@
+// MappedMapGetFreshTopK implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_MAPPED_MAP_GET_FRESH_TOP_K_H
+#define VKTEST_MAPPED_MAP_GET_FRESH_TOP_K_H
+
+#include <string>
+#include <chrono>
+#include <vector>
+#include <exception>
+
+#include "frequency_estimation_analyzer.h"
+#include "mmap_value_store.h"
+
+/**
+ *  @brief A version of MapGetFreshTopK which keeps values in a memory-mapped segment file.
+ *
+ *  @tparam Key  Type of key objects, defaults to std::string
+ *  @tparam Compare  Comparison function object type, defaults to less<Key>.
+ *
+ *  Values are byte strings stored by MmapValueStore: the index stays in memory, the value bytes live in the page
+ *  cache. `get` returns a view into the mapping instead of a reference. Statistics and `get_top_k` are the same as in
+ *  MapGetFreshTopK.
+ */
+template<typename Key = std::string, typename Compare = std::less<Key>>
+class MappedMapGetFreshTopK {
+public:
+    /**
+     *  @brief Memory-mapped map constructor.
+     *
+     *  @param segment_path  Path of the segment file for values. The file is created or truncated.
+     *  @param control_time  Timespan, defaults to 60 seconds.
+     *  @param share_to_be_very_frequent  Share of requests for keys to be
+     *  considered as "very frequent", defaults to 0.1 (10%).
+     *  @param num_buckets  Amount of buckets, defaults to 12.
+     *  @param bucket_size  Size of each bucket, defaults to 54.
+     */
+    explicit MappedMapGetFreshTopK(const std::string &segment_path,
+                                   std::chrono::duration<double> control_time = std::chrono::seconds(60),
+                                   double share_to_be_very_frequent = 0.1, size_t num_buckets = 12,
+                                   size_t bucket_size = 54);
+
+    /**
+     *  @brief  Access to %map data.
+     *  @param  key  The key for which data should be retrieved.
+     *  @param  weight  Weight of the request for the statistics, defaults to 1.
+     *  @return  A view of the value, empty view if the key does not exist.
+     *
+     *  The view is valid until the next `set`/`erase`/`compact` call.
+     *
+     *  Time complexity: O(log(n)), where n - size of the map
+     */
+    MappedValue get(const Key &key, int64_t weight = 1);
+
+    /**
+     *  @brief  Add or change %map data.
+     *  @param  weight  Weight of the request for the statistics, defaults to 1.
+     *
+     *  Time complexity: O(log(n) + value size), amortized.
+     */
+    void set(const Key &key, const std::string &value, int64_t weight = 1);
+
+    bool erase(const Key &key);
+
+    /**
+     *  @brief  Rewrite the segment file with live values only.
+     */
+    void compact();
+
+    /**
+     *  @brief  Vector with frequently asked keys for the last period (look MapGetFreshTopK::get_top_k).
+     */
+    std::vector<Key> get_top_k(const size_t number = 0);
+
+    const MmapValueStore<Key, Compare> &store() const;
+
+private:
+    MmapValueStore<Key, Compare> store_;
+    FrequencyEstimationAnalyzer<Key, Compare> analyzer_;
+};
+
+template<typename Key, typename Compare>
+MappedMapGetFreshTopK<Key, Compare>::MappedMapGetFreshTopK(
+        const std::string &segment_path, const std::chrono::duration<double> control_time,
+        const double share_to_be_very_frequent, const size_t num_buckets, const size_t bucket_size)
+        : store_(segment_path),
+          analyzer_(control_time, share_to_be_very_frequent, num_buckets, bucket_size) {
+};
+
+template<typename Key, typename Compare>
+MappedValue MappedMapGetFreshTopK<Key, Compare>::get(const Key &key, const int64_t weight) {
+    // #sleep well at night
+    try {
+        analyzer_.AddKey(key, weight);
+    } catch (std::exception &e) {
+        // don't try again add this key - an exception is a rare situation, this action doesn't affect statistics
+    }
+
+    return store_.get(key);
+}
+
+template<typename Key, typename Compare>
+void MappedMapGetFreshTopK<Key, Compare>::set(const Key &key, const std::string &value, const int64_t weight) {
+    store_.set(key, value);
+
+    // #sleep well at night
+    try {
+        analyzer_.AddKey(key, weight);
+    } catch (std::exception &e) {
+        // don't try again add this key - an exception is a rare situation, this action doesn't affect statistics
+    }
+}
+
+template<typename Key, typename Compare>
+bool MappedMapGetFreshTopK<Key, Compare>::erase(const Key &key) {
+    return store_.erase(key);
+}
+
+template<typename Key, typename Compare>
+void MappedMapGetFreshTopK<Key, Compare>::compact() {
+    store_.Compact();
+}
+
+template<typename Key, typename Compare>
+std::vector<Key> MappedMapGetFreshTopK<Key, Compare>::get_top_k(const size_t number) {
+    // #sleep well at night
+    try {
+        return analyzer_.GetTopKKeys(number);
+    } catch (std::exception &e) {
+        return std::vector<Key>();
+    }
+}
+
+template<typename Key, typename Compare>
+const MmapValueStore<Key, Compare> &MappedMapGetFreshTopK<Key, Compare>::store() const {
+    return store_;
+}
+
+#endif //VKTEST_MAPPED_MAP_GET_FRESH_TOP_K_H
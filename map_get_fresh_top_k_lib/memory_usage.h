@@ -0,0 +1,83 @@
+// Memory accounting implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_MEMORY_USAGE_H
+#define VKTEST_MEMORY_USAGE_H
+
+#include <map>
+#include <string>
+#include <cstddef>
+
+/**
+ *  @brief  Memory used by a container or an analyzer, in bytes, by component.
+ *
+ *  Numbers are estimates: heap blocks are counted by their requested sizes, allocator headers of tree nodes are
+ *  counted as overhead by the typical 16 bytes.
+ */
+struct MemoryUsage {
+    size_t keys;
+    size_t counters;
+    size_t values;
+    // Indexes, node headers, alignment, filters
+    size_t overhead;
+
+    MemoryUsage() : keys(0), counters(0), values(0), overhead(0) {};
+
+    size_t total() const {
+        return keys + counters + values + overhead;
+    }
+
+    MemoryUsage &operator+=(const MemoryUsage &other) {
+        keys += other.keys;
+        counters += other.counters;
+        values += other.values;
+        overhead += other.overhead;
+        return *this;
+    }
+};
+
+namespace memory_usage_detail {
+
+// Bytes of a red-black tree node besides its value (color, parent, left, right) plus an allocator header
+const size_t kTreeNodeOverhead = 4 * sizeof(void *) + 16;
+
+}
+
+/**
+ *  @brief  Heap memory owned by an object besides sizeof(object): 0 for trivial types.
+ */
+template<typename T>
+size_t HeapBytes(const T &) {
+    return 0;
+}
+
+/**
+ *  @brief  Heap buffer of a string, 0 if the characters are stored inside the object (short string optimization).
+ */
+template<typename CharT, typename Traits, typename Alloc>
+size_t HeapBytes(const std::basic_string<CharT, Traits, Alloc> &string) {
+    const char *data = reinterpret_cast<const char *>(string.data());
+    const char *object = reinterpret_cast<const char *>(&string);
+    if (data >= object && data < object + sizeof(string)) {
+        return 0;
+    }
+    return (string.capacity() + 1) * sizeof(CharT);
+}
+
+/**
+ *  @brief  Memory of a std::map: keys, values and tree nodes. Time complexity: O(n).
+ */
+template<typename Key, typename Tp, typename Compare, typename Alloc>
+MemoryUsage ContainerMemoryUsage(const std::map<Key, Tp, Compare, Alloc> &map) {
+    MemoryUsage usage;
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        usage.keys += sizeof(Key) + HeapBytes(it->first);
+        usage.values += sizeof(Tp) + HeapBytes(it->second);
+    }
+    usage.overhead = sizeof(map) + map.size() * (sizeof(std::pair<const Key, Tp>) - sizeof(Key) - sizeof(Tp) +
+                                                 memory_usage_detail::kTreeNodeOverhead);
+    return usage;
+}
+
+#endif //VKTEST_MEMORY_USAGE_H
@@ -0,0 +1,363 @@
+// MmapValueStore implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_MMAP_VALUE_STORE_H
+#define VKTEST_MMAP_VALUE_STORE_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ *  @brief  Read-only view of a value living inside of the memory-mapped segment.
+ *
+ *  The view is valid until the next `set`, `erase` or `Compact` call of the store it was taken from (the segment may
+ *  be remapped or rewritten).
+ */
+struct MappedValue {
+    const char *data;
+    size_t size;
+
+    MappedValue() : data(nullptr), size(0) {};
+
+    MappedValue(const char *data, size_t size) : data(data), size(size) {};
+
+    bool empty() const {
+        return size == 0;
+    }
+
+    std::string ToString() const {
+        return std::string(data, size);
+    }
+
+    bool operator==(const std::string &other) const {
+        return size == other.size() && (size == 0 || memcmp(data, other.data(), size) == 0);
+    }
+};
+
+/**
+ *  @brief Key-value storage with in-memory index and values in an append-only memory-mapped segment file.
+ *
+ *  @tparam Key  Type of key objects, defaults to std::string
+ *  @tparam Compare  Comparison function object type, defaults to less<Key>.
+ *
+ *  Only the index (key -> offset and length) lives in the heap, the value bytes live in the segment file, so the page
+ *  cache decides which values stay in RAM. Every `set` appends the value to the end of the segment, the old bytes
+ *  become garbage. When the garbage share exceeds `compaction_threshold`, the segment is rewritten with live values
+ *  only (the same happens on an explicit `Compact` call).
+ *
+ *  The segment is a scratch file: it is truncated on construction and is not recovered after restart.
+ */
+template<typename Key = std::string, typename Compare = std::less<Key>>
+class MmapValueStore {
+public:
+    /**
+     *  @brief Memory-mapped value store constructor.
+     *
+     *  @param path  Path of the segment file. The file is created or truncated.
+     *  @param initial_capacity  Initial size of the segment in bytes, defaults to 1 MiB.
+     *  @param compaction_threshold  Share of garbage bytes in the segment which triggers compaction on `set`, defaults
+     *  to 0.5 (50%). Set it to 1 or more to compact only by explicit `Compact` calls.
+     */
+    explicit MmapValueStore(const std::string &path, size_t initial_capacity = 1 << 20,
+                            double compaction_threshold = 0.5);
+
+    ~MmapValueStore();
+
+    MmapValueStore(const MmapValueStore &) = delete;
+
+    MmapValueStore &operator=(const MmapValueStore &) = delete;
+
+    /**
+     *  @brief  Access to the value.
+     *  @param  key  The key for which data should be retrieved.
+     *  @return  View into the mapping, empty view if the key does not exist.
+     *
+     *  Time complexity: O(log(n)), where n - number of keys.
+     */
+    MappedValue get(const Key &key) const;
+
+    /**
+     *  @brief  Add or change the value.
+     *  @param  key  The key for which data should be added or changed.
+     *  @param  data  Pointer to value bytes.
+     *  @param  size  Number of value bytes.
+     *
+     *  Invalidates all views. Throws std::system_error if the segment cannot grow.
+     *
+     *  Time complexity: O(log(n) + size), amortized.
+     */
+    void set(const Key &key, const char *data, size_t size);
+
+    void set(const Key &key, const std::string &value);
+
+    /**
+     *  @brief  Remove the key. Returns true if the key existed.
+     */
+    bool erase(const Key &key);
+
+    bool contains(const Key &key) const;
+
+    size_t size() const;
+
+    /**
+     *  @brief  Number of bytes of live values.
+     */
+    size_t live_bytes() const;
+
+    /**
+     *  @brief  Number of used bytes of the segment (live values and garbage).
+     */
+    size_t segment_bytes() const;
+
+    /**
+     *  @brief  Rewrite the segment with live values only.
+     *
+     *  Invalidates all views. Time complexity: O(n + live_bytes).
+     */
+    void Compact();
+
+private:
+    struct Slot {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    static char *Map(int fd, size_t capacity);
+
+    void Unmap();
+
+    void Reserve(size_t bytes);
+
+    void MaybeCompact();
+
+    static int OpenSegment(const std::string &path);
+
+    static void ThrowSystemError(const char *what, int error = errno);
+
+    const std::string path_;
+    const double compaction_threshold_;
+
+    std::map<Key, Slot, Compare> index_;
+    int fd_;
+    char *base_;
+    size_t capacity_;
+    size_t end_;
+    size_t live_bytes_;
+};
+
+template<typename Key, typename Compare>
+MmapValueStore<Key, Compare>::MmapValueStore(const std::string &path, const size_t initial_capacity,
+                                             const double compaction_threshold)
+        : path_(path), compaction_threshold_(compaction_threshold), index_(), fd_(OpenSegment(path)),
+          base_(nullptr), capacity_(0), end_(0), live_bytes_(0) {
+    try {
+        capacity_ = std::max<size_t>(initial_capacity, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+        base_ = Map(fd_, capacity_);
+    } catch (...) {
+        close(fd_);
+        throw;
+    }
+}
+
+template<typename Key, typename Compare>
+MmapValueStore<Key, Compare>::~MmapValueStore() {
+    Unmap();
+    close(fd_);
+}
+
+template<typename Key, typename Compare>
+MappedValue MmapValueStore<Key, Compare>::get(const Key &key) const {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return MappedValue();
+    }
+    return MappedValue(base_ + it->second.offset, it->second.length);
+}
+
+template<typename Key, typename Compare>
+void MmapValueStore<Key, Compare>::set(const Key &key, const char *data, const size_t size) {
+    // A view of this store is unmapped by Reserve, so it is kept as an offset
+    const bool inside = data >= base_ && data < base_ + end_;
+    const size_t data_offset = inside ? static_cast<size_t>(data - base_) : 0;
+    Reserve(size);
+    if (inside) {
+        data = base_ + data_offset;
+    }
+    if (size > 0) {
+        memcpy(base_ + end_, data, size);
+    }
+
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        live_bytes_ -= it->second.length;
+        it->second.offset = end_;
+        it->second.length = size;
+    } else {
+        index_.emplace(key, Slot{end_, size});
+    }
+    end_ += size;
+    live_bytes_ += size;
+
+    MaybeCompact();
+}
+
+template<typename Key, typename Compare>
+void MmapValueStore<Key, Compare>::set(const Key &key, const std::string &value) {
+    set(key, value.data(), value.size());
+}
+
+template<typename Key, typename Compare>
+bool MmapValueStore<Key, Compare>::erase(const Key &key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return false;
+    }
+    live_bytes_ -= it->second.length;
+    index_.erase(it);
+    MaybeCompact();
+    return true;
+}
+
+template<typename Key, typename Compare>
+bool MmapValueStore<Key, Compare>::contains(const Key &key) const {
+    return index_.find(key) != index_.end();
+}
+
+template<typename Key, typename Compare>
+size_t MmapValueStore<Key, Compare>::size() const {
+    return index_.size();
+}
+
+template<typename Key, typename Compare>
+size_t MmapValueStore<Key, Compare>::live_bytes() const {
+    return live_bytes_;
+}
+
+template<typename Key, typename Compare>
+size_t MmapValueStore<Key, Compare>::segment_bytes() const {
+    return end_;
+}
+
+template<typename Key, typename Compare>
+void MmapValueStore<Key, Compare>::Compact() {
+    const std::string compact_path = path_ + ".compact";
+    const int compact_fd = OpenSegment(compact_path);
+    const size_t compact_capacity = std::max(live_bytes_, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+
+    // Values are copied in index order, the new offsets are applied only after the rename succeeded
+    std::vector<uint64_t> new_offsets;
+    new_offsets.reserve(index_.size());
+    char *compact_base;
+    try {
+        compact_base = Map(compact_fd, compact_capacity);
+    } catch (...) {
+        close(compact_fd);
+        unlink(compact_path.c_str());
+        throw;
+    }
+
+    uint64_t compact_end = 0;
+    for (auto it = index_.begin(); it != index_.end(); ++it) {
+        if (it->second.length > 0) {
+            memcpy(compact_base + compact_end, base_ + it->second.offset, it->second.length);
+        }
+        new_offsets.push_back(compact_end);
+        compact_end += it->second.length;
+    }
+    if (rename(compact_path.c_str(), path_.c_str()) != 0) {
+        // The cleanup below may change errno
+        const int error = errno;
+        munmap(compact_base, compact_capacity);
+        close(compact_fd);
+        unlink(compact_path.c_str());
+        ThrowSystemError("MmapValueStore: cannot replace segment", error);
+    }
+
+    Unmap();
+    close(fd_);
+    fd_ = compact_fd;
+    base_ = compact_base;
+    capacity_ = compact_capacity;
+
+    size_t i = 0;
+    for (auto it = index_.begin(); it != index_.end(); ++it, ++i) {
+        it->second.offset = new_offsets[i];
+    }
+    end_ = compact_end;
+}
+
+template<typename Key, typename Compare>
+char *MmapValueStore<Key, Compare>::Map(const int fd, const size_t capacity) {
+    if (ftruncate(fd, static_cast<off_t>(capacity)) != 0) {
+        ThrowSystemError("MmapValueStore: cannot resize segment");
+    }
+    void *base = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        ThrowSystemError("MmapValueStore: cannot map segment");
+    }
+    return static_cast<char *>(base);
+}
+
+template<typename Key, typename Compare>
+void MmapValueStore<Key, Compare>::Unmap() {
+    if (base_ != nullptr) {
+        munmap(base_, capacity_);
+        base_ = nullptr;
+        capacity_ = 0;
+    }
+}
+
+template<typename Key, typename Compare>
+void MmapValueStore<Key, Compare>::Reserve(const size_t bytes) {
+    if (end_ + bytes <= capacity_) {
+        return;
+    }
+    size_t new_capacity = capacity_;
+    while (new_capacity < end_ + bytes) {
+        new_capacity *= 2;
+    }
+    // The old mapping stays valid until the new one is ready
+    char *new_base = Map(fd_, new_capacity);
+    Unmap();
+    base_ = new_base;
+    capacity_ = new_capacity;
+}
+
+template<typename Key, typename Compare>
+void MmapValueStore<Key, Compare>::MaybeCompact() {
+    const size_t garbage = end_ - live_bytes_;
+    // Small segments are not worth rewriting
+    if (end_ >= static_cast<size_t>(sysconf(_SC_PAGESIZE)) && (double) garbage > (double) end_ * compaction_threshold_) {
+        Compact();
+    }
+}
+
+template<typename Key, typename Compare>
+int MmapValueStore<Key, Compare>::OpenSegment(const std::string &path) {
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        ThrowSystemError("MmapValueStore: cannot open segment");
+    }
+    return fd;
+}
+
+template<typename Key, typename Compare>
+void MmapValueStore<Key, Compare>::ThrowSystemError(const char *what, const int error) {
+    throw std::system_error(error, std::generic_category(), what);
+}
+
+#endif //VKTEST_MMAP_VALUE_STORE_H
@@ -0,0 +1,235 @@
+// MultiDimensionalFrequencyEstimationAnalyzer implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_MULTI_DIMENSIONAL_FREQUENCY_ESTIMATION_ANALYZER_H
+#define VKTEST_MULTI_DIMENSIONAL_FREQUENCY_ESTIMATION_ANALYZER_H
+
+#include <map>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <stdexcept>
+#include <functional>
+
+#include "frequency_estimation_analyzer.h"
+#include "integer_keys.h"
+#include "memory_usage.h"
+
+/**
+ *  @brief Very frequent keys per dimension of requests (operation type, tenant, operation x tenant) and overall.
+ *
+ *  @tparam Key  Type of key objects.
+ *  @tparam Dimension  Type of dimensions, e.g. std::pair<Operation, TenantId>.
+ *  @tparam Compare  Comparison function object type, defaults to less<Key>.
+ *  @tparam Hash  Hash function object type, defaults to DefaultKeyHash<Key>.
+ *  @tparam DimensionCompare  Comparison function object type of dimensions, defaults to less<Dimension>.
+ *
+ *  Every dimension has its own FrequencyEstimationAnalyzer (created with the first request of the dimension), so a
+ *  10% key of a small tenant is found even if it is lost in the whole traffic. The epochs are driven by this class:
+ *  they begin at the multiples of control_time / num_buckets since the clock epoch, and at a boundary all the
+ *  analyzers are rotated together (FrequencyEstimationAnalyzer::RotateAt), a new dimension joins the current epoch.
+ *  So a request checks the boundary once and then updates the counters of its dimension and of the global top.
+ */
+template<typename Key, typename Dimension, typename Compare = std::less<Key>, typename Hash = DefaultKeyHash<Key>,
+        typename DimensionCompare = std::less<Dimension>>
+class MultiDimensionalFrequencyEstimationAnalyzer {
+public:
+    typedef FrequencyEstimationAnalyzer<Key, Compare, Hash> Analyzer;
+
+    /**
+     *  @brief Analyzer constructor.
+     *
+     *  @param control_time, share_very_frequent, num_buckets, bucket_size  Configuration of the analyzer of every
+     *  dimension (look FrequencyEstimationAnalyzer).
+     *  @param track_global  Keep the top of all requests too, defaults to true.
+     */
+    explicit MultiDimensionalFrequencyEstimationAnalyzer(
+            std::chrono::duration<double> control_time = std::chrono::seconds(60), double share_very_frequent = 0.1,
+            size_t num_buckets = 12, size_t bucket_size = 54, bool track_global = true);
+
+    /**
+     *  @brief  Transfer information about a newly added key of the dimension.
+     *
+     *  Time complexity: O(log(number of dimensions)) plus the counter updates of the dimension and of the global top,
+     *  O(number of dimensions) rotations at an epoch boundary.
+     */
+    void AddKey(const Key &key, const Dimension &dimension, int64_t weight = 1);
+
+    /**
+     *  @brief  AddKey with the fingerprint (`HashKey`) and the time computed by the caller.
+     */
+    void AddKeyWithHash(const Key &key, uint64_t fingerprint, const Dimension &dimension, int64_t weight,
+                        std::chrono::system_clock::time_point now);
+
+    /**
+     *  @brief  Very frequent keys of the dimension, look FrequencyEstimationAnalyzer::GetTopKKeys. Empty for a
+     *  dimension without requests.
+     */
+    std::vector<Key> GetTopKKeys(const Dimension &dimension, int number = 0);
+
+    /**
+     *  @brief  Very frequent keys of all requests, throws std::logic_error if the global top is not tracked.
+     */
+    std::vector<Key> GetGlobalTopKKeys(int number = 0);
+
+    /**
+     *  @brief  Start the epoch of `now` for all the analyzers if it has begun. Called by AddKey and the tops, an
+     *  owner of another analyzer rotates it together with `RotateAt(epoch_start())`.
+     */
+    void Rotate(std::chrono::system_clock::time_point now);
+
+    /**
+     *  @brief  Beginning of the current epoch.
+     */
+    std::chrono::system_clock::time_point epoch_start() const {
+        return epoch_start_;
+    }
+
+    /**
+     *  @brief  Dimensions which have had requests, in DimensionCompare order.
+     */
+    std::vector<Dimension> dimensions() const;
+
+    uint64_t HashKey(const Key &key) const {
+        return static_cast<uint64_t>(hash_(key));
+    }
+
+    MemoryUsage memory_usage() const;
+
+private:
+    Analyzer &DimensionAnalyzer(const Dimension &dimension);
+
+    const std::chrono::duration<double> control_time_;
+    const double share_very_frequent_;
+    const size_t num_buckets_;
+    const size_t bucket_size_;
+    const Hash hash_;
+    // Rounded to clock ticks, so the boundaries are exact
+    const std::chrono::system_clock::duration epoch_length_;
+    // Number of the current epoch since the clock epoch, -1 before the first one
+    int64_t epoch_index_;
+    std::chrono::system_clock::time_point epoch_start_;
+
+    // nullptr if the global top is not tracked
+    std::unique_ptr<Analyzer> global_;
+    std::map<Dimension, Analyzer, DimensionCompare> dimensions_;
+};
+
+template<typename Key, typename Dimension, typename Compare, typename Hash, typename DimensionCompare>
+MultiDimensionalFrequencyEstimationAnalyzer<Key, Dimension, Compare, Hash, DimensionCompare>::
+MultiDimensionalFrequencyEstimationAnalyzer(const std::chrono::duration<double> control_time,
+                                            const double share_very_frequent, const size_t num_buckets,
+                                            const size_t bucket_size, const bool track_global)
+        : control_time_(control_time), share_very_frequent_(share_very_frequent), num_buckets_(num_buckets),
+          bucket_size_(bucket_size), hash_(), epoch_length_(std::max(
+                  std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                          control_time / num_buckets +
+                          std::chrono::duration<double, std::chrono::system_clock::period>(0.5)),
+                  std::chrono::system_clock::duration(1))), epoch_index_(-1),
+          epoch_start_(),
+          global_(track_global ? new Analyzer(control_time, share_very_frequent, num_buckets, bucket_size) : nullptr),
+          dimensions_() {
+}
+
+template<typename Key, typename Dimension, typename Compare, typename Hash, typename DimensionCompare>
+void MultiDimensionalFrequencyEstimationAnalyzer<Key, Dimension, Compare, Hash, DimensionCompare>::AddKey(
+        const Key &key, const Dimension &dimension, const int64_t weight) {
+    AddKeyWithHash(key, HashKey(key), dimension, weight, std::chrono::system_clock::now());
+}
+
+template<typename Key, typename Dimension, typename Compare, typename Hash, typename DimensionCompare>
+void MultiDimensionalFrequencyEstimationAnalyzer<Key, Dimension, Compare, Hash, DimensionCompare>::AddKeyWithHash(
+        const Key &key, const uint64_t fingerprint, const Dimension &dimension, const int64_t weight,
+        const std::chrono::system_clock::time_point now) {
+    if (weight < 1) {
+        throw std::invalid_argument("MultiDimensionalFrequencyEstimationAnalyzer: weight of a request must be "
+                                    "positive");
+    }
+    Rotate(now);
+    DimensionAnalyzer(dimension).AddKeyWithHash(key, fingerprint, weight, now);
+    if (global_) {
+        global_->AddKeyWithHash(key, fingerprint, weight, now);
+    }
+}
+
+template<typename Key, typename Dimension, typename Compare, typename Hash, typename DimensionCompare>
+std::vector<Key> MultiDimensionalFrequencyEstimationAnalyzer<Key, Dimension, Compare, Hash, DimensionCompare>::
+GetTopKKeys(const Dimension &dimension, const int number) {
+    Rotate(std::chrono::system_clock::now());
+    auto it = dimensions_.find(dimension);
+    if (it == dimensions_.end()) {
+        return std::vector<Key>();
+    }
+    return it->second.GetTopKKeys(number);
+}
+
+template<typename Key, typename Dimension, typename Compare, typename Hash, typename DimensionCompare>
+std::vector<Key> MultiDimensionalFrequencyEstimationAnalyzer<Key, Dimension, Compare, Hash, DimensionCompare>::
+GetGlobalTopKKeys(const int number) {
+    if (!global_) {
+        throw std::logic_error("MultiDimensionalFrequencyEstimationAnalyzer: the global top is not tracked");
+    }
+    Rotate(std::chrono::system_clock::now());
+    return global_->GetTopKKeys(number);
+}
+
+template<typename Key, typename Dimension, typename Compare, typename Hash, typename DimensionCompare>
+void MultiDimensionalFrequencyEstimationAnalyzer<Key, Dimension, Compare, Hash, DimensionCompare>::Rotate(
+        const std::chrono::system_clock::time_point now) {
+    const int64_t epoch_index = static_cast<int64_t>(now.time_since_epoch() / epoch_length_);
+    if (epoch_index <= epoch_index_) {
+        return;
+    }
+    epoch_index_ = epoch_index;
+    epoch_start_ = std::chrono::system_clock::time_point(epoch_length_ * epoch_index);
+    if (global_) {
+        global_->RotateAt(epoch_start_);
+    }
+    for (auto it = dimensions_.begin(); it != dimensions_.end(); ++it) {
+        it->second.RotateAt(epoch_start_);
+    }
+}
+
+template<typename Key, typename Dimension, typename Compare, typename Hash, typename DimensionCompare>
+std::vector<Dimension> MultiDimensionalFrequencyEstimationAnalyzer<Key, Dimension, Compare, Hash, DimensionCompare>::
+dimensions() const {
+    std::vector<Dimension> result;
+    for (auto it = dimensions_.begin(); it != dimensions_.end(); ++it) {
+        result.push_back(it->first);
+    }
+    return result;
+}
+
+template<typename Key, typename Dimension, typename Compare, typename Hash, typename DimensionCompare>
+MemoryUsage MultiDimensionalFrequencyEstimationAnalyzer<Key, Dimension, Compare, Hash, DimensionCompare>::
+memory_usage() const {
+    MemoryUsage usage;
+    if (global_) {
+        usage += global_->memory_usage();
+    }
+    for (auto it = dimensions_.begin(); it != dimensions_.end(); ++it) {
+        usage += it->second.memory_usage();
+        usage.overhead += sizeof(Dimension) + HeapBytes(it->first) + memory_usage_detail::kTreeNodeOverhead;
+    }
+    usage.overhead += sizeof(*this);
+    return usage;
+}
+
+template<typename Key, typename Dimension, typename Compare, typename Hash, typename DimensionCompare>
+typename MultiDimensionalFrequencyEstimationAnalyzer<Key, Dimension, Compare, Hash, DimensionCompare>::Analyzer &
+MultiDimensionalFrequencyEstimationAnalyzer<Key, Dimension, Compare, Hash, DimensionCompare>::DimensionAnalyzer(
+        const Dimension &dimension) {
+    auto it = dimensions_.find(dimension);
+    if (it == dimensions_.end()) {
+        it = dimensions_.insert(std::make_pair(
+                dimension, Analyzer(control_time_, share_very_frequent_, num_buckets_, bucket_size_))).first;
+        it->second.RotateAt(epoch_start_);
+    }
+    return it->second;
+}
+
+#endif //VKTEST_MULTI_DIMENSIONAL_FREQUENCY_ESTIMATION_ANALYZER_H
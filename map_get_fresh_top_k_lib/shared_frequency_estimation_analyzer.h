@@ -0,0 +1,458 @@
+// SharedFrequencyEstimationAnalyzer implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_SHARED_FREQUENCY_ESTIMATION_ANALYZER_H
+#define VKTEST_SHARED_FREQUENCY_ESTIMATION_ANALYZER_H
+
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "SharedFrequencyEstimationAnalyzer needs address-free (lock-free) atomics");
+
+/**
+ *  @brief Duplicate key request frequency analyzer shared by processes of one host.
+ *
+ *  The same algorithm as FrequencyEstimationAnalyzer, but the buckets, counters and interned keys live in a POSIX
+ *  shared memory segment with fixed-size layout, so all pre-forked worker processes update one analyzer and any of
+ *  them can answer `GetTopKKeys` for the whole host.
+ *
+ *  Buckets form a ring of `num_buckets + 1` slots indexed by epoch number (epoch = control_time / num_buckets): the
+ *  bucket of epoch t keeps statistics since the beginning of t, a bucket of an expired epoch is reset by the first
+ *  process which needs it. Every bucket is guarded by its own robust process-shared mutex in the segment: if a
+ *  process dies while holding it (e.g. killed in the middle of `AddKey`), the next process which locks the bucket
+ *  resets it, so the statistics of one epoch are lost instead of the host hanging.
+ *
+ *  Keys are std::string up to `max_key_length` bytes, they are copied into the segment. Longer keys are counted as
+ *  requests but are never reported.
+ */
+class SharedFrequencyEstimationAnalyzer {
+public:
+    /**
+     *  @brief Create the shared segment or attach to the existing one.
+     *
+     *  @param name  Name of the POSIX shared memory object, e.g. "/my_service_top_k".
+     *  @param control_time  Timespan, defaults to 60 seconds.
+     *  @param share_very_frequent  Share of requests for keys to be considered as "very frequent", defaults to 0.1
+     *  (10%).
+     *  @param num_buckets  Amount of buckets, defaults to 12.
+     *  @param bucket_size  Size of each bucket, defaults to 54.
+     *  @param max_key_length  Maximum length of tracked keys, defaults to 64.
+     *
+     *  Throws std::system_error if the segment cannot be created or mapped, std::invalid_argument if the existing
+     *  segment has another configuration, std::runtime_error if the existing segment isn't initialized in a few
+     *  seconds or its creator has died before initializing it (then `Unlink` it).
+     */
+    explicit SharedFrequencyEstimationAnalyzer(const std::string &name,
+                                               std::chrono::duration<double> control_time = std::chrono::seconds(60),
+                                               double share_very_frequent = 0.1, size_t num_buckets = 12,
+                                               size_t bucket_size = 54, size_t max_key_length = 64);
+
+    ~SharedFrequencyEstimationAnalyzer();
+
+    SharedFrequencyEstimationAnalyzer(const SharedFrequencyEstimationAnalyzer &) = delete;
+
+    SharedFrequencyEstimationAnalyzer &operator=(const SharedFrequencyEstimationAnalyzer &) = delete;
+
+    /**
+     *  @brief  Transfer information about a newly added key.
+     *
+     *  Time complexity: O(num_buckets * bucket_size).
+     */
+    void AddKey(const std::string &key);
+
+    /**
+     *  @brief  Get vector of very frequently asked keys (>= ~10%) of all processes for the last time.
+     *
+     *  Look FrequencyEstimationAnalyzer::GetTopKKeys.
+     */
+    std::vector<std::string> GetTopKKeys(int number = 0);
+
+    /**
+     *  @brief  Remove the shared memory object. Attached analyzers keep working with their mapping.
+     */
+    static void Unlink(const std::string &name);
+
+private:
+    static const uint64_t kMagic = 0x4b504f5448524853; // "SHRHTOPK"
+
+    struct SegmentHeader {
+        uint64_t magic;
+        uint64_t buckets_count;
+        uint64_t bucket_size;
+        uint64_t max_key_length;
+        int64_t epoch_duration_ns;
+        double share_very_frequent;
+        // Set by the creator first, so openers can tell a slow creator from a dead one
+        std::atomic<int32_t> creator_pid;
+        std::atomic<uint32_t> ready;
+    };
+
+    struct BucketHeader {
+        pthread_mutex_t mutex;
+        std::atomic<int64_t> epoch;
+        std::atomic<int64_t> add_new_key_count;
+        std::atomic<int64_t> size;
+    };
+
+    struct SlotHeader {
+        std::atomic<uint64_t> fingerprint;
+        std::atomic<int64_t> count;
+        std::atomic<uint32_t> key_length;
+    };
+
+    // Guards one bucket for the lifetime of the object, resets the bucket left locked by a dead process
+    class BucketLock {
+    public:
+        explicit BucketLock(BucketHeader *bucket);
+
+        ~BucketLock();
+
+    private:
+        BucketHeader *bucket_;
+    };
+
+    // Openers wait for the creator to initialize the segment for two seconds
+    static std::chrono::steady_clock::time_point InitializationDeadline();
+
+    // Wait for the creator of the segment, throws std::runtime_error if it has died or is too slow
+    static void WaitForInitialization(SegmentHeader *header);
+
+    static void InitializeMutex(pthread_mutex_t *mutex);
+
+    int64_t CurrentEpoch() const;
+
+    BucketHeader *Bucket(int64_t epoch) const;
+
+    SlotHeader *Slot(BucketHeader *bucket, size_t index) const;
+
+    char *SlotKey(SlotHeader *slot) const;
+
+    // Must be called under the bucket lock
+    void ResetIfExpired(BucketHeader *bucket, int64_t epoch) const;
+
+    void AddKeyToBucket(BucketHeader *bucket, uint64_t fingerprint, const std::string &key) const;
+
+    static uint64_t Fingerprint(const std::string &key);
+
+    const size_t buckets_count_;
+    const size_t bucket_size_;
+    const size_t max_key_length_;
+    const double share_very_frequent_;
+    const int64_t epoch_duration_ns_;
+    const size_t slot_stride_;
+    const size_t bucket_stride_;
+    const size_t segment_size_;
+
+    int fd_;
+    char *base_;
+};
+
+inline SharedFrequencyEstimationAnalyzer::SharedFrequencyEstimationAnalyzer(
+        const std::string &name, const std::chrono::duration<double> control_time, const double share_very_frequent,
+        const size_t num_buckets, const size_t bucket_size, const size_t max_key_length)
+        : buckets_count_(num_buckets + 1), bucket_size_(bucket_size), max_key_length_(max_key_length),
+          share_very_frequent_(share_very_frequent),
+          epoch_duration_ns_(std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  control_time / num_buckets).count())),
+          slot_stride_((sizeof(SlotHeader) + max_key_length + 7) / 8 * 8),
+          bucket_stride_(sizeof(BucketHeader) + bucket_size * slot_stride_),
+          segment_size_(sizeof(SegmentHeader) + buckets_count_ * bucket_stride_),
+          fd_(-1), base_(nullptr) {
+    bool created = true;
+    fd_ = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd_ < 0 && errno == EEXIST) {
+        created = false;
+        fd_ = shm_open(name.c_str(), O_RDWR, 0600);
+    }
+    if (fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "SharedFrequencyEstimationAnalyzer: shm_open");
+    }
+
+    if (created && ftruncate(fd_, static_cast<off_t>(segment_size_)) != 0) {
+        const int error = errno;
+        close(fd_);
+        shm_unlink(name.c_str());
+        throw std::system_error(error, std::generic_category(), "SharedFrequencyEstimationAnalyzer: ftruncate");
+    }
+    if (!created) {
+        // The creator may still be inside of ftruncate
+        const std::chrono::steady_clock::time_point deadline = InitializationDeadline();
+        struct stat info;
+        while (fstat(fd_, &info) == 0 && info.st_size == 0) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                close(fd_);
+                throw std::runtime_error("SharedFrequencyEstimationAnalyzer: the segment has not been initialized");
+            }
+            std::this_thread::yield();
+        }
+        if (info.st_size != static_cast<off_t>(segment_size_)) {
+            close(fd_);
+            throw std::invalid_argument("SharedFrequencyEstimationAnalyzer: segment has another configuration");
+        }
+    }
+
+    void *base = mmap(nullptr, segment_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (base == MAP_FAILED) {
+        const int error = errno;
+        close(fd_);
+        throw std::system_error(error, std::generic_category(), "SharedFrequencyEstimationAnalyzer: mmap");
+    }
+    base_ = static_cast<char *>(base);
+
+    SegmentHeader *header = reinterpret_cast<SegmentHeader *>(base_);
+    if (created) {
+        new(&header->creator_pid) std::atomic<int32_t>(static_cast<int32_t>(getpid()));
+        // A fresh segment is zero-filled: construct the atomics and mark every bucket as belonging to no epoch
+        for (size_t i = 0; i < buckets_count_; ++i) {
+            BucketHeader *bucket = reinterpret_cast<BucketHeader *>(base_ + sizeof(SegmentHeader) + i * bucket_stride_);
+            try {
+                InitializeMutex(&bucket->mutex);
+            } catch (...) {
+                munmap(base_, segment_size_);
+                close(fd_);
+                shm_unlink(name.c_str());
+                throw;
+            }
+            new(&bucket->epoch) std::atomic<int64_t>(-1);
+            new(&bucket->add_new_key_count) std::atomic<int64_t>(0);
+            new(&bucket->size) std::atomic<int64_t>(0);
+        }
+        header->magic = kMagic;
+        header->buckets_count = buckets_count_;
+        header->bucket_size = bucket_size_;
+        header->max_key_length = max_key_length_;
+        header->epoch_duration_ns = epoch_duration_ns_;
+        header->share_very_frequent = share_very_frequent_;
+        new(&header->ready) std::atomic<uint32_t>(0);
+        header->ready.store(1, std::memory_order_release);
+    } else {
+        try {
+            WaitForInitialization(header);
+        } catch (...) {
+            munmap(base_, segment_size_);
+            close(fd_);
+            throw;
+        }
+        if (header->magic != kMagic || header->buckets_count != buckets_count_ ||
+            header->bucket_size != bucket_size_ || header->max_key_length != max_key_length_ ||
+            header->epoch_duration_ns != epoch_duration_ns_ || header->share_very_frequent != share_very_frequent_) {
+            munmap(base_, segment_size_);
+            close(fd_);
+            throw std::invalid_argument("SharedFrequencyEstimationAnalyzer: segment has another configuration");
+        }
+    }
+}
+
+inline SharedFrequencyEstimationAnalyzer::~SharedFrequencyEstimationAnalyzer() {
+    munmap(base_, segment_size_);
+    close(fd_);
+}
+
+inline void SharedFrequencyEstimationAnalyzer::AddKey(const std::string &key) {
+    const int64_t now_epoch = CurrentEpoch();
+    const uint64_t fingerprint = Fingerprint(key);
+    for (size_t i = 0; i < buckets_count_; ++i) {
+        const int64_t epoch = now_epoch - static_cast<int64_t>(i);
+        BucketHeader *bucket = Bucket(epoch);
+        BucketLock lock(bucket);
+        ResetIfExpired(bucket, epoch);
+        bucket->add_new_key_count.fetch_add(1, std::memory_order_relaxed);
+        if (key.size() <= max_key_length_) {
+            AddKeyToBucket(bucket, fingerprint, key);
+        }
+    }
+}
+
+inline std::vector<std::string> SharedFrequencyEstimationAnalyzer::GetTopKKeys(const int number) {
+    const int64_t oldest_epoch = CurrentEpoch() - static_cast<int64_t>(buckets_count_) + 1;
+    BucketHeader *bucket = Bucket(oldest_epoch);
+
+    std::vector<std::pair<int64_t, std::string>> bucket_vector;
+    int64_t n;
+    {
+        BucketLock lock(bucket);
+        ResetIfExpired(bucket, oldest_epoch);
+        n = bucket->add_new_key_count.load(std::memory_order_relaxed);
+        const int64_t size = bucket->size.load(std::memory_order_relaxed);
+        for (int64_t i = 0; i < size; ++i) {
+            SlotHeader *slot = Slot(bucket, i);
+            bucket_vector.emplace_back(slot->count.load(std::memory_order_relaxed),
+                                       std::string(SlotKey(slot), slot->key_length.load(std::memory_order_relaxed)));
+        }
+    }
+
+    std::sort(bucket_vector.begin(), bucket_vector.end(),
+              [](const std::pair<int64_t, std::string> &left, const std::pair<int64_t, std::string> &right) {
+                  return left.first > right.first;
+              });
+
+    std::vector<std::string> result;
+    const double min_num = floor((double) n * share_very_frequent_) -
+                           ceil((double) n * (1 - share_very_frequent_) / (double) bucket_size_) - 2;
+    for (size_t i = 0; i < bucket_vector.size(); ++i) {
+        if (number == 0 ? bucket_vector[i].first < min_num : i >= static_cast<size_t>(number)) {
+            break;
+        }
+        result.push_back(bucket_vector[i].second);
+    }
+    return result;
+}
+
+inline void SharedFrequencyEstimationAnalyzer::Unlink(const std::string &name) {
+    shm_unlink(name.c_str());
+}
+
+inline SharedFrequencyEstimationAnalyzer::BucketLock::BucketLock(BucketHeader *bucket) : bucket_(bucket) {
+    const int error = pthread_mutex_lock(&bucket_->mutex);
+    if (error == EOWNERDEAD) {
+        // The owner has died in the middle of an update: the bucket may be inconsistent, so it belongs to no epoch now
+        bucket_->epoch.store(-1, std::memory_order_relaxed);
+        bucket_->add_new_key_count.store(0, std::memory_order_relaxed);
+        bucket_->size.store(0, std::memory_order_relaxed);
+        pthread_mutex_consistent(&bucket_->mutex);
+    } else if (error != 0) {
+        throw std::system_error(error, std::generic_category(), "SharedFrequencyEstimationAnalyzer: lock");
+    }
+}
+
+inline SharedFrequencyEstimationAnalyzer::BucketLock::~BucketLock() {
+    pthread_mutex_unlock(&bucket_->mutex);
+}
+
+inline std::chrono::steady_clock::time_point SharedFrequencyEstimationAnalyzer::InitializationDeadline() {
+    return std::chrono::steady_clock::now() + std::chrono::seconds(2);
+}
+
+inline void SharedFrequencyEstimationAnalyzer::WaitForInitialization(SegmentHeader *header) {
+    const std::chrono::steady_clock::time_point deadline = InitializationDeadline();
+    while (header->ready.load(std::memory_order_acquire) == 0) {
+        const pid_t creator = header->creator_pid.load(std::memory_order_relaxed);
+        if (creator != 0 && kill(creator, 0) != 0 && errno == ESRCH) {
+            throw std::runtime_error("SharedFrequencyEstimationAnalyzer: the creator of the segment has died");
+        }
+        if (std::chrono::steady_clock::now() > deadline) {
+            throw std::runtime_error("SharedFrequencyEstimationAnalyzer: the segment has not been initialized");
+        }
+        std::this_thread::yield();
+    }
+}
+
+inline void SharedFrequencyEstimationAnalyzer::InitializeMutex(pthread_mutex_t *mutex) {
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+    const int error = pthread_mutex_init(mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+    if (error != 0) {
+        throw std::system_error(error, std::generic_category(), "SharedFrequencyEstimationAnalyzer: mutex");
+    }
+}
+
+inline int64_t SharedFrequencyEstimationAnalyzer::CurrentEpoch() const {
+    // system_clock is the same for all processes of the host, unlike e.g. steady_clock of some platforms
+    const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    return now_ns / epoch_duration_ns_;
+}
+
+inline SharedFrequencyEstimationAnalyzer::BucketHeader *SharedFrequencyEstimationAnalyzer::Bucket(
+        const int64_t epoch) const {
+    const size_t index = static_cast<size_t>(epoch % static_cast<int64_t>(buckets_count_));
+    return reinterpret_cast<BucketHeader *>(base_ + sizeof(SegmentHeader) + index * bucket_stride_);
+}
+
+inline SharedFrequencyEstimationAnalyzer::SlotHeader *SharedFrequencyEstimationAnalyzer::Slot(
+        BucketHeader *bucket, const size_t index) const {
+    return reinterpret_cast<SlotHeader *>(reinterpret_cast<char *>(bucket) + sizeof(BucketHeader) +
+                                          index * slot_stride_);
+}
+
+inline char *SharedFrequencyEstimationAnalyzer::SlotKey(SlotHeader *slot) const {
+    return reinterpret_cast<char *>(slot) + sizeof(SlotHeader);
+}
+
+inline void SharedFrequencyEstimationAnalyzer::ResetIfExpired(BucketHeader *bucket, const int64_t epoch) const {
+    // Nobody has touched the bucket since the beginning of `epoch`, so it has no requests of `epoch` yet
+    if (bucket->epoch.load(std::memory_order_relaxed) < epoch) {
+        bucket->epoch.store(epoch, std::memory_order_relaxed);
+        bucket->add_new_key_count.store(0, std::memory_order_relaxed);
+        bucket->size.store(0, std::memory_order_relaxed);
+    }
+}
+
+inline void SharedFrequencyEstimationAnalyzer::AddKeyToBucket(BucketHeader *bucket, const uint64_t fingerprint,
+                                                              const std::string &key) const {
+    const int64_t size = bucket->size.load(std::memory_order_relaxed);
+
+    // IncrementCounter
+    int64_t zero_slot = -1;
+    for (int64_t i = 0; i < size; ++i) {
+        SlotHeader *slot = Slot(bucket, i);
+        const int64_t count = slot->count.load(std::memory_order_relaxed);
+        if (slot->fingerprint.load(std::memory_order_relaxed) == fingerprint &&
+            slot->key_length.load(std::memory_order_relaxed) == key.size() &&
+            memcmp(SlotKey(slot), key.data(), key.size()) == 0) {
+            slot->count.store(count + 1, std::memory_order_relaxed);
+            return;
+        }
+        if (count == 0 && zero_slot < 0) {
+            zero_slot = i;
+        }
+    }
+
+    // CreateNewCounter
+    int64_t index = -1;
+    if (static_cast<size_t>(size) < bucket_size_) {
+        index = size;
+        bucket->size.store(size + 1, std::memory_order_relaxed);
+    } else if (zero_slot >= 0) {
+        index = zero_slot;
+    }
+    if (index >= 0) {
+        SlotHeader *slot = Slot(bucket, index);
+        memcpy(SlotKey(slot), key.data(), key.size());
+        slot->key_length.store(static_cast<uint32_t>(key.size()), std::memory_order_relaxed);
+        slot->fingerprint.store(fingerprint, std::memory_order_relaxed);
+        slot->count.store(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // DecreaseAllCounters
+    for (int64_t i = 0; i < size; ++i) {
+        SlotHeader *slot = Slot(bucket, i);
+        slot->count.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+inline uint64_t SharedFrequencyEstimationAnalyzer::Fingerprint(const std::string &key) {
+    // FNV-1a: the same value in every process, unlike std::hash which may differ between builds
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < key.size(); ++i) {
+        hash ^= static_cast<uint8_t>(key[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+#endif //VKTEST_SHARED_FREQUENCY_ESTIMATION_ANALYZER_H
@@ -0,0 +1,113 @@
+// SingleFlight implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_SINGLE_FLIGHT_H
+#define VKTEST_SINGLE_FLIGHT_H
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+/**
+ *  @brief Coalescing of concurrent loads of the same key: one thread loads, the others wait for its result.
+ *
+ *  @tparam Key  Type of key objects.
+ *  @tparam Tp  Type of loaded objects, copy constructible.
+ *  @tparam Compare  Comparison function object type, defaults to less<Key>.
+ *
+ *  A call is "in flight" from the start of the load till its end, a call for the same key made meanwhile doesn't
+ *  load but gets a copy of the result (or the exception) of the first one. Calls made after the end load again, so
+ *  the owner stores the result where the next callers look first.
+ */
+template<typename Key, typename Tp, typename Compare = std::less<Key>>
+class SingleFlight {
+public:
+    SingleFlight() : mutex_(), calls_(), coalesced_count_(0) {};
+
+    SingleFlight(const SingleFlight &) = delete;
+
+    SingleFlight &operator=(const SingleFlight &) = delete;
+
+    /**
+     *  @brief  Result of `load()` for `key`, loaded by this thread or by the call in flight for the key.
+     *
+     *  Exceptions of `load` are rethrown to every caller waiting for it.
+     *
+     *  Time complexity: O(log(keys in flight)) plus the load.
+     */
+    template<typename Load>
+    Tp Do(const Key &key, Load load);
+
+    /**
+     *  @brief  Number of calls which waited for another one instead of loading.
+     */
+    uint64_t coalesced_count() const {
+        return coalesced_count_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Call {
+        std::condition_variable done;
+        bool finished;
+        std::unique_ptr<Tp> value;
+        std::exception_ptr error;
+
+        Call() : done(), finished(false), value(), error() {};
+    };
+
+    std::mutex mutex_;
+    std::map<Key, std::shared_ptr<Call>, Compare> calls_;
+    std::atomic<uint64_t> coalesced_count_;
+};
+
+template<typename Key, typename Tp, typename Compare>
+template<typename Load>
+Tp SingleFlight<Key, Tp, Compare>::Do(const Key &key, Load load) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = calls_.find(key);
+    if (it != calls_.end()) {
+        // Keeps the call alive after the loader removes it from calls_
+        const std::shared_ptr<Call> call = it->second;
+        coalesced_count_.fetch_add(1, std::memory_order_relaxed);
+        call->done.wait(lock, [&call]() { return call->finished; });
+        lock.unlock();
+        if (call->error) {
+            std::rethrow_exception(call->error);
+        }
+        return *call->value;
+    }
+    const std::shared_ptr<Call> call = std::make_shared<Call>();
+    calls_[key] = call;
+    lock.unlock();
+
+    std::unique_ptr<Tp> value;
+    std::exception_ptr error;
+    try {
+        value.reset(new Tp(load()));
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    lock.lock();
+    // The result doesn't change after `finished`, so it is read without the mutex below
+    call->finished = true;
+    call->value = std::move(value);
+    call->error = error;
+    calls_.erase(key);
+    call->done.notify_all();
+    lock.unlock();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return *call->value;
+}
+
+#endif //VKTEST_SINGLE_FLIGHT_H
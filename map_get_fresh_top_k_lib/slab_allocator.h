@@ -0,0 +1,498 @@
+// SlabAllocator implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_SLAB_ALLOCATOR_H
+#define VKTEST_SLAB_ALLOCATOR_H
+
+#include <new>
+#include <mutex>
+#include <limits>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <cstddef>
+#include <cstdint>
+
+#include <sys/mman.h>
+
+/**
+ *  @brief Size-classed slab memory of one thread for small objects: tree nodes, strings of keys and values.
+ *
+ *  Blocks of up to 2 KiB are cut from 64 KiB slabs, every slab serves one size class, so the nodes and strings of a
+ *  map are packed densely instead of being scattered over the malloc heap. A freed block goes to the free list of
+ *  its slab and is reused by the next block of the class, a slab whose blocks are all free is recycled for any class
+ *  (a few empty slabs are kept, the rest are unmapped). Larger blocks go to operator new.
+ *
+ *  With `huge_pages` slabs are cut from 2 MiB chunks advised to be backed by transparent huge pages (fewer TLB
+ *  misses for big maps), such slabs are kept till the destruction of the arena.
+ *
+ *  An arena allocates in the thread which created it only (SlabAllocator falls back to the arena of the current
+ *  thread). Blocks may be freed by any thread: a block freed by another thread is pushed to a lock-free list which
+ *  the owner drains on its next allocation. The arena must outlive its blocks.
+ *
+ *  The arena of a thread (ForThisThread) is orphaned when the thread exits: it has no owner, all its blocks are freed
+ *  to the lock-free list. The next thread which needs an arena (with the same `huge_pages`) adopts it, drains the
+ *  list and reuses the slabs, so short-lived threads don't leak arenas. An orphaned arena is kept till it's adopted.
+ */
+class SlabArena {
+public:
+    static const size_t kMaxBlockSize = 2048;
+
+    explicit SlabArena(bool huge_pages = false);
+
+    ~SlabArena();
+
+    SlabArena(const SlabArena &) = delete;
+
+    SlabArena &operator=(const SlabArena &) = delete;
+
+    /**
+     *  @brief  Block of at least `bytes` bytes aligned as max_align_t. Must be called by the owner thread.
+     *
+     *  Time complexity: O(1) (amortized, blocks freed by other threads are reclaimed here).
+     */
+    void *Allocate(size_t bytes);
+
+    /**
+     *  @brief  Free a block of `bytes` bytes allocated by any arena, may be called by any thread.
+     */
+    static void Deallocate(void *block, size_t bytes);
+
+    /**
+     *  @brief  Arena of the current thread, adopted from an exited thread or created on the first call. It's never
+     *  destroyed (its blocks may outlive the thread), but orphaned at the thread exit.
+     */
+    static SlabArena &ForThisThread();
+
+    /**
+     *  @brief  Whether arenas of threads created after the call use huge pages, defaults to false.
+     */
+    static void SetHugePagesByDefault(bool huge_pages);
+
+    bool OwnedByThisThread() const {
+        return owner_.load(std::memory_order_relaxed) == std::this_thread::get_id();
+    }
+
+    bool huge_pages() const {
+        return huge_pages_;
+    }
+
+    /**
+     *  @brief  Bytes of live small blocks (rounded up to their size classes). Read it in the owner thread.
+     */
+    size_t allocated_bytes() const {
+        return allocated_bytes_;
+    }
+
+    /**
+     *  @brief  Bytes of mapped slabs, including free blocks and empty slabs.
+     */
+    size_t reserved_bytes() const {
+        return slabs_count_ * kSlabSize;
+    }
+
+private:
+    static const size_t kSlabSize = 64 << 10;
+    static const size_t kHugeChunkSize = 2 << 20;
+    // Slab header, rounded up to keep blocks aligned
+    static const size_t kHeaderSize = 64;
+    static const size_t kClassesCount = 14;
+    static const size_t kEmptySlabsKept = 4;
+
+    struct Slab {
+        SlabArena *arena;
+        // In the list of partially used slabs of the class or in the list of empty slabs
+        Slab *prev;
+        Slab *next;
+        // In the list of all slabs of the arena
+        Slab *all_prev;
+        Slab *all_next;
+        void *free_list;
+        uint32_t size_class;
+        uint32_t used;
+        uint32_t bump_offset;
+        bool in_list;
+    };
+
+    static size_t ClassSize(size_t size_class);
+
+    static size_t SizeClass(size_t bytes);
+
+    static Slab *SlabOf(void *block) {
+        return reinterpret_cast<Slab *>(reinterpret_cast<uintptr_t>(block) & ~(uintptr_t(kSlabSize) - 1));
+    }
+
+    static char *MapAligned(size_t bytes, size_t alignment);
+
+    static std::atomic<bool> &HugePagesByDefault();
+
+    // Arenas of exited threads, guarded by OrphansMutex
+    static std::vector<SlabArena *> &Orphans();
+
+    static std::mutex &OrphansMutex();
+
+    // Take an orphaned arena or create a new one for the current thread
+    static SlabArena *Adopt();
+
+    // Leave the arena of the exiting thread to the next thread
+    static void Orphan(SlabArena *arena);
+
+    void Free(Slab *slab, void *block);
+
+    void PushRemote(void *block);
+
+    void DrainRemoteFrees();
+
+    Slab *NewSlab(size_t size_class);
+
+    void MapSlabs();
+
+    void Retire(Slab *slab);
+
+    static void PushFront(Slab *&list, Slab *slab);
+
+    static void Unlink(Slab *&list, Slab *slab);
+
+    // No thread while orphaned
+    std::atomic<std::thread::id> owner_;
+    const bool huge_pages_;
+    Slab *partial_[kClassesCount];
+    Slab *empty_;
+    size_t empty_count_;
+    Slab *all_;
+    size_t slabs_count_;
+    size_t allocated_bytes_;
+    // Blocks freed by other threads, linked through their first bytes
+    std::atomic<void *> remote_frees_;
+};
+
+inline SlabArena::SlabArena(const bool huge_pages)
+        : owner_(std::this_thread::get_id()), huge_pages_(huge_pages), empty_(nullptr), empty_count_(0),
+          all_(nullptr), slabs_count_(0), allocated_bytes_(0), remote_frees_(nullptr) {
+    for (size_t i = 0; i < kClassesCount; ++i) {
+        partial_[i] = nullptr;
+    }
+}
+
+inline SlabArena::~SlabArena() {
+    while (all_ != nullptr) {
+        Slab *next = all_->all_next;
+        munmap(all_, kSlabSize);
+        all_ = next;
+    }
+}
+
+inline void *SlabArena::Allocate(const size_t bytes) {
+    if (bytes > kMaxBlockSize) {
+        return ::operator new(bytes);
+    }
+    DrainRemoteFrees();
+    const size_t size_class = SizeClass(bytes);
+    const size_t size = ClassSize(size_class);
+    Slab *slab = partial_[size_class] != nullptr ? partial_[size_class] : NewSlab(size_class);
+    void *block;
+    if (slab->free_list != nullptr) {
+        block = slab->free_list;
+        slab->free_list = *static_cast<void **>(block);
+    } else {
+        block = reinterpret_cast<char *>(slab) + slab->bump_offset;
+        slab->bump_offset += static_cast<uint32_t>(size);
+    }
+    ++slab->used;
+    allocated_bytes_ += size;
+    if (slab->free_list == nullptr && slab->bump_offset + size > kSlabSize) {
+        // Full slabs are found by their blocks only
+        Unlink(partial_[size_class], slab);
+    }
+    return block;
+}
+
+inline void SlabArena::Deallocate(void *block, const size_t bytes) {
+    if (block == nullptr) {
+        return;
+    }
+    if (bytes > kMaxBlockSize) {
+        ::operator delete(block);
+        return;
+    }
+    Slab *slab = SlabOf(block);
+    if (slab->arena->OwnedByThisThread()) {
+        slab->arena->Free(slab, block);
+    } else {
+        slab->arena->PushRemote(block);
+    }
+}
+
+inline SlabArena &SlabArena::ForThisThread() {
+    struct ThreadArena {
+        SlabArena *arena;
+
+        ~ThreadArena() {
+            if (arena != nullptr) {
+                Orphan(arena);
+            }
+        }
+    };
+    static thread_local ThreadArena thread_arena = {nullptr};
+    if (thread_arena.arena == nullptr) {
+        thread_arena.arena = Adopt();
+    }
+    return *thread_arena.arena;
+}
+
+inline void SlabArena::SetHugePagesByDefault(const bool huge_pages) {
+    HugePagesByDefault().store(huge_pages, std::memory_order_relaxed);
+}
+
+inline size_t SlabArena::ClassSize(const size_t size_class) {
+    static const size_t sizes[kClassesCount] = {16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048};
+    return sizes[size_class];
+}
+
+inline size_t SlabArena::SizeClass(const size_t bytes) {
+    size_t size_class = 0;
+    while (ClassSize(size_class) < bytes) {
+        ++size_class;
+    }
+    return size_class;
+}
+
+inline char *SlabArena::MapAligned(const size_t bytes, const size_t alignment) {
+    const size_t mapped = bytes + alignment;
+    void *base = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(base);
+    const uintptr_t start = (begin + alignment - 1) & ~(uintptr_t(alignment) - 1);
+    const size_t head = start - begin;
+    const size_t tail = mapped - head - bytes;
+    if (head > 0) {
+        munmap(base, head);
+    }
+    if (tail > 0) {
+        munmap(reinterpret_cast<char *>(start + bytes), tail);
+    }
+    return reinterpret_cast<char *>(start);
+}
+
+inline std::atomic<bool> &SlabArena::HugePagesByDefault() {
+    static std::atomic<bool> huge_pages(false);
+    return huge_pages;
+}
+
+inline std::vector<SlabArena *> &SlabArena::Orphans() {
+    static std::vector<SlabArena *> orphans;
+    return orphans;
+}
+
+inline std::mutex &SlabArena::OrphansMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+inline SlabArena *SlabArena::Adopt() {
+    const bool huge_pages = HugePagesByDefault().load(std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(OrphansMutex());
+        std::vector<SlabArena *> &orphans = Orphans();
+        for (size_t i = orphans.size(); i-- > 0;) {
+            if (orphans[i]->huge_pages_ == huge_pages) {
+                SlabArena *arena = orphans[i];
+                orphans.erase(orphans.begin() + i);
+                // The lock orders the previous owner's work before ours; the remote frees are drained on the first
+                // allocation
+                arena->owner_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+                return arena;
+            }
+        }
+    }
+    return new SlabArena(huge_pages);
+}
+
+inline void SlabArena::Orphan(SlabArena *arena) {
+    std::lock_guard<std::mutex> lock(OrphansMutex());
+    // From now on every block goes to the lock-free list
+    arena->owner_.store(std::thread::id(), std::memory_order_relaxed);
+    Orphans().push_back(arena);
+}
+
+inline void SlabArena::Free(Slab *slab, void *block) {
+    *static_cast<void **>(block) = slab->free_list;
+    slab->free_list = block;
+    --slab->used;
+    allocated_bytes_ -= ClassSize(slab->size_class);
+    if (slab->used == 0) {
+        if (slab->in_list) {
+            Unlink(partial_[slab->size_class], slab);
+        }
+        Retire(slab);
+    } else if (!slab->in_list) {
+        PushFront(partial_[slab->size_class], slab);
+    }
+}
+
+inline void SlabArena::PushRemote(void *block) {
+    void *head = remote_frees_.load(std::memory_order_relaxed);
+    do {
+        *static_cast<void **>(block) = head;
+    } while (!remote_frees_.compare_exchange_weak(head, block, std::memory_order_release,
+                                                  std::memory_order_relaxed));
+}
+
+inline void SlabArena::DrainRemoteFrees() {
+    if (remote_frees_.load(std::memory_order_relaxed) == nullptr) {
+        return;
+    }
+    void *block = remote_frees_.exchange(nullptr, std::memory_order_acquire);
+    while (block != nullptr) {
+        void *next = *static_cast<void **>(block);
+        Free(SlabOf(block), block);
+        block = next;
+    }
+}
+
+inline SlabArena::Slab *SlabArena::NewSlab(const size_t size_class) {
+    if (empty_ == nullptr) {
+        MapSlabs();
+    }
+    Slab *slab = empty_;
+    Unlink(empty_, slab);
+    --empty_count_;
+    slab->size_class = static_cast<uint32_t>(size_class);
+    slab->used = 0;
+    slab->free_list = nullptr;
+    slab->bump_offset = kHeaderSize;
+    PushFront(partial_[size_class], slab);
+    return slab;
+}
+
+inline void SlabArena::MapSlabs() {
+    const size_t chunk_size = huge_pages_ ? kHugeChunkSize : kSlabSize;
+    char *chunk = MapAligned(chunk_size, chunk_size);
+#ifdef MADV_HUGEPAGE
+    if (huge_pages_) {
+        // Only advice: without transparent huge pages the chunk is backed by usual pages
+        madvise(chunk, chunk_size, MADV_HUGEPAGE);
+    }
+#endif
+    for (size_t offset = 0; offset < chunk_size; offset += kSlabSize) {
+        Slab *slab = reinterpret_cast<Slab *>(chunk + offset);
+        slab->arena = this;
+        slab->all_prev = nullptr;
+        slab->all_next = all_;
+        if (all_ != nullptr) {
+            all_->all_prev = slab;
+        }
+        all_ = slab;
+        ++slabs_count_;
+        PushFront(empty_, slab);
+        ++empty_count_;
+    }
+}
+
+inline void SlabArena::Retire(Slab *slab) {
+    if (huge_pages_ || empty_count_ < kEmptySlabsKept) {
+        PushFront(empty_, slab);
+        ++empty_count_;
+        return;
+    }
+    if (slab->all_prev != nullptr) {
+        slab->all_prev->all_next = slab->all_next;
+    } else {
+        all_ = slab->all_next;
+    }
+    if (slab->all_next != nullptr) {
+        slab->all_next->all_prev = slab->all_prev;
+    }
+    --slabs_count_;
+    munmap(slab, kSlabSize);
+}
+
+inline void SlabArena::PushFront(Slab *&list, Slab *slab) {
+    slab->prev = nullptr;
+    slab->next = list;
+    if (list != nullptr) {
+        list->prev = slab;
+    }
+    list = slab;
+    slab->in_list = true;
+}
+
+inline void SlabArena::Unlink(Slab *&list, Slab *slab) {
+    if (slab->prev != nullptr) {
+        slab->prev->next = slab->next;
+    } else {
+        list = slab->next;
+    }
+    if (slab->next != nullptr) {
+        slab->next->prev = slab->prev;
+    }
+    slab->in_list = false;
+}
+
+/**
+ *  @brief Standard allocator of SlabArena blocks, e.g. for the nodes of MapGetFreshTopK and its string keys and
+ *  values (ArenaString, ArenaMapGetFreshTopK).
+ *
+ *  @tparam T  Type of allocated objects.
+ *
+ *  A default constructed allocator uses the arena of the current thread. Allocations from another thread than the
+ *  one of the arena go to the arena of that thread, and every block can be freed by any allocator, so all
+ *  allocators are equal and containers can be moved between threads.
+ */
+template<typename T>
+class SlabAllocator {
+public:
+    typedef T value_type;
+
+    template<typename U>
+    struct rebind {
+        typedef SlabAllocator<U> other;
+    };
+
+    SlabAllocator() : arena_(&SlabArena::ForThisThread()) {};
+
+    explicit SlabAllocator(SlabArena &arena) : arena_(&arena) {};
+
+    template<typename U>
+    SlabAllocator(const SlabAllocator<U> &other) : arena_(&other.arena()) {};
+
+    T *allocate(size_t n) {
+        if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        SlabArena &arena = arena_->OwnedByThisThread() ? *arena_ : SlabArena::ForThisThread();
+        return static_cast<T *>(arena.Allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *pointer, size_t n) {
+        SlabArena::Deallocate(pointer, n * sizeof(T));
+    }
+
+    SlabArena &arena() const {
+        return *arena_;
+    }
+
+private:
+    SlabArena *arena_;
+};
+
+template<typename T, typename U>
+bool operator==(const SlabAllocator<T> &, const SlabAllocator<U> &) {
+    return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const SlabAllocator<T> &, const SlabAllocator<U> &) {
+    return false;
+}
+
+/**
+ *  @brief  String with the characters in slab blocks (short strings stay inside the object as usual).
+ */
+typedef std::basic_string<char, std::char_traits<char>, SlabAllocator<char>> ArenaString;
+
+#endif //VKTEST_SLAB_ALLOCATOR_H
@@ -0,0 +1,280 @@
+// SoaCounterBucket implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_SOA_COUNTER_BUCKET_H
+#define VKTEST_SOA_COUNTER_BUCKET_H
+
+#include <map>
+#include <memory>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+#include "counter_kernels.h"
+#include "memory_usage.h"
+
+/**
+ *  @brief  Fixed-size array of trivial values aligned to a cache line.
+ */
+template<typename T>
+class AlignedArray {
+public:
+    static const size_t kAlignment = 64;
+
+    explicit AlignedArray(size_t size = 0);
+
+    AlignedArray(const AlignedArray &other);
+
+    AlignedArray(AlignedArray &&other) noexcept;
+
+    AlignedArray &operator=(AlignedArray other);
+
+    T *data() {
+        return data_;
+    }
+
+    const T *data() const {
+        return data_;
+    }
+
+    T &operator[](size_t index) {
+        return data_[index];
+    }
+
+    const T &operator[](size_t index) const {
+        return data_[index];
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    std::unique_ptr<char[]> storage_;
+    T *data_;
+    size_t size_;
+};
+
+template<typename T>
+const size_t AlignedArray<T>::kAlignment;
+
+template<typename T>
+AlignedArray<T>::AlignedArray(const size_t size)
+        : storage_(new char[size * sizeof(T) + kAlignment]()), data_(nullptr), size_(size) {
+    void *pointer = storage_.get();
+    size_t space = size * sizeof(T) + kAlignment;
+    data_ = static_cast<T *>(std::align(kAlignment, size * sizeof(T), pointer, space));
+}
+
+template<typename T>
+AlignedArray<T>::AlignedArray(const AlignedArray &other) : AlignedArray(other.size_) {
+    if (size_ > 0) {
+        memcpy(data_, other.data_, size_ * sizeof(T));
+    }
+}
+
+template<typename T>
+AlignedArray<T>::AlignedArray(AlignedArray &&other) noexcept
+        : storage_(std::move(other.storage_)), data_(other.data_), size_(other.size_) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+}
+
+template<typename T>
+AlignedArray<T> &AlignedArray<T>::operator=(AlignedArray other) {
+    std::swap(storage_, other.storage_);
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    return *this;
+}
+
+/**
+ *  @brief Misra-Gries bucket with structure-of-arrays layout.
+ *
+ *  @tparam Key  Type of key objects.
+ *  @tparam Compare  Comparison function object type, keys are equal if neither is less than the other.
+ *
+ *  Counters and fingerprints (hashes of keys) are kept in separate contiguous cache-line aligned arrays, keys in a
+ *  third one, so lookups, "decrease all" and "find a zero counter" passes are linear scans done by counter_kernels
+ *  instead of tree walks. The bucket never holds more than `capacity` counters.
+ */
+template<typename Key, typename Compare = std::less<Key>>
+class SoaCounterBucket {
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    explicit SoaCounterBucket(size_t capacity = 0);
+
+    /**
+     *  @brief  Index of the counter of `key`, npos if there is no one.
+     */
+    size_t Find(const Key &key, uint64_t fingerprint) const;
+
+    /**
+     *  @brief  Create a counter with value `count` if there is a free place or a zero counter (it is replaced).
+     *  @return  Index of the new counter, npos if the bucket is full.
+     */
+    size_t TryInsert(const Key &key, uint64_t fingerprint, int64_t count);
+
+    /**
+     *  @brief  Decrease every positive counter by one.
+     */
+    void DecrementAll();
+
+    /**
+     *  @brief  Decrease every counter by `delta`, not below zero.
+     */
+    void SubtractAll(int64_t delta);
+
+    /**
+     *  @brief  Minimum counter, INT64_MAX if the bucket is empty.
+     */
+    int64_t MinCounter() const;
+
+    /**
+     *  @brief  Append (count, key) pairs of counters >= `threshold` to `result`.
+     */
+    void CollectAtLeast(int64_t threshold, std::vector<std::pair<int64_t, Key>> &result) const;
+
+    /**
+     *  @brief  Replace the content with `counters`, at most `capacity` of them. Fingerprints are made by `hash`.
+     */
+    template<typename Hash>
+    void Assign(const std::map<Key, int64_t, Compare> &counters, const Hash &hash);
+
+    std::map<Key, int64_t, Compare> ToMap() const;
+
+    /**
+     *  @brief  Memory of the counter, fingerprint (counted as counters) and key arrays.
+     */
+    MemoryUsage memory_usage() const;
+
+    int64_t &counter(size_t index) {
+        return counters_[index];
+    }
+
+    int64_t counter(size_t index) const {
+        return counters_[index];
+    }
+
+    const Key &key(size_t index) const {
+        return keys_[index];
+    }
+
+    size_t size() const {
+        return keys_.size();
+    }
+
+    size_t capacity() const {
+        return counters_.size();
+    }
+
+private:
+    AlignedArray<int64_t> counters_;
+    AlignedArray<uint64_t> fingerprints_;
+    std::vector<Key> keys_;
+};
+
+template<typename Key, typename Compare>
+const size_t SoaCounterBucket<Key, Compare>::npos;
+
+template<typename Key, typename Compare>
+SoaCounterBucket<Key, Compare>::SoaCounterBucket(const size_t capacity)
+        : counters_(capacity), fingerprints_(capacity), keys_() {
+    keys_.reserve(capacity);
+}
+
+template<typename Key, typename Compare>
+size_t SoaCounterBucket<Key, Compare>::Find(const Key &key, const uint64_t fingerprint) const {
+    const Compare compare;
+    const size_t size = keys_.size();
+    for (size_t i = counter_kernels::FindFingerprint(fingerprints_.data(), size, fingerprint);
+         i < size; i = counter_kernels::FindFingerprint(fingerprints_.data(), size, fingerprint, i + 1)) {
+        if (!compare(keys_[i], key) && !compare(key, keys_[i])) {
+            return i;
+        }
+    }
+    return npos;
+}
+
+template<typename Key, typename Compare>
+size_t SoaCounterBucket<Key, Compare>::TryInsert(const Key &key, const uint64_t fingerprint, const int64_t count) {
+    size_t index = keys_.size();
+    if (index < counters_.size()) {
+        keys_.push_back(key);
+    } else {
+        index = counter_kernels::FindZero(counters_.data(), keys_.size());
+        if (index == keys_.size()) {
+            return npos;
+        }
+        keys_[index] = key;
+    }
+    counters_[index] = count;
+    fingerprints_[index] = fingerprint;
+    return index;
+}
+
+template<typename Key, typename Compare>
+void SoaCounterBucket<Key, Compare>::DecrementAll() {
+    counter_kernels::DecrementPositive(counters_.data(), keys_.size());
+}
+
+template<typename Key, typename Compare>
+void SoaCounterBucket<Key, Compare>::SubtractAll(const int64_t delta) {
+    counter_kernels::SubtractSaturating(counters_.data(), keys_.size(), delta);
+}
+
+template<typename Key, typename Compare>
+int64_t SoaCounterBucket<Key, Compare>::MinCounter() const {
+    return counter_kernels::FindMin(counters_.data(), keys_.size());
+}
+
+template<typename Key, typename Compare>
+void SoaCounterBucket<Key, Compare>::CollectAtLeast(const int64_t threshold,
+                                                    std::vector<std::pair<int64_t, Key>> &result) const {
+    // Counters are never negative, so a non-positive threshold takes everything and can't overflow in the kernel
+    std::vector<uint32_t> indices(keys_.size());
+    const size_t found = counter_kernels::CollectAtLeast(counters_.data(), keys_.size(),
+                                                         std::max<int64_t>(threshold, 0), indices.data());
+    result.reserve(result.size() + found);
+    for (size_t i = 0; i < found; ++i) {
+        result.emplace_back(counters_[indices[i]], keys_[indices[i]]);
+    }
+}
+
+template<typename Key, typename Compare>
+template<typename Hash>
+void SoaCounterBucket<Key, Compare>::Assign(const std::map<Key, int64_t, Compare> &counters, const Hash &hash) {
+    keys_.clear();
+    for (auto it = counters.begin(); it != counters.end() && keys_.size() < counters_.size(); ++it) {
+        counters_[keys_.size()] = it->second;
+        fingerprints_[keys_.size()] = static_cast<uint64_t>(hash(it->first));
+        keys_.push_back(it->first);
+    }
+}
+
+template<typename Key, typename Compare>
+MemoryUsage SoaCounterBucket<Key, Compare>::memory_usage() const {
+    MemoryUsage usage;
+    usage.counters = counters_.size() * (sizeof(int64_t) + sizeof(uint64_t));
+    usage.keys = keys_.capacity() * sizeof(Key);
+    for (size_t i = 0; i < keys_.size(); ++i) {
+        usage.keys += HeapBytes(keys_[i]);
+    }
+    usage.overhead = sizeof(*this) + 2 * AlignedArray<int64_t>::kAlignment;
+    return usage;
+}
+
+template<typename Key, typename Compare>
+std::map<Key, int64_t, Compare> SoaCounterBucket<Key, Compare>::ToMap() const {
+    std::map<Key, int64_t, Compare> result;
+    for (size_t i = 0; i < keys_.size(); ++i) {
+        result.emplace(keys_[i], counters_[i]);
+    }
+    return result;
+}
+
+#endif //VKTEST_SOA_COUNTER_BUCKET_H
@@ -0,0 +1,318 @@
+// TimingWheel implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_TIMING_WHEEL_H
+#define VKTEST_TIMING_WHEEL_H
+
+#include <map>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <functional>
+
+#include "integer_keys.h"
+#include "memory_usage.h"
+
+/**
+ *  @brief Hierarchical timing wheel of key deadlines (e.g. TTL of map entries).
+ *
+ *  @tparam Key  Type of key objects.
+ *  @tparam Compare  Comparison function object type, defaults to less<Key>.
+ *  @tparam Hash  Hash function object type, defaults to DefaultKeyHash<Key>.
+ *
+ *  Time is counted in ticks. Level l has 256 slots of 256^l ticks each: a deadline is put into the lowest level
+ *  whose current block contains it, and is moved to lower levels (cascaded) when the time reaches its slot. So
+ *  `Advance` costs O(passed ticks + expired keys + cascaded keys), not O(number of keys): a key is cascaded at most
+ *  `levels` times. Deadlines farther than 256^levels ticks wait in the top level and are placed again.
+ *
+ *  A key has at most one deadline and one entry in the slots: the key remembers the position of its entry, so
+ *  rescheduling and cancelling unlink it in O(1), and the memory is proportional to the number of keys, not to the
+ *  number of `Schedule` calls. Deadlines are rounded up to ticks, so keys expire up to a tick late.
+ *
+ *  Fingerprints of the keys with deadlines are counted in a small table, so `MayHaveDeadline` tells most keys
+ *  without a deadline in O(1), and the lookups of a map with a few TTL keys don't pay for them.
+ */
+template<typename Key, typename Compare = std::less<Key>, typename Hash = DefaultKeyHash<Key>>
+class TimingWheel {
+public:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    /**
+     *  @param tick  Precision of deadlines, defaults to 10 ms.
+     *  @param levels  Number of levels, from 1 to 8, defaults to 4 (2^32 ticks, ~500 days with 10 ms ticks).
+     *  @param start  Time of the tick 0.
+     */
+    explicit TimingWheel(std::chrono::duration<double> tick = std::chrono::milliseconds(10), size_t levels = 4,
+                         TimePoint start = std::chrono::steady_clock::now());
+
+    /**
+     *  @brief  Set the deadline of `key`, replacing the previous one.
+     *
+     *  Time complexity: O(log(n)), where n - number of keys with deadlines.
+     */
+    void Schedule(const Key &key, TimePoint deadline);
+
+    /**
+     *  @brief  Schedule with the fingerprint computed by the caller (`HashKey`).
+     */
+    void ScheduleWithHash(const Key &key, uint64_t fingerprint, TimePoint deadline);
+
+    /**
+     *  @brief  Remove the deadline of `key`, returns false if it had no deadline.
+     *
+     *  Time complexity: O(log(n)).
+     */
+    bool Cancel(const Key &key);
+
+    /**
+     *  @brief  Whether the deadline of `key` has passed at `now`, false for keys without deadlines.
+     *
+     *  Time complexity: O(log(n)).
+     */
+    bool IsExpired(const Key &key, TimePoint now) const;
+
+    /**
+     *  @brief  False if the key with the fingerprint has no deadline for sure, true if it may have one.
+     *
+     *  Time complexity: O(1).
+     */
+    bool MayHaveDeadline(uint64_t fingerprint) const {
+        return marks_[fingerprint & (marks_.size() - 1)] != 0;
+    }
+
+    uint64_t HashKey(const Key &key) const {
+        return static_cast<uint64_t>(hash_(key));
+    }
+
+    /**
+     *  @brief  Move the time to `now`: append the keys whose deadlines have passed to `expired` and forget them.
+     *  @return  Number of expired keys.
+     */
+    size_t Advance(TimePoint now, std::vector<Key> &expired);
+
+    /**
+     *  @brief  Number of keys with deadlines.
+     */
+    size_t size() const {
+        return deadlines_.size();
+    }
+
+    MemoryUsage memory_usage() const;
+
+private:
+    static const size_t kSlotBits = 8;
+    static const size_t kSlots = 1 << kSlotBits;
+
+    struct Position {
+        uint64_t fingerprint;
+        uint64_t deadline_tick;
+        // Index of the slot and of the entry in it
+        size_t slot;
+        size_t index;
+    };
+
+    typedef std::map<Key, Position, Compare> Deadlines;
+    // Entries of the slots are the deadlines of the keys
+    typedef typename Deadlines::iterator Entry;
+
+    // Number of whole ticks from the start to `time`
+    uint64_t TickOf(TimePoint time) const;
+
+    // Put the entry into the slot of max(deadline_tick, earliest_tick)
+    void Place(Entry entry, uint64_t earliest_tick);
+
+    // Remove the entry from its slot, the last entry of the slot takes its place
+    void Unlink(Entry entry);
+
+    // Forget the deadline of the entry
+    void Erase(Entry entry);
+
+    // Count the fingerprint of a new key, doubling the table when the keys outgrow it
+    void Mark(uint64_t fingerprint);
+
+    size_t SlotIndex(size_t level, uint64_t tick) const {
+        return level * kSlots + ((tick >> (kSlotBits * level)) & (kSlots - 1));
+    }
+
+    const Hash hash_;
+    const std::chrono::duration<double> tick_;
+    const size_t levels_;
+    const TimePoint start_;
+    uint64_t current_tick_;
+    std::vector<std::vector<Entry>> slots_;
+    Deadlines deadlines_;
+    // Numbers of keys with deadlines by the low bits of their fingerprints, at least twice as many as the keys
+    std::vector<uint32_t> marks_;
+};
+
+template<typename Key, typename Compare, typename Hash>
+const size_t TimingWheel<Key, Compare, Hash>::kSlotBits;
+
+template<typename Key, typename Compare, typename Hash>
+const size_t TimingWheel<Key, Compare, Hash>::kSlots;
+
+template<typename Key, typename Compare, typename Hash>
+TimingWheel<Key, Compare, Hash>::TimingWheel(const std::chrono::duration<double> tick, const size_t levels,
+                                       const TimePoint start)
+        : hash_(), tick_(tick), levels_(levels), start_(start), current_tick_(0), slots_(), deadlines_(),
+          marks_(64, 0) {
+    if (!(tick.count() > 0) || levels == 0 || levels * kSlotBits > 64) {
+        throw std::invalid_argument("TimingWheel: tick must be positive and levels in [1, 8]");
+    }
+    slots_.resize(levels * kSlots);
+}
+
+template<typename Key, typename Compare, typename Hash>
+void TimingWheel<Key, Compare, Hash>::Schedule(const Key &key, const TimePoint deadline) {
+    ScheduleWithHash(key, HashKey(key), deadline);
+}
+
+template<typename Key, typename Compare, typename Hash>
+void TimingWheel<Key, Compare, Hash>::ScheduleWithHash(const Key &key, const uint64_t fingerprint,
+                                                       const TimePoint deadline) {
+    const double ticks = std::ceil(std::chrono::duration<double>(deadline - start_).count() / tick_.count());
+    const uint64_t deadline_tick = ticks > 0 ? static_cast<uint64_t>(ticks) : 0;
+    Position position = {fingerprint, deadline_tick, 0, 0};
+    std::pair<Entry, bool> inserted = deadlines_.insert(std::make_pair(key, position));
+    if (inserted.second) {
+        Mark(fingerprint);
+    } else {
+        if (inserted.first->second.deadline_tick == deadline_tick) {
+            return;
+        }
+        Unlink(inserted.first);
+        inserted.first->second.deadline_tick = deadline_tick;
+    }
+    // The slot of the current tick has been processed already
+    Place(inserted.first, current_tick_ + 1);
+}
+
+template<typename Key, typename Compare, typename Hash>
+bool TimingWheel<Key, Compare, Hash>::Cancel(const Key &key) {
+    auto it = deadlines_.find(key);
+    if (it == deadlines_.end()) {
+        return false;
+    }
+    Erase(it);
+    return true;
+}
+
+template<typename Key, typename Compare, typename Hash>
+bool TimingWheel<Key, Compare, Hash>::IsExpired(const Key &key, const TimePoint now) const {
+    auto it = deadlines_.find(key);
+    return it != deadlines_.end() && it->second.deadline_tick <= TickOf(now);
+}
+
+template<typename Key, typename Compare, typename Hash>
+size_t TimingWheel<Key, Compare, Hash>::Advance(const TimePoint now, std::vector<Key> &expired) {
+    const uint64_t target_tick = TickOf(now);
+    size_t expired_count = 0;
+    while (current_tick_ < target_tick) {
+        if (deadlines_.empty()) {
+            // An idle wheel doesn't walk the ticks
+            current_tick_ = target_tick;
+            break;
+        }
+        ++current_tick_;
+        // From the top: entries cascaded from a level may land in the current slot of a lower one
+        for (size_t level = levels_ - 1; level > 0; --level) {
+            if ((current_tick_ & ((uint64_t(1) << (kSlotBits * level)) - 1)) != 0) {
+                continue;
+            }
+            std::vector<Entry> entries;
+            entries.swap(slots_[SlotIndex(level, current_tick_)]);
+            for (size_t i = 0; i < entries.size(); ++i) {
+                Place(entries[i], current_tick_);
+            }
+        }
+
+        std::vector<Entry> entries;
+        entries.swap(slots_[SlotIndex(0, current_tick_)]);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (entries[i]->second.deadline_tick > current_tick_) {
+                // Out of the range of a one-level wheel
+                Place(entries[i], current_tick_ + 1);
+            } else {
+                expired.push_back(entries[i]->first);
+                // Already out of its slot
+                --marks_[entries[i]->second.fingerprint & (marks_.size() - 1)];
+                deadlines_.erase(entries[i]);
+                ++expired_count;
+            }
+        }
+    }
+    return expired_count;
+}
+
+template<typename Key, typename Compare, typename Hash>
+MemoryUsage TimingWheel<Key, Compare, Hash>::memory_usage() const {
+    MemoryUsage usage = ContainerMemoryUsage(deadlines_);
+    // Deadlines are the counters of the wheel
+    usage.counters += usage.values;
+    usage.values = 0;
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        usage.overhead += sizeof(std::vector<Entry>) + slots_[i].capacity() * sizeof(Entry);
+    }
+    usage.overhead += marks_.capacity() * sizeof(uint32_t);
+    usage.overhead += sizeof(*this);
+    return usage;
+}
+
+template<typename Key, typename Compare, typename Hash>
+uint64_t TimingWheel<Key, Compare, Hash>::TickOf(const TimePoint time) const {
+    const double ticks = std::floor(std::chrono::duration<double>(time - start_).count() / tick_.count());
+    return ticks > 0 ? static_cast<uint64_t>(ticks) : 0;
+}
+
+template<typename Key, typename Compare, typename Hash>
+void TimingWheel<Key, Compare, Hash>::Place(const Entry entry, const uint64_t earliest_tick) {
+    const uint64_t deadline_tick = entry->second.deadline_tick;
+    const uint64_t tick = deadline_tick > earliest_tick ? deadline_tick : earliest_tick;
+    // The lowest level whose current block (the slots above it) contains the tick
+    size_t level = 0;
+    while (level + 1 < levels_ && (tick >> (kSlotBits * (level + 1))) != (current_tick_ >> (kSlotBits * (level + 1)))) {
+        ++level;
+    }
+    const size_t shift = kSlotBits * level;
+    // Out of the range of the wheel: the current slot of the top level is reached again after a full turn, the entry
+    // is placed again then
+    const size_t slot = SlotIndex(level, (tick >> shift) - (current_tick_ >> shift) >= kSlots ? current_tick_ : tick);
+    entry->second.slot = slot;
+    entry->second.index = slots_[slot].size();
+    slots_[slot].push_back(entry);
+}
+
+template<typename Key, typename Compare, typename Hash>
+void TimingWheel<Key, Compare, Hash>::Unlink(const Entry entry) {
+    std::vector<Entry> &slot = slots_[entry->second.slot];
+    const size_t index = entry->second.index;
+    slot[index] = slot.back();
+    slot[index]->second.index = index;
+    slot.pop_back();
+}
+
+template<typename Key, typename Compare, typename Hash>
+void TimingWheel<Key, Compare, Hash>::Erase(const Entry entry) {
+    Unlink(entry);
+    --marks_[entry->second.fingerprint & (marks_.size() - 1)];
+    deadlines_.erase(entry);
+}
+
+template<typename Key, typename Compare, typename Hash>
+void TimingWheel<Key, Compare, Hash>::Mark(const uint64_t fingerprint) {
+    // The key is in deadlines_ already
+    if (deadlines_.size() * 2 <= marks_.size()) {
+        ++marks_[fingerprint & (marks_.size() - 1)];
+        return;
+    }
+    marks_.assign(marks_.size() * 2, 0);
+    for (auto it = deadlines_.begin(); it != deadlines_.end(); ++it) {
+        ++marks_[it->second.fingerprint & (marks_.size() - 1)];
+    }
+}
+
+#endif //VKTEST_TIMING_WHEEL_H
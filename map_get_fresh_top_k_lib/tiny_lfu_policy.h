@@ -0,0 +1,258 @@
+// TinyLfuPolicy implementation -*- C++ -*-
+
+// Made especially for VK Team by Nikita Lisovetin (vk: vk.com/nikitalisovetin, e-mail: nik-lisovetin@ya.ru)
+
+#ifndef VKTEST_TINY_LFU_POLICY_H
+#define VKTEST_TINY_LFU_POLICY_H
+
+#include <list>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+
+#include "flat_integer_map.h"
+#include "memory_usage.h"
+
+/**
+ *  @brief W-TinyLFU eviction policy: keeps keys only, the owner keeps the values.
+ *
+ *  @tparam Key  Type of key objects.
+ *  @tparam Compare  Comparison function object type, defaults to less<Key>.
+ *
+ *  New keys enter a small LRU window (1% of the capacity). A key pushed out of the window is a candidate for the
+ *  main SLRU area (probation + protected, protected is 80% of it). When the main area is full the candidate and the
+ *  LRU key of probation (the victim) are compared by frequency and the less frequent one is evicted: the candidate
+ *  is admitted unless the victim is more frequent, so cold keys replace each other in LRU order and never push out
+ *  hot keys. A hit in probation promotes the key to protected.
+ *
+ *  Frequency is given by the caller as a function object `int64_t (const Key &)`, e.g. analyzer counters.
+ */
+template<typename Key, typename Compare = std::less<Key>>
+class TinyLfuPolicy {
+public:
+    /**
+     *  @brief Policy constructor.
+     *
+     *  @param capacity  Maximum number of keys, must be positive.
+     */
+    explicit TinyLfuPolicy(size_t capacity);
+
+    /**
+     *  @brief  Register a hit of a key which is in the policy.
+     *
+     *  Time complexity: O(index lookup).
+     */
+    void Touch(const Key &key);
+
+    /**
+     *  @brief  Add a new key, append evicted keys (at most one) to `evicted`.
+     *
+     *  The new key itself is never evicted by its own insertion.
+     */
+    template<typename Frequency>
+    void Insert(const Key &key, const Frequency &frequency, std::vector<Key> &evicted);
+
+    /**
+     *  @brief  Forget a key, nothing happens if it is not in the policy.
+     */
+    void Erase(const Key &key);
+
+    /**
+     *  @brief  Change the maximum number of keys, append evicted keys to `evicted`.
+     */
+    template<typename Frequency>
+    void SetCapacity(size_t capacity, const Frequency &frequency, std::vector<Key> &evicted);
+
+    bool Contains(const Key &key) const {
+        return index_.find(key) != index_.end();
+    }
+
+    size_t size() const {
+        return window_.size() + probation_.size() + protected_.size();
+    }
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    /**
+     *  @brief  Memory of the LRU lists (keys and nodes) and the key index. Time complexity: O(n).
+     */
+    MemoryUsage memory_usage() const;
+
+private:
+    enum Segment {
+        kWindow, kProbation, kProtected
+    };
+
+    struct Position {
+        Segment segment;
+        typename std::list<Key>::iterator it;
+    };
+
+    typedef typename MapGetFreshTopKStorage<Key, Position, Compare,
+            std::allocator<std::pair<const Key, Position>>>::type Index;
+
+    std::list<Key> &List(Segment segment);
+
+    // Move the key to the most recently used end of `segment`
+    void MoveTo(Position &position, Segment segment);
+
+    void DemoteProtectedOverflow();
+
+    // Push window overflow to the main area and evict from it down to the limits
+    template<typename Frequency>
+    void Evict(const Frequency &frequency, std::vector<Key> &evicted);
+
+    void EvictKey(std::list<Key> &list, std::vector<Key> &evicted);
+
+    size_t capacity_;
+    size_t window_capacity_;
+    size_t protected_capacity_;
+
+    // Most recently used keys are at the front
+    std::list<Key> window_;
+    std::list<Key> probation_;
+    std::list<Key> protected_;
+    Index index_;
+};
+
+template<typename Key, typename Compare>
+TinyLfuPolicy<Key, Compare>::TinyLfuPolicy(const size_t capacity)
+        : capacity_(0), window_capacity_(0), protected_capacity_(0), window_(), probation_(), protected_(), index_() {
+    std::vector<Key> evicted;
+    SetCapacity(capacity, [](const Key &) { return 0; }, evicted);
+}
+
+template<typename Key, typename Compare>
+void TinyLfuPolicy<Key, Compare>::Touch(const Key &key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return;
+    }
+    Position &position = it->second;
+    if (position.segment == kProbation) {
+        MoveTo(position, kProtected);
+        DemoteProtectedOverflow();
+    } else {
+        MoveTo(position, position.segment);
+    }
+}
+
+template<typename Key, typename Compare>
+template<typename Frequency>
+void TinyLfuPolicy<Key, Compare>::Insert(const Key &key, const Frequency &frequency, std::vector<Key> &evicted) {
+    if (Contains(key)) {
+        Touch(key);
+        return;
+    }
+    window_.push_front(key);
+    index_[key] = Position{kWindow, window_.begin()};
+    Evict(frequency, evicted);
+}
+
+template<typename Key, typename Compare>
+void TinyLfuPolicy<Key, Compare>::Erase(const Key &key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return;
+    }
+    List(it->second.segment).erase(it->second.it);
+    index_.erase(key);
+}
+
+template<typename Key, typename Compare>
+template<typename Frequency>
+void TinyLfuPolicy<Key, Compare>::SetCapacity(const size_t capacity, const Frequency &frequency,
+                                              std::vector<Key> &evicted) {
+    if (capacity == 0) {
+        throw std::invalid_argument("TinyLfuPolicy: capacity must be positive");
+    }
+    capacity_ = capacity;
+    window_capacity_ = std::max<size_t>(1, capacity / 100);
+    protected_capacity_ = (capacity - window_capacity_) * 4 / 5;
+    Evict(frequency, evicted);
+    DemoteProtectedOverflow();
+}
+
+template<typename Key, typename Compare>
+MemoryUsage TinyLfuPolicy<Key, Compare>::memory_usage() const {
+    MemoryUsage usage = ContainerMemoryUsage(index_);
+    // Positions in the index are overhead, keys are stored twice: in a list and in the index
+    usage.overhead += usage.values + sizeof(*this) + size() * (2 * sizeof(void *) + 16);
+    usage.values = 0;
+    usage.keys += size() * sizeof(Key);
+    const std::list<Key> *lists[] = {&window_, &probation_, &protected_};
+    for (size_t i = 0; i < 3; ++i) {
+        for (auto it = lists[i]->begin(); it != lists[i]->end(); ++it) {
+            usage.keys += HeapBytes(*it);
+        }
+    }
+    return usage;
+}
+
+template<typename Key, typename Compare>
+std::list<Key> &TinyLfuPolicy<Key, Compare>::List(const Segment segment) {
+    return segment == kWindow ? window_ : (segment == kProbation ? probation_ : protected_);
+}
+
+template<typename Key, typename Compare>
+void TinyLfuPolicy<Key, Compare>::MoveTo(Position &position, const Segment segment) {
+    std::list<Key> &target = List(segment);
+    target.splice(target.begin(), List(position.segment), position.it);
+    position.segment = segment;
+}
+
+template<typename Key, typename Compare>
+void TinyLfuPolicy<Key, Compare>::DemoteProtectedOverflow() {
+    while (protected_.size() > protected_capacity_) {
+        MoveTo(index_.find(protected_.back())->second, kProbation);
+    }
+}
+
+template<typename Key, typename Compare>
+template<typename Frequency>
+void TinyLfuPolicy<Key, Compare>::Evict(const Frequency &frequency, std::vector<Key> &evicted) {
+    const size_t main_capacity = capacity_ - window_capacity_;
+    while (window_.size() > window_capacity_) {
+        // The candidate goes to the most recently used end of probation
+        Position &candidate = index_.find(window_.back())->second;
+        MoveTo(candidate, kProbation);
+        if (probation_.size() + protected_.size() <= main_capacity) {
+            continue;
+        }
+
+        if (probation_.size() == 1 && !protected_.empty()) {
+            MoveTo(index_.find(protected_.back())->second, kProbation);
+            // The demoted key is the victim, not the candidate
+            probation_.splice(probation_.end(), probation_, probation_.begin());
+        }
+        if (probation_.size() == 1) {
+            EvictKey(probation_, evicted);
+            continue;
+        }
+
+        // Probation has at least two keys: the candidate at the front and the victim at the back
+        if (frequency(probation_.back()) > frequency(probation_.front())) {
+            probation_.splice(probation_.end(), probation_, probation_.begin());
+        }
+        EvictKey(probation_, evicted);
+    }
+
+    // Shrinking: the least recently used keys of the main area go first
+    while (probation_.size() + protected_.size() > main_capacity) {
+        EvictKey(probation_.empty() ? protected_ : probation_, evicted);
+    }
+}
+
+template<typename Key, typename Compare>
+void TinyLfuPolicy<Key, Compare>::EvictKey(std::list<Key> &list, std::vector<Key> &evicted) {
+    evicted.push_back(list.back());
+    index_.erase(list.back());
+    list.pop_back();
+}
+
+#endif //VKTEST_TINY_LFU_POLICY_H